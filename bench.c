@@ -0,0 +1,302 @@
+// Headless simulation benchmark
+// Steps many independent matches through game_step() with scripted inputs
+// and reports the cost per tick and how it scales across threads. Only
+// game.c is involved, so this builds without SDL or sockets.
+//
+//   bench [--games N] [--ticks N] [--threads 1,2,4] [--engine NAME] [--csv]
+//
+// --engine game steps one Game at a time (the default). batch uses the
+// structure-of-arrays engine in game_batch.c with the widest kernel this CPU
+// has, and batch-scalar, batch-sse2 or batch-avx2 pick one.
+//
+// Every run starts from the same seeds, so the checksum of the final match
+// states must be identical for every thread count and every engine (and for
+// every build of the same physics).
+
+#include "game.c"
+#include "game_batch.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define BENCH_MAX_RUNS 16
+
+// Scripted right paddle: holds a random direction for a random number of ticks
+typedef struct {
+    uint32_t rng;
+    uint8_t buttons;
+    uint8_t ticks_left;
+} Script;
+
+typedef struct {
+    int games;
+    bool use_batch;
+    GameBatchKernel kernel;
+    Game *state;        // --engine game
+    GameBatch batch;    // --engine batch*
+    Script *scripts;
+    uint8_t *buttons1;
+    uint8_t *buttons2;
+} Bench;
+
+typedef struct {
+    Bench *bench;
+    int first;
+    int end;
+    int ticks;
+    pthread_t thread;
+} BenchShard;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Left paddle chases the ball so rallies (and paddle collisions) happen
+static uint8_t chase_buttons(float paddle_y, float ball_y) {
+    float center = paddle_y + PADDLE_HEIGHT / 2.0f;
+    float target = ball_y + BALL_SIZE / 2.0f;
+    if (target < center - 10) return INPUT_UP;
+    if (target > center + 10) return INPUT_DOWN;
+    return 0;
+}
+
+static uint8_t scripted_buttons(Script *script) {
+    if (script->ticks_left == 0) {
+        uint32_t r = game_rand(&script->rng);
+        script->buttons = (uint8_t)(r % 3);     // none, up or down
+        script->ticks_left = (uint8_t)(5 + (r >> 8) % 40);
+    }
+    script->ticks_left--;
+    return script->buttons;
+}
+
+static void bench_init(Bench *bench) {
+    for (int i = 0; i < bench->games; i++) {
+        Game game;
+        game_init(&game, (uint32_t)i + 1);
+        if (bench->use_batch) {
+            game_batch_set(&bench->batch, i, &game);
+        } else {
+            bench->state[i] = game;
+        }
+        bench->scripts[i] = (Script){ .rng = (uint32_t)i * 2654435761u | 1u };
+    }
+}
+
+static void bench_step_games(Bench *bench, int first, int end) {
+    for (int i = first; i < end; i++) {
+        Game *game = &bench->state[i];
+        if (game_is_over(game)) game_init(game, game->rng);
+        game_step(game,
+                  chase_buttons(game->player1.y, game->ball.y),
+                  scripted_buttons(&bench->scripts[i]));
+    }
+}
+
+static void bench_step_batch(Bench *bench, int first, int end) {
+    GameBatch *batch = &bench->batch;
+    int inputs_end = end < bench->games ? end : bench->games;
+
+    for (int i = first; i < inputs_end; i++) {
+        if (batch->score1[i] >= WINNING_SCORE || batch->score2[i] >= WINNING_SCORE) {
+            Game game;
+            game_init(&game, batch->rng[i]);
+            game_batch_set(batch, i, &game);
+        }
+        bench->buttons1[i] = chase_buttons(batch->p1_y[i], batch->ball_y[i]);
+        bench->buttons2[i] = scripted_buttons(&bench->scripts[i]);
+    }
+    game_batch_step(batch, first, end, bench->buttons1, bench->buttons2, bench->kernel);
+}
+
+static void *bench_shard(void *arg) {
+    BenchShard *shard = arg;
+    for (int t = 0; t < shard->ticks; t++) {
+        if (shard->bench->use_batch) {
+            bench_step_batch(shard->bench, shard->first, shard->end);
+        } else {
+            bench_step_games(shard->bench, shard->first, shard->end);
+        }
+    }
+    return NULL;
+}
+
+// FNV-1a over the simulated fields (not the struct, so padding never counts)
+static uint64_t bench_checksum(const Bench *bench) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < bench->games; i++) {
+        Game lane;
+        const Game *g = &bench->state[i];
+        if (bench->use_batch) {
+            game_batch_get(&bench->batch, i, &lane);
+            g = &lane;
+        }
+        float fields[] = { g->player1.y, g->player2.y, g->ball.x, g->ball.y, g->ball.vx, g->ball.vy };
+        uint32_t ints[] = { (uint32_t)g->score1, (uint32_t)g->score2, g->rng, g->tick };
+        const uint8_t *bytes = (const uint8_t *)fields;
+        for (size_t b = 0; b < sizeof(fields); b++) hash = (hash ^ bytes[b]) * 1099511628211ULL;
+        bytes = (const uint8_t *)ints;
+        for (size_t b = 0; b < sizeof(ints); b++) hash = (hash ^ bytes[b]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Start of thread s's share of the matches; batch shards start on a whole vector
+static int bench_shard_start(const Bench *bench, int s, int threads) {
+    if (s == threads) return bench->use_batch ? bench->batch.capacity : bench->games;
+    int first = (int)((int64_t)bench->games * s / threads);
+    return bench->use_batch ? first / GAME_BATCH_LANES * GAME_BATCH_LANES : first;
+}
+
+// Steps every match `ticks` times split across `threads`; returns wall ns
+static uint64_t bench_run(Bench *bench, int ticks, int threads) {
+    BenchShard shards[64];
+    bench_init(bench);
+
+    uint64_t start = now_ns();
+    for (int s = 0; s < threads; s++) {
+        shards[s] = (BenchShard){
+            .bench = bench,
+            .first = bench_shard_start(bench, s, threads),
+            .end = bench_shard_start(bench, s + 1, threads),
+            .ticks = ticks,
+        };
+        if (s > 0) pthread_create(&shards[s].thread, NULL, bench_shard, &shards[s]);
+    }
+    bench_shard(&shards[0]);
+    for (int s = 1; s < threads; s++) pthread_join(shards[s].thread, NULL);
+    return now_ns() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int games = 4096;
+    int ticks = 2500;   // 10M match-ticks by default
+    int thread_counts[BENCH_MAX_RUNS];
+    int runs = 0;
+    bool csv = false;
+    const char *engine = "game";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            ticks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            for (char *tok = strtok(argv[++i], ","); tok && runs < BENCH_MAX_RUNS; tok = strtok(NULL, ",")) {
+                int n = atoi(tok);
+                if (n >= 1 && n <= 64) thread_counts[runs++] = n;
+            }
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--games N] [--ticks N] [--threads 1,2,4] "
+                            "[--engine game|batch|batch-scalar|batch-sse2|batch-avx2] [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Bench bench = { .games = games };
+    if (strcmp(engine, "batch") == 0) {
+        bench.use_batch = true;
+        bench.kernel = game_batch_best_kernel();
+    } else if (strncmp(engine, "batch-", 6) == 0) {
+        bench.use_batch = true;
+        if (strcmp(engine + 6, "scalar") == 0) {
+            bench.kernel = GAME_BATCH_SCALAR;
+        } else if (strcmp(engine + 6, "sse2") == 0 && game_batch_best_kernel() >= GAME_BATCH_SSE2) {
+            bench.kernel = GAME_BATCH_SSE2;
+        } else if (strcmp(engine + 6, "avx2") == 0 && game_batch_best_kernel() >= GAME_BATCH_AVX2) {
+            bench.kernel = GAME_BATCH_AVX2;
+        } else {
+            fprintf(stderr, "Kernel %s is not available on this CPU\n", engine + 6);
+            return 1;
+        }
+    } else if (strcmp(engine, "game") != 0) {
+        fprintf(stderr, "Unknown engine: %s\n", engine);
+        return 1;
+    }
+    if (games < 1 || ticks < 1) {
+        fprintf(stderr, "--games and --ticks must be positive\n");
+        return 1;
+    }
+
+    // Default: 1, 2, 4, ... up to the number of online cores
+    if (runs == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cores < 1) cores = 1;
+        if (cores > 64) cores = 64;
+        for (int n = 1; n < cores && runs < BENCH_MAX_RUNS - 1; n *= 2) thread_counts[runs++] = n;
+        thread_counts[runs++] = (int)cores;
+    }
+
+    bench.scripts = calloc((size_t)games, sizeof(Script));
+    bench.buttons1 = calloc((size_t)games + GAME_BATCH_LANES, 1);   // batch reads whole vectors
+    bench.buttons2 = calloc((size_t)games + GAME_BATCH_LANES, 1);
+    bool allocated = bench.use_batch
+        ? game_batch_init(&bench.batch, games)
+        : (bench.state = calloc((size_t)games, sizeof(Game))) != NULL;
+    if (!allocated || !bench.scripts || !bench.buttons1 || !bench.buttons2) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    // Warm caches and clocks before the first timed run
+    bench_run(&bench, ticks / 10 + 1, 1);
+
+    double total = (double)games * ticks;
+    double base_rate = 0.0;
+    uint64_t base_checksum = 0;
+    bool mismatch = false;
+
+    if (csv) {
+        printf("engine,threads,games,ticks,ns_per_tick,ticks_per_sec,ticks_per_sec_per_thread,speedup,checksum\n");
+    } else {
+        printf("bench: %d games x %d ticks (%.1fM match-ticks per run), scripted inputs, engine %s%s%s\n",
+               games, ticks, total / 1e6, engine, bench.use_batch ? " " : "",
+               bench.use_batch ? game_batch_kernel_name(bench.kernel) : "");
+        printf("%7s %12s %14s %14s %8s  %s\n",
+               "threads", "ns/tick", "ticks/s", "ticks/s/core", "speedup", "checksum");
+    }
+
+    for (int r = 0; r < runs; r++) {
+        int threads = thread_counts[r] < games ? thread_counts[r] : games;
+        uint64_t elapsed = bench_run(&bench, ticks, threads);
+        uint64_t checksum = bench_checksum(&bench);
+
+        // ns/tick is per thread: the cost one core pays for one match-tick
+        double rate = total / (elapsed / 1e9);
+        double ns_per_tick = (double)elapsed * threads / total;
+        if (r == 0) {
+            base_rate = rate;
+            base_checksum = checksum;
+        }
+        if (checksum != base_checksum) mismatch = true;
+
+        if (csv) {
+            printf("%s,%d,%d,%d,%.3f,%.0f,%.0f,%.3f,%016llx\n",
+                   bench.use_batch ? game_batch_kernel_name(bench.kernel) : "game",
+                   threads, games, ticks, ns_per_tick,
+                   rate, rate / threads, rate / base_rate, (unsigned long long)checksum);
+        } else {
+            printf("%7d %12.2f %14.0f %14.0f %7.2fx  %016llx\n", threads, ns_per_tick,
+                   rate, rate / threads, rate / base_rate, (unsigned long long)checksum);
+        }
+    }
+
+    if (mismatch) fprintf(stderr, "bench: checksum differs between runs, simulation is not deterministic\n");
+
+    if (bench.use_batch) game_batch_free(&bench.batch);
+    free(bench.state);
+    free(bench.scripts);
+    free(bench.buttons1);
+    free(bench.buttons2);
+    return mismatch ? 1 : 0;
+}
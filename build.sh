@@ -2,7 +2,7 @@
 set -e
 
 CC="${CC:-clang}"
-CFLAGS="-Wall -Wextra -O2"
+CFLAGS="-Wall -Wextra -O2 -ffp-contract=off"
 
 # Detect OS
 OS=$(uname -s)
@@ -108,10 +108,17 @@ fi
 echo ""
 echo "Compiling client..."
 $CC $CFLAGS $INCLUDES client.c -o client $LIBS $RPATH
+$CC $CFLAGS $INCLUDES http_bench.c -o http_bench $LIBS $RPATH
 
 echo ""
 echo "Compiling server..."
-$CC $CFLAGS server.c -o server
+$CC $CFLAGS -pthread server.c -o server
+$CC $CFLAGS loadgen.c -o loadgen
+$CC $CFLAGS -pthread bench.c -o bench
+$CC $CFLAGS json_bench.c -o json_bench
+$CC $CFLAGS lagsim.c -o lagsim -lm
+$CC $CFLAGS network_test.c -o network_test
+$CC $CFLAGS game_test.c -o game_test -lm
 
 echo ""
 echo "Build complete!"
@@ -5,9 +5,13 @@
 #include "audio.c"
 #include "menu.c"
 #include "nakama_client.c"
+#include "net_client.c"
+#include "prediction.c"
+#include "frame_pacer.c"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
+#include <stdlib.h>
 #include <time.h>
 
 typedef enum {
@@ -23,8 +27,69 @@ static void generate_device_id(char *device_id, size_t size) {
     snprintf(device_id, size, "device_%ld_%d", (long)time(NULL), rand() % 10000);
 }
 
+// Sound events implied by two consecutive server snapshots
+static GameEvents events_from_snapshots(const GameState *before, const GameState *after) {
+    GameEvents events = {false, false, false, 0};
+    if (after->scores[0] != before->scores[0] || after->scores[1] != before->scores[1]) {
+        events.scored = true;
+    } else {
+        events.paddle_hit = (after->ball.vx > 0) != (before->ball.vx > 0);
+        events.wall_hit = (after->ball.vy > 0) != (before->ball.vy > 0) && !events.paddle_hit;
+    }
+    return events;
+}
+
+// prediction is NULL for Nakama matches, which only predict our paddle loosely
+static void log_netcode_stats(const Prediction *prediction, const Interpolator *interp) {
+    if (prediction && prediction->reconciles > 0) {
+        SDL_Log("Prediction: %u of %u server states corrected the paddle (avg %.2f px, max %.2f px)",
+                prediction->corrections, prediction->reconciles,
+                prediction->corrections ? prediction->correction_total / prediction->corrections : 0.0f,
+                prediction->correction_max);
+    }
+    if (interp->frames > 0) {
+        SDL_Log("Interpolation: delay %.1f ms, jitter %.1f ms, %u of %u frames extrapolated",
+                (interp->delay_ns + interp->spacing_ns) / 1e6, interp->jitter_ns / 1e6, interp->extrapolated, interp->frames);
+    }
+}
+
 int main(int argc, char *argv[]) {
-    (void)argc; (void)argv;
+    // --server HOST [--port N]: play on a dedicated UDP server instead of Nakama
+    // --immediate-render: draw the playfield rect by rect, for comparison
+    // --fps N | --uncapped: cap the frame rate instead of following vsync
+    // --no-idle: keep redrawing the menu every frame
+    // --netsim SPEC: emulate a bad link to the server (see netsim.c)
+    const char *server_host = NULL;
+    Uint16 server_port = SERVER_PORT;
+    bool immediate_render = false;
+    FramePaceMode pace_mode = FRAME_PACE_VSYNC;
+    int fps = 0;
+    bool idle_menu = true;
+    const char *netsim_spec = getenv(NETSIM_ENV);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            server_port = (Uint16)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--immediate-render") == 0) {
+            immediate_render = true;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            pace_mode = FRAME_PACE_CAPPED;
+            fps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--uncapped") == 0) {
+            pace_mode = FRAME_PACE_UNCAPPED;
+        } else if (strcmp(argv[i], "--no-idle") == 0) {
+            idle_menu = false;
+        } else if (strcmp(argv[i], "--netsim") == 0 && i + 1 < argc) {
+            netsim_spec = argv[++i];
+        }
+    }
+    NetSimConfig netsim;
+    bool emulate = netsim_spec && *netsim_spec;
+    if (emulate && !netsim_parse(&netsim, netsim_spec)) {
+        SDL_Log("--netsim expects %s", NETSIM_USAGE);
+        return 1;
+    }
 
     if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
         SDL_Log("Failed to init SDL: %s", SDL_GetError());
@@ -45,6 +110,10 @@ int main(int argc, char *argv[]) {
     if (!render_init(&render_assets, renderer)) {
         SDL_Log("Warning: Could not load all render assets");
     }
+    if (immediate_render) render_assets.batched = false;
+
+    FramePacer pacer;
+    frame_pacer_init(&pacer, renderer, pace_mode, fps, idle_menu);
 
     // Initialize audio
     Audio audio = {0};
@@ -64,27 +133,61 @@ int main(int argc, char *argv[]) {
         snprintf(menu.status_text, sizeof(menu.status_text), "Server unavailable - Local play only");
     }
 
-    // Game state
+    // Dedicated server connection (only with --server)
+    NetClient net = {0};
+    Prediction prediction = {0};
+    GameState server_state = {0};   // newest authoritative state
+
+    // Game state, advanced in fixed ticks. Local matches are drawn blended
+    // between the last two ticks, so motion is smooth at any frame rate.
     Game game;
-    game_init(&game);
+    game_init(&game, (uint32_t)time(NULL));
+    Game previous_game = game;
+    GameClock game_clock = {0};
 
     Scene current_scene = SCENE_MENU;
+    Scene drawn_scene = SCENE_GAME;     // scene of the last frame, to redraw on a switch
+    bool redraw = true;                 // idle menu: something may have changed
     bool online_match = false;
-    (void)online_match;  // Will be used for server-authoritative play
 
     bool running = true;
     Uint64 last_time = SDL_GetTicksNS();
 
     while (running) {
         Uint64 current_time = SDL_GetTicksNS();
-        float dt = (current_time - last_time) / 1000000000.0f;
+        Uint64 frame_ns = current_time - last_time;
+        float dt = frame_ns / 1000000000.0f;
         last_time = current_time;
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
+            redraw = true;
             if (event.type == SDL_EVENT_QUIT) {
                 running = false;
             }
+            if ((event.type == SDL_EVENT_RENDER_TARGETS_RESET || event.type == SDL_EVENT_RENDER_DEVICE_RESET) &&
+                !immediate_render) {
+                render_build_cache(&render_assets, renderer);
+            }
+
+            // Nakama requests finish on their worker thread and report here
+            switch (nakama_handle_event(&nakama, &event)) {
+                case NAKAMA_REQUEST_AUTHENTICATE:
+                    if (current_scene != SCENE_MATCHMAKING) break;
+                    if (nakama.authenticated && nakama_find_match(&nakama)) break;
+                    current_scene = SCENE_MENU;
+                    snprintf(menu.status_text, sizeof(menu.status_text), "%s", nakama.status_message);
+                    break;
+                case NAKAMA_REQUEST_FIND_MATCH:
+                    if (current_scene != SCENE_MATCHMAKING) break;
+                    if (nakama.in_matchmaking && (!nakama.in_match || nakama_join_match(&nakama))) break;
+                    nakama_leave_match(&nakama);
+                    current_scene = SCENE_MENU;
+                    snprintf(menu.status_text, sizeof(menu.status_text), "%s", nakama.status_message);
+                    break;
+                default:
+                    break;
+            }
 
             switch (current_scene) {
                 case SCENE_MENU: {
@@ -99,23 +202,31 @@ int main(int argc, char *argv[]) {
                     }
 
                     if (start_local) {
-                        game_init(&game);
+                        game_init(&game, (uint32_t)time(NULL));
+                        game_clock = (GameClock){0};
                         online_match = false;
                         current_scene = SCENE_GAME;
                     }
 
-                    if (start_matchmaking && nakama_available) {
-                        // Authenticate if not already
-                        if (!nakama.authenticated) {
-                            char device_id[64];
-                            generate_device_id(device_id, sizeof(device_id));
-                            nakama_authenticate_device(&nakama, device_id);
+                    if (start_matchmaking && server_host) {
+                        if (net_client_connect(&net, server_host, server_port, emulate ? &netsim : NULL)) {
+                            current_scene = SCENE_MATCHMAKING;
+                            snprintf(menu.status_text, sizeof(menu.status_text), "Connecting to %s", server_host);
+                        } else {
+                            snprintf(menu.status_text, sizeof(menu.status_text), "Server not available");
                         }
-
+                    } else if (start_matchmaking && nakama_available) {
+                        // Authenticate first if needed; the match search is
+                        // queued when the authentication event comes back
+                        bool queued;
                         if (nakama.authenticated) {
-                            nakama_find_match(&nakama);
-                            current_scene = SCENE_MATCHMAKING;
+                            queued = nakama_find_match(&nakama);
+                        } else {
+                            char device_id[64];
+                            generate_device_id(device_id, sizeof(device_id));
+                            queued = nakama_authenticate_device(&nakama, device_id);
                         }
+                        if (queued) current_scene = SCENE_MATCHMAKING;
 
                         snprintf(menu.status_text, sizeof(menu.status_text), "%s", nakama.status_message);
                     } else if (start_matchmaking && !nakama_available) {
@@ -127,8 +238,8 @@ int main(int argc, char *argv[]) {
                 case SCENE_MATCHMAKING: {
                     // Handle escape to cancel
                     if (event.type == SDL_EVENT_KEY_DOWN && event.key.scancode == SDL_SCANCODE_ESCAPE) {
-                        nakama.in_matchmaking = false;
-                        nakama.in_match = false;
+                        nakama_leave_match(&nakama);
+                        net_client_close(&net);
                         current_scene = SCENE_MENU;
                         snprintf(menu.status_text, sizeof(menu.status_text), "Matchmaking cancelled");
                     }
@@ -140,7 +251,11 @@ int main(int argc, char *argv[]) {
                     if (event.type == SDL_EVENT_KEY_DOWN && event.key.scancode == SDL_SCANCODE_ESCAPE) {
                         current_scene = SCENE_MENU;
                         menu.active = true;
-                        nakama.in_match = false;
+                        if (online_match) log_netcode_stats(server_host ? &prediction : NULL, server_host ? &net.interp : &nakama.interp);
+                        nakama_leave_match(&nakama);
+                        render_log_stats(&render_assets);
+                        frame_pacer_log_stats(&pacer);
+                        net_client_close(&net);
                     }
                     input_handle_event(&game, &event);
                     break;
@@ -149,26 +264,52 @@ int main(int argc, char *argv[]) {
         }
 
         // Update based on scene
+        if (current_scene != drawn_scene) redraw = true;
+        drawn_scene = current_scene;
+
         switch (current_scene) {
             case SCENE_MENU:
-                menu_render(renderer, &menu, render_assets.font, render_assets.text_engine);
+                if (redraw || !pacer.idle_menu) {
+                    menu_render(renderer, &menu, render_assets.font, &render_assets.text_cache);
+                }
                 break;
 
             case SCENE_MATCHMAKING: {
-                // Poll for match status
-                // In a real implementation, this would use WebSockets
-                // For now, we'll simulate finding a match after a few seconds
-
+                // Wait for the UDP server or the Nakama match to start streaming state
                 static float matchmaking_timer = 0;
                 matchmaking_timer += dt;
 
-                if (matchmaking_timer > 3.0f) {
-                    // Simulate match found - start game
-                    game_init(&game);
-                    online_match = true;
-                    current_scene = SCENE_GAME;
-                    matchmaking_timer = 0;
-                    SDL_Log("Match found (simulated)");
+                if (server_host) {
+                    // The server starts streaming state once an opponent joins
+                    net_client_update(&net);
+                    net.reseated = false;
+                    if (net.state_updated) {
+                        game_init(&game, 0);
+                        game_clock = (GameClock){0};
+                        game_apply_state(&game, &net.state);
+                        server_state = net.state;
+                        prediction_init(&prediction, net.player, &game);
+                        net.state_updated = false;
+                        online_match = true;
+                        current_scene = SCENE_GAME;
+                        matchmaking_timer = 0;
+                    }
+                } else if (nakama.in_match) {
+                    // The match handler broadcasts state once both players are in
+                    if (!nakama_update(&nakama)) {
+                        nakama_leave_match(&nakama);
+                        current_scene = SCENE_MENU;
+                        snprintf(menu.status_text, sizeof(menu.status_text), "%s", nakama.status_message);
+                    } else if (nakama.state_updated) {
+                        game_init(&game, 0);
+                        game_clock = (GameClock){0};
+                        nakama_game_state(&server_state, &nakama.server_state);
+                        game_apply_state(&game, &server_state);
+                        nakama.state_updated = false;
+                        online_match = true;
+                        current_scene = SCENE_GAME;
+                        matchmaking_timer = 0;
+                    }
                 }
 
                 // Render matchmaking screen
@@ -176,32 +317,23 @@ int main(int argc, char *argv[]) {
                 SDL_RenderClear(renderer);
 
                 if (render_assets.font && render_assets.text_engine) {
-                    TTF_Text *text = TTF_CreateText(render_assets.text_engine, render_assets.font, "Finding Match...", 0);
-                    if (text) {
-                        int w, h;
-                        TTF_GetTextSize(text, &w, &h);
-                        TTF_DrawRendererText(text, WINDOW_WIDTH / 2.0f - w / 2.0f, WINDOW_HEIGHT / 2.0f - 50);
-                        TTF_DestroyText(text);
-                    }
+                    TextCache *text_cache = &render_assets.text_cache;
+                    text_cache_draw_centered(text_cache, render_assets.font, "Finding Match...",
+                                             WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f - 50);
 
                     // Animated dots
                     int dots = ((int)(matchmaking_timer * 2)) % 4;
                     char dots_str[8] = "";
                     for (int i = 0; i < dots; i++) strcat(dots_str, ".");
+                    text_cache_draw(text_cache, render_assets.font, dots_str, WINDOW_WIDTH / 2.0f + 100, WINDOW_HEIGHT / 2.0f - 50);
 
-                    TTF_Text *dots_text = TTF_CreateText(render_assets.text_engine, render_assets.font, dots_str, 0);
-                    if (dots_text) {
-                        TTF_DrawRendererText(dots_text, WINDOW_WIDTH / 2.0f + 100, WINDOW_HEIGHT / 2.0f - 50);
-                        TTF_DestroyText(dots_text);
+                    if (!server_host) {
+                        text_cache_draw_centered(text_cache, render_assets.font, nakama.status_message,
+                                                 WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f + 10);
                     }
 
-                    TTF_Text *cancel = TTF_CreateText(render_assets.text_engine, render_assets.font, "Press ESC to cancel", 0);
-                    if (cancel) {
-                        int w2, h2;
-                        TTF_GetTextSize(cancel, &w2, &h2);
-                        TTF_DrawRendererText(cancel, WINDOW_WIDTH / 2.0f - w2 / 2.0f, WINDOW_HEIGHT - 80);
-                        TTF_DestroyText(cancel);
-                    }
+                    text_cache_draw_centered(text_cache, render_assets.font, "Press ESC to cancel",
+                                             WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT - 80);
                 }
 
                 SDL_RenderPresent(renderer);
@@ -209,8 +341,98 @@ int main(int argc, char *argv[]) {
             }
 
             case SCENE_GAME: {
-                input_update(&game);
-                GameEvents events = game_update(&game, dt);
+                GameEvents events = {false, false, false, 0};
+                int ticks = game_clock_advance(&game_clock, frame_ns);
+                bool interpolate = false;
+
+                if (online_match && server_host) {
+                    // Server-authoritative with prediction: our paddle moves on the
+                    // tick the key is pressed, and each server state is replayed
+                    // forward through the inputs the server has not applied yet
+                    net_client_update(&net);
+                    if (net.reseated) {
+                        // The opponent left: wait for the next one in the new seat
+                        log_netcode_stats(&prediction, &net.interp);
+                        current_scene = SCENE_MATCHMAKING;
+                        break;
+                    }
+                    if (net.state_updated) {
+                        events = events_from_snapshots(&server_state, &net.state);
+                        server_state = net.state;
+                        prediction_reconcile(&prediction, &net.state, net.input_tick);
+                        net.state_updated = false;
+                    }
+
+                    // Our paddle is predicted; the ball and the opponent are
+                    // interpolated between buffered server states. They are
+                    // sampled first so this frame's inputs name the state
+                    // drawn with them (lag compensation). Scores only ever
+                    // come from the server.
+                    GameState shown, remote;
+                    bool has_remote = interpolation_sample(&net.interp, current_time, &remote);
+                    for (int i = 0; i < ticks; i++) {
+                        uint8_t recent[INPUT_REDUNDANCY];
+                        uint16_t tick = prediction_add_input(&prediction, input_buttons(&game));
+                        int count = prediction_recent_inputs(&prediction, recent, INPUT_REDUNDANCY);
+                        net_client_send_input(&net, tick, recent, count);
+                    }
+
+                    game_state_from_game(&shown, &prediction.game);
+                    if (has_remote) {
+                        shown.ball = remote.ball;
+                        shown.players[1 - net.player] = remote.players[1 - net.player];
+                    }
+                    shown.scores[0] = server_state.scores[0];
+                    shown.scores[1] = server_state.scores[1];
+                    game_apply_state(&game, &shown);
+                } else if (online_match) {
+                    // Nakama match: the match handler runs the physics and
+                    // only hears our input bits. Our paddle also moves
+                    // locally so it answers keys at once, and is pulled a
+                    // quarter of the way to the server's paddle on every
+                    // state. The ball and the opponent are interpolated
+                    // between buffered states as on the UDP path: they
+                    // arrive at 30 Hz, and at 5 Hz while the match idles.
+                    int own_index = nakama.player_num == 2 ? 1 : 0;
+                    Paddle *own = own_index ? &game.player2 : &game.player1;
+                    if (!nakama_update(&nakama)) {
+                        nakama_leave_match(&nakama);
+                        current_scene = SCENE_MENU;
+                        menu.active = true;
+                        snprintf(menu.status_text, sizeof(menu.status_text), "%s", nakama.status_message);
+                        break;
+                    }
+                    if (nakama.state_updated) {
+                        GameState match;
+                        nakama_game_state(&match, &nakama.server_state);
+                        events = events_from_snapshots(&server_state, &match);
+                        server_state = match;
+                        own->y += (match.players[own_index].y - own->y) * 0.25f;
+                        nakama.state_updated = false;
+                    }
+                    uint8_t buttons = input_buttons(&game);
+                    for (int i = 0; i < ticks; i++) {
+                        paddle_apply_input(own, buttons);
+                        paddle_update(own, GAME_DT);
+                    }
+                    nakama_send_input(&nakama, buttons);
+
+                    GameState shown, remote;
+                    game_state_from_game(&shown, &game);
+                    if (interpolation_sample(&nakama.interp, current_time, &remote)) {
+                        shown.ball = remote.ball;
+                        shown.players[1 - own_index] = remote.players[1 - own_index];
+                    }
+                    shown.scores[0] = server_state.scores[0];
+                    shown.scores[1] = server_state.scores[1];
+                    game_apply_state(&game, &shown);
+                } else {
+                    interpolate = true;
+                    for (int i = 0; i < ticks; i++) {
+                        previous_game = game;
+                        game_events_merge(&events, game_step(&game, input_buttons(&game), 0));
+                    }
+                }
 
                 // Play sounds based on game events
                 if (events.paddle_hit) {
@@ -223,8 +445,8 @@ int main(int argc, char *argv[]) {
                     audio_play_score(&audio);
                 }
 
-                // Check for game over (first to 5)
-                if (game.score1 >= 5 || game.score2 >= 5) {
+                // Check for game over (first to WINNING_SCORE)
+                if (game_is_over(&game)) {
                     // Return to menu after a short delay
                     static float gameover_timer = 0;
                     gameover_timer += dt;
@@ -233,8 +455,13 @@ int main(int argc, char *argv[]) {
                         current_scene = SCENE_MENU;
                         menu.active = true;
                         gameover_timer = 0;
+                        if (online_match) log_netcode_stats(server_host ? &prediction : NULL, server_host ? &net.interp : &nakama.interp);
+                        render_log_stats(&render_assets);
+                        frame_pacer_log_stats(&pacer);
+                        net_client_close(&net);
+                        nakama_leave_match(&nakama);
 
-                        if (game.score1 >= 5) {
+                        if (game.score1 >= WINNING_SCORE) {
                             snprintf(menu.status_text, sizeof(menu.status_text), "Player 1 Wins!");
                         } else {
                             snprintf(menu.status_text, sizeof(menu.status_text), "Player 2 Wins!");
@@ -242,14 +469,21 @@ int main(int argc, char *argv[]) {
                     }
                 }
 
-                render_game(renderer, &game, &render_assets);
+                Game shown = game;
+                if (interpolate) game_interpolate(&shown, &previous_game, &game, game_clock_alpha(&game_clock));
+                render_game(renderer, &shown, &render_assets);
                 break;
             }
         }
 
-        SDL_Delay(1);
+        // The menu only changes on input, so it sleeps until an event arrives
+        bool idle = pacer.idle_menu && current_scene == SCENE_MENU && running;
+        frame_pacer_end_frame(&pacer, idle, current_scene == SCENE_GAME);
+        redraw = false;
     }
 
+    frame_pacer_log_stats(&pacer);
+    net_client_close(&net);
     nakama_quit(&nakama);
     render_quit(&render_assets);
     audio_quit(&audio);
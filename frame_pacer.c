@@ -0,0 +1,136 @@
+#ifndef FRAME_PACER_C
+#define FRAME_PACER_C
+
+// Frame pacing for the client main loop.
+//
+// The simulation runs on its own fixed tick (GameClock), so the render rate
+// is free to follow the display:
+//   FRAME_PACE_VSYNC     present blocks until the next refresh
+//   FRAME_PACE_CAPPED    sleep until just before the frame deadline, then
+//                        spin the last stretch, since OS sleeps overshoot
+//   FRAME_PACE_UNCAPPED  no waiting at all, for measuring
+// Independently, idle_menu lets the static menu sleep until an event
+// arrives instead of redrawing an unchanged frame.
+//
+// Intervals between frames are kept in a histogram, so p50/p99 frame times
+// can be logged without storing every frame.
+
+#include <SDL3/SDL.h>
+
+#define FRAME_SPIN_NS 1000000ULL            // spin the last 1 ms before a capped deadline
+#define FRAME_IDLE_TIMEOUT_MS 250           // idle menu still wakes up this often
+#define FRAME_HISTOGRAM_BUCKETS 1000        // 0.1 ms buckets, the last one holds >= 99.9 ms
+#define FRAME_HISTOGRAM_BUCKET_NS 100000ULL
+
+typedef enum {
+    FRAME_PACE_VSYNC,
+    FRAME_PACE_CAPPED,
+    FRAME_PACE_UNCAPPED
+} FramePaceMode;
+
+typedef struct {
+    FramePaceMode mode;
+    bool idle_menu;
+    Uint64 target_ns;       // capped: 1 s / fps
+    Uint64 deadline_ns;     // capped: when the next frame should start
+    Uint64 last_frame_ns;   // start of the current frame
+
+    // Stats
+    Uint32 histogram[FRAME_HISTOGRAM_BUCKETS];
+    Uint64 frames;
+    Uint64 frame_ns_max;
+} FramePacer;
+
+static const char *frame_pace_mode_name(FramePaceMode mode) {
+    switch (mode) {
+        case FRAME_PACE_VSYNC: return "vsync";
+        case FRAME_PACE_CAPPED: return "capped";
+        default: return "uncapped";
+    }
+}
+
+// Applies the mode to the renderer. Falls back to a 60 fps cap when vsync
+// cannot be enabled.
+void frame_pacer_init(FramePacer *pacer, SDL_Renderer *renderer, FramePaceMode mode, int fps, bool idle_menu) {
+    SDL_zero(*pacer);
+    pacer->mode = mode;
+    pacer->idle_menu = idle_menu;
+    pacer->target_ns = 1000000000ULL / (Uint64)(fps > 0 ? fps : 60);
+
+    if (mode == FRAME_PACE_VSYNC && !SDL_SetRenderVSync(renderer, 1)) {
+        SDL_Log("VSync unavailable (%s), capping at %d fps", SDL_GetError(), fps > 0 ? fps : 60);
+        pacer->mode = FRAME_PACE_CAPPED;
+    }
+    if (pacer->mode != FRAME_PACE_VSYNC) SDL_SetRenderVSync(renderer, SDL_RENDERER_VSYNC_DISABLED);
+
+    pacer->last_frame_ns = SDL_GetTicksNS();
+}
+
+// Capped mode: blocks until the next frame deadline
+static void frame_pacer_wait(FramePacer *pacer) {
+    if (pacer->mode != FRAME_PACE_CAPPED) return;
+
+    Uint64 now = SDL_GetTicksNS();
+    pacer->deadline_ns += pacer->target_ns;
+    // More than a frame late (a stall, or leaving the idle menu): start over
+    // from now instead of rushing frames out to catch up
+    if (pacer->deadline_ns + pacer->target_ns < now) {
+        pacer->deadline_ns = now;
+        return;
+    }
+
+    if (pacer->deadline_ns > now + FRAME_SPIN_NS) {
+        SDL_DelayNS(pacer->deadline_ns - now - FRAME_SPIN_NS);
+    }
+    while (SDL_GetTicksNS() < pacer->deadline_ns) {
+        // spin
+    }
+}
+
+// Ends the frame: waits as the mode requires and, when record is set, adds
+// the frame's length to the stats. Idle menu frames are not recorded.
+void frame_pacer_end_frame(FramePacer *pacer, bool idle, bool record) {
+    if (idle) {
+        SDL_WaitEventTimeout(NULL, FRAME_IDLE_TIMEOUT_MS);
+    } else {
+        frame_pacer_wait(pacer);
+    }
+
+    Uint64 now = SDL_GetTicksNS();
+    Uint64 frame_ns = now - pacer->last_frame_ns;
+    pacer->last_frame_ns = now;
+    if (!record) return;
+
+    Uint64 bucket = frame_ns / FRAME_HISTOGRAM_BUCKET_NS;
+    if (bucket >= FRAME_HISTOGRAM_BUCKETS) bucket = FRAME_HISTOGRAM_BUCKETS - 1;
+    pacer->histogram[bucket]++;
+    pacer->frames++;
+    if (frame_ns > pacer->frame_ns_max) pacer->frame_ns_max = frame_ns;
+}
+
+// Frame time in ms below which `fraction` of the recorded frames fall
+// (upper edge of the histogram bucket)
+double frame_pacer_percentile(const FramePacer *pacer, double fraction) {
+    Uint64 rank = (Uint64)(fraction * (double)pacer->frames);
+    Uint64 seen = 0;
+    for (int i = 0; i < FRAME_HISTOGRAM_BUCKETS; i++) {
+        seen += pacer->histogram[i];
+        if (seen > rank) return (double)((Uint64)(i + 1) * FRAME_HISTOGRAM_BUCKET_NS) / 1e6;
+    }
+    return (double)pacer->frame_ns_max / 1e6;
+}
+
+// Logs and clears the recorded frame times
+void frame_pacer_log_stats(FramePacer *pacer) {
+    if (pacer->frames > 0) {
+        SDL_Log("Frames (%s): %llu frames, p50 %.1f ms, p99 %.1f ms, max %.1f ms",
+                frame_pace_mode_name(pacer->mode), (unsigned long long)pacer->frames,
+                frame_pacer_percentile(pacer, 0.50), frame_pacer_percentile(pacer, 0.99),
+                pacer->frame_ns_max / 1e6);
+    }
+    SDL_zero(pacer->histogram);
+    pacer->frames = 0;
+    pacer->frame_ns_max = 0;
+}
+
+#endif
@@ -1,8 +1,14 @@
 #ifndef GAME_C
 #define GAME_C
 
+// Simulation core. The game advances in fixed ticks of GAME_DT and all
+// randomness comes from a per-game seeded PRNG, so the same seed and the same
+// per-tick inputs reproduce the same game bit for bit on any build that keeps
+// IEEE float semantics (no -ffast-math, no FMA contraction).
+
 #include <stdbool.h>
-#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
@@ -14,6 +20,19 @@
 
 #define BALL_SIZE 15
 #define BALL_SPEED 350.0f
+#define BALL_MAX_VY (BALL_SPEED * 2.0f)  // paddle spin stops adding speed here
+#define BALL_MAX_BOUNCES 8              // per step; a whole second at top speed needs 4
+
+#define WINNING_SCORE 5
+
+#define GAME_TICK_RATE 60
+#define GAME_DT (1.0f / GAME_TICK_RATE)
+#define GAME_TICK_NS (1000000000ULL / GAME_TICK_RATE)
+#define GAME_MAX_TICKS_PER_FRAME 8  // drop time after a stall instead of spiralling
+
+// Input bits for a paddle (shared by local input and network packets)
+#define INPUT_UP   0x01
+#define INPUT_DOWN 0x02
 
 typedef struct {
     float x, y;
@@ -26,31 +45,61 @@ typedef struct {
     float vx, vy;
 } Ball;
 
-// Events returned by game_update
+// Events returned by game_update/game_step
 typedef struct {
     bool paddle_hit;
     bool wall_hit;
     bool scored;
+    int held;           // with hold_goals: player (1 or 2) whose point is held, else 0
 } GameEvents;
 
+// Lag compensation for one step (see lag_compensation.c). A paddle whose
+// player's view is known is judged against the ball that player saw instead
+// of the current one. With hold_goals a ball that reaches a goal line waits
+// there instead of scoring, so a late hit can still save it; the caller
+// awards the point with game_award_point() when it gives up waiting.
+typedef struct {
+    const Ball *seen1;  // ball player 1 saw when sending this tick's input, or NULL
+    const Ball *seen2;
+    bool hold_goals;
+} GameRewind;
+
 typedef struct {
     Paddle player1;  // left paddle
     Paddle player2;  // right paddle
     Ball ball;
     int score1;
     int score2;
+    uint32_t rng;    // PRNG state, never zero
+    uint32_t tick;   // fixed ticks simulated since game_init
     bool key_up;
     bool key_down;
 } Game;
 
-void ball_reset(Ball *ball) {
+// Turns elapsed wall time into a whole number of fixed ticks
+typedef struct {
+    uint64_t accumulator_ns;
+} GameClock;
+
+// xorshift32: tiny, fast and identical on every platform
+uint32_t game_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void ball_reset(Ball *ball, uint32_t *rng) {
+    uint32_t r = game_rand(rng);
     ball->x = WINDOW_WIDTH / 2.0f - BALL_SIZE / 2.0f;
     ball->y = WINDOW_HEIGHT / 2.0f - BALL_SIZE / 2.0f;
-    ball->vx = BALL_SPEED * ((rand() % 2) ? 1 : -1);
-    ball->vy = BALL_SPEED * 0.5f * ((rand() % 2) ? 1 : -1);
+    ball->vx = BALL_SPEED * ((r & 1) ? 1 : -1);
+    ball->vy = BALL_SPEED * 0.5f * ((r & 2) ? 1 : -1);
 }
 
-void game_init(Game *game) {
+void game_init(Game *game, uint32_t seed) {
     game->player1 = (Paddle){
         .x = PADDLE_MARGIN,
         .y = WINDOW_HEIGHT / 2.0f - PADDLE_HEIGHT / 2.0f,
@@ -67,13 +116,28 @@ void game_init(Game *game) {
         .vy = 0
     };
 
-    ball_reset(&game->ball);
+    // Scramble the seed so nearby seeds diverge immediately
+    game->rng = seed * 2654435761u ^ 0x9E3779B9u;
+    if (game->rng == 0) game->rng = 0x9E3779B9u;
+    game->tick = 0;
+
+    ball_reset(&game->ball, &game->rng);
     game->score1 = 0;
     game->score2 = 0;
     game->key_up = false;
     game->key_down = false;
 }
 
+void paddle_apply_input(Paddle *paddle, uint8_t buttons) {
+    paddle->vy = 0;
+    if (buttons & INPUT_UP) paddle->vy -= PADDLE_SPEED;
+    if (buttons & INPUT_DOWN) paddle->vy += PADDLE_SPEED;
+}
+
+bool game_is_over(const Game *game) {
+    return game->score1 >= WINNING_SCORE || game->score2 >= WINNING_SCORE;
+}
+
 void paddle_update(Paddle *paddle, float dt) {
     paddle->y += paddle->vy * dt;
 
@@ -88,58 +152,289 @@ bool ball_collides_paddle(Ball *ball, Paddle *paddle) {
            ball->y + BALL_SIZE > paddle->y;
 }
 
-GameEvents game_update(Game *game, float dt) {
-    GameEvents events = {false, false, false};
+// Gives `player` (1 or 2) the point and serves again
+void game_award_point(Game *game, int player) {
+    if (player == 1) {
+        game->score1++;
+    } else {
+        game->score2++;
+    }
+    ball_reset(&game->ball, &game->rng);
+}
 
-    // Update paddles
-    paddle_update(&game->player1, dt);
-    paddle_update(&game->player2, dt);
+// Spin from the paddle's velocity, capped so rallies stay playable
+static void ball_add_spin(Ball *ball, const Paddle *paddle) {
+    ball->vy += paddle->vy * 0.3f;
+    if (ball->vy > BALL_MAX_VY) ball->vy = BALL_MAX_VY;
+    if (ball->vy < -BALL_MAX_VY) ball->vy = -BALL_MAX_VY;
+}
+
+// Earliest time in [0, t] at which the ball, moving in a straight line,
+// overlaps the paddle (0 if it already does), or -1: the swept AABB test,
+// clipping [0, t] to when the ball is inside the paddle's extent on x and y
+static float ball_paddle_impact(const Ball *ball, const Paddle *paddle, float t) {
+    float enter = 0;
+    float leave = t;
+
+    float lo = paddle->x - BALL_SIZE;
+    float hi = paddle->x + paddle->w;
+    if (ball->vx == 0) {
+        if (!(ball->x > lo && ball->x < hi)) return -1;
+    } else {
+        float t1 = (lo - ball->x) / ball->vx;
+        float t2 = (hi - ball->x) / ball->vx;
+        if (t1 > t2) {
+            float swap = t1;
+            t1 = t2;
+            t2 = swap;
+        }
+        if (t1 > enter) enter = t1;
+        if (t2 < leave) leave = t2;
+    }
+
+    lo = paddle->y - BALL_SIZE;
+    hi = paddle->y + paddle->h;
+    if (ball->vy == 0) {
+        if (!(ball->y > lo && ball->y < hi)) return -1;
+    } else {
+        float t1 = (lo - ball->y) / ball->vy;
+        float t2 = (hi - ball->y) / ball->vy;
+        if (t1 > t2) {
+            float swap = t1;
+            t1 = t2;
+            t2 = swap;
+        }
+        if (t1 > enter) enter = t1;
+        if (t2 < leave) leave = t2;
+    }
+
+    return enter < leave ? enter : -1;
+}
+
+// Paddle test for a player whose view is known: the ball it saw has to
+// touch the paddle while both it and the real ball head that way (the seen
+// ball can overlap the paddle for several ticks; only the first bounces).
+// The seen ball is swept back over the tick it took to get there, so a fast
+// ball that went through the paddle between two frames on the player's
+// screen still counts. `direction` is -1 for the left paddle, 1 for the right.
+static bool ball_seen_collides_paddle(const Ball *ball, const Ball *seen, const Paddle *paddle, float direction, float dt) {
+    if (ball->vx * direction <= 0 || seen->vx * direction <= 0) return false;
+    Ball back = { seen->x, seen->y, -seen->vx, -seen->vy };
+    return ball_paddle_impact(&back, paddle, dt) >= 0;
+}
+
+enum { BALL_HIT_NONE, BALL_HIT_TOP, BALL_HIT_BOTTOM, BALL_HIT_LEFT, BALL_HIT_RIGHT };
+
+// Moves the ball through dt, bouncing off the walls and off each paddle at
+// the time it reaches them, so no step is long enough to pass through one.
+// Paddles have already moved and stand still meanwhile; a NULL paddle is
+// left out. A paddle sends the ball back from its face wherever it is hit,
+// as the overlap test always has. With nothing in the way this is exactly
+// the plain x += vx * dt move, which game_batch.c relies on.
+static void ball_sweep(Ball *ball, const Paddle *left, const Paddle *right, float dt, GameEvents *events) {
+    float t = dt;
+    for (int bounce = 0; bounce < BALL_MAX_BOUNCES; bounce++) {
+        float x = ball->x + ball->vx * t;
+        float y = ball->y + ball->vy * t;
 
-    // Update ball
-    game->ball.x += game->ball.vx * dt;
-    game->ball.y += game->ball.vy * dt;
+        // Earliest impact within t; a wall wins a tie with a paddle
+        int hit = BALL_HIT_NONE;
+        float when = t;
+        if (y <= 0 && ball->vy < 0) {
+            hit = BALL_HIT_TOP;
+            when = -ball->y / ball->vy;
+        } else if (y + BALL_SIZE >= WINDOW_HEIGHT && ball->vy > 0) {
+            hit = BALL_HIT_BOTTOM;
+            when = (WINDOW_HEIGHT - BALL_SIZE - ball->y) / ball->vy;
+        }
+        if (left && ball->vx < 0) {
+            float at = ball_paddle_impact(ball, left, t);
+            if (at >= 0 && (hit == BALL_HIT_NONE || at < when)) {
+                hit = BALL_HIT_LEFT;
+                when = at;
+            }
+        }
+        if (right && ball->vx > 0) {
+            float at = ball_paddle_impact(ball, right, t);
+            if (at >= 0 && (hit == BALL_HIT_NONE || at < when)) {
+                hit = BALL_HIT_RIGHT;
+                when = at;
+            }
+        }
 
-    // Ball collision with top/bottom walls
-    if (game->ball.y <= 0) {
-        game->ball.y = 0;
-        game->ball.vy = -game->ball.vy;
-        events.wall_hit = true;
+        if (hit == BALL_HIT_NONE) {
+            ball->x = x;
+            ball->y = y;
+            return;
+        }
+        if (when < 0) when = 0;
+        if (when > t) when = t;
+        t -= when;
+
+        switch (hit) {
+            case BALL_HIT_TOP:
+            case BALL_HIT_BOTTOM:
+                ball->x += ball->vx * when;
+                ball->y = hit == BALL_HIT_TOP ? 0 : WINDOW_HEIGHT - BALL_SIZE;
+                ball->vy = -ball->vy;
+                events->wall_hit = true;
+                break;
+            case BALL_HIT_LEFT:
+                ball->x = left->x + left->w;
+                ball->y += ball->vy * when;
+                ball->vx = -ball->vx;
+                ball_add_spin(ball, left);
+                events->paddle_hit = true;
+                break;
+            default:
+                ball->x = right->x - BALL_SIZE;
+                ball->y += ball->vy * when;
+                ball->vx = -ball->vx;
+                ball_add_spin(ball, right);
+                events->paddle_hit = true;
+                break;
+        }
     }
-    if (game->ball.y + BALL_SIZE >= WINDOW_HEIGHT) {
-        game->ball.y = WINDOW_HEIGHT - BALL_SIZE;
-        game->ball.vy = -game->ball.vy;
-        events.wall_hit = true;
+
+    // Out of bounces: finish the step without collisions, inside the walls
+    ball->x += ball->vx * t;
+    ball->y += ball->vy * t;
+    if (ball->y < 0) ball->y = 0;
+    if (ball->y > WINDOW_HEIGHT - BALL_SIZE) ball->y = WINDOW_HEIGHT - BALL_SIZE;
+}
+
+// The ball's part of game_update_rewound(): sweep, paddles, scoring
+static void game_update_ball(Game *game, float dt, const GameRewind *rewind, GameEvents *events) {
+    const Ball *seen1 = rewind ? rewind->seen1 : NULL;
+    const Ball *seen2 = rewind ? rewind->seen2 : NULL;
+
+    // Most steps end clear of the walls and in front of both paddle faces,
+    // where nothing can happen but the move (the vector path in
+    // game_batch.c makes the same test)
+    float x = game->ball.x + game->ball.vx * dt;
+    float y = game->ball.y + game->ball.vy * dt;
+    if (!seen1 && !seen2 && y > 0 && y + BALL_SIZE < WINDOW_HEIGHT &&
+        x >= game->player1.x + game->player1.w && x <= game->player2.x - BALL_SIZE) {
+        game->ball.x = x;
+        game->ball.y = y;
+        return;
     }
 
-    // Ball collision with paddles
-    if (ball_collides_paddle(&game->ball, &game->player1)) {
+    ball_sweep(&game->ball, seen1 ? NULL : &game->player1, seen2 ? NULL : &game->player2, dt, events);
+
+    // A paddle judged by what its player saw, or one that moved into the
+    // side of the ball, sends it back from the face
+    if (seen1 ? ball_seen_collides_paddle(&game->ball, seen1, &game->player1, -1.0f, dt)
+              : ball_collides_paddle(&game->ball, &game->player1)) {
         game->ball.x = game->player1.x + game->player1.w;
         game->ball.vx = -game->ball.vx;
-        // Add some spin based on paddle velocity
-        game->ball.vy += game->player1.vy * 0.3f;
-        events.paddle_hit = true;
+        ball_add_spin(&game->ball, &game->player1);
+        events->paddle_hit = true;
     }
 
-    if (ball_collides_paddle(&game->ball, &game->player2)) {
+    if (seen2 ? ball_seen_collides_paddle(&game->ball, seen2, &game->player2, 1.0f, dt)
+              : ball_collides_paddle(&game->ball, &game->player2)) {
         game->ball.x = game->player2.x - BALL_SIZE;
         game->ball.vx = -game->ball.vx;
-        game->ball.vy += game->player2.vy * 0.3f;
-        events.paddle_hit = true;
+        ball_add_spin(&game->ball, &game->player2);
+        events->paddle_hit = true;
     }
 
     // Scoring
+    bool hold = rewind && rewind->hold_goals;
     if (game->ball.x < 0) {
-        game->score2++;
-        ball_reset(&game->ball);
-        events.scored = true;
+        if (hold) {
+            game->ball.x = 0;
+            events->held = 2;
+        } else {
+            game_award_point(game, 2);
+            events->scored = true;
+        }
     }
     if (game->ball.x + BALL_SIZE > WINDOW_WIDTH) {
-        game->score1++;
-        ball_reset(&game->ball);
-        events.scored = true;
+        if (hold) {
+            game->ball.x = WINDOW_WIDTH - BALL_SIZE;
+            events->held = 1;
+        } else {
+            game_award_point(game, 1);
+            events->scored = true;
+        }
     }
+}
 
+// game_update with lag compensation; rewind may be NULL
+GameEvents game_update_rewound(Game *game, float dt, const GameRewind *rewind) {
+    GameEvents events = {false, false, false, 0};
+
+    // Update paddles
+    paddle_update(&game->player1, dt);
+    paddle_update(&game->player2, dt);
+
+    game_update_ball(game, dt, rewind, &events);
     return events;
 }
 
+GameEvents game_update(Game *game, float dt) {
+    return game_update_rewound(game, dt, NULL);
+}
+
+// Advances the game by exactly one fixed tick with both paddles' inputs
+GameEvents game_step(Game *game, uint8_t buttons1, uint8_t buttons2) {
+    paddle_apply_input(&game->player1, buttons1);
+    paddle_apply_input(&game->player2, buttons2);
+    GameEvents events = game_update(game, GAME_DT);
+    game->tick++;
+    return events;
+}
+
+// game_step for the authoritative server, with lag compensation
+GameEvents game_step_rewound(Game *game, uint8_t buttons1, uint8_t buttons2, const GameRewind *rewind) {
+    paddle_apply_input(&game->player1, buttons1);
+    paddle_apply_input(&game->player2, buttons2);
+    GameEvents events = game_update_rewound(game, GAME_DT, rewind);
+    game->tick++;
+    return events;
+}
+
+// Adds a frame's elapsed time and returns how many fixed ticks are now due
+int game_clock_advance(GameClock *clock, uint64_t elapsed_ns) {
+    clock->accumulator_ns += elapsed_ns;
+
+    uint64_t ticks = clock->accumulator_ns / GAME_TICK_NS;
+    if (ticks > GAME_MAX_TICKS_PER_FRAME) {
+        ticks = GAME_MAX_TICKS_PER_FRAME;
+        clock->accumulator_ns = 0;
+    } else {
+        clock->accumulator_ns -= ticks * GAME_TICK_NS;
+    }
+    return (int)ticks;
+}
+
+// Fraction of a tick left in the accumulator, for render interpolation
+float game_clock_alpha(const GameClock *clock) {
+    return (float)clock->accumulator_ns / (float)GAME_TICK_NS;
+}
+
+// Blends the state one tick before `current` into it by alpha, so frames
+// drawn between ticks move smoothly. Only for display: the simulation keeps
+// stepping `current`. A score teleports the ball, so it is not blended then.
+void game_interpolate(Game *out, const Game *previous, const Game *current, float alpha) {
+    *out = *current;
+    if (previous->tick + 1 != current->tick) return;
+
+    out->player1.y = previous->player1.y + (current->player1.y - previous->player1.y) * alpha;
+    out->player2.y = previous->player2.y + (current->player2.y - previous->player2.y) * alpha;
+    if (previous->score1 == current->score1 && previous->score2 == current->score2) {
+        out->ball.x = previous->ball.x + (current->ball.x - previous->ball.x) * alpha;
+        out->ball.y = previous->ball.y + (current->ball.y - previous->ball.y) * alpha;
+    }
+}
+
+static inline void game_events_merge(GameEvents *into, GameEvents events) {
+    into->paddle_hit |= events.paddle_hit;
+    into->wall_hit |= events.wall_hit;
+    into->scored |= events.scored;
+    if (events.held) into->held = events.held;
+}
+
 #endif
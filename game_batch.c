@@ -0,0 +1,396 @@
+#ifndef GAME_BATCH_C
+#define GAME_BATCH_C
+
+// Structure-of-arrays stepping for many matches at once.
+//
+// A GameBatch holds every simulated field of N matches in its own contiguous
+// array. game_batch_step() advances all of them by one fixed tick with AVX2
+// (8 lanes) or SSE2 (4 lanes) kernels, and with a scalar loop elsewhere. The
+// kernels run the exact sequence of float operations game_update() does,
+// with branches replaced by compare masks and blends, so every lane stays
+// bit-identical to stepping a Game with game_step(). That requires no
+// fused multiply-add (see -ffp-contract=off in the build). The kernels only
+// do the ball's plain move: a lane whose ball ends the step at a wall or past
+// a paddle face (a bounce, a swept impact or a point, all rare) finishes its
+// ball on the scalar path.
+//
+// Paddles always use the game_init() geometry; only their y and vy are
+// stored. Finished matches (game_is_over) are left untouched, as the server
+// does.
+
+#include "game.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GAME_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+#define GAME_BATCH_LANES 8  // capacity is padded to a whole AVX2 vector
+
+typedef struct {
+    int count;
+    int capacity;   // multiple of GAME_BATCH_LANES
+
+    float *ball_x, *ball_y, *ball_vx, *ball_vy;
+    float *p1_y, *p1_vy, *p2_y, *p2_vy;
+    int32_t *score1, *score2;
+    uint32_t *rng;
+    uint32_t *tick;
+} GameBatch;
+
+static void *game_batch_alloc(int capacity, size_t size) {
+    // 32-byte aligned for aligned AVX2 loads
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, 32, (size_t)capacity * size) != 0) return NULL;
+    memset(ptr, 0, (size_t)capacity * size);
+    return ptr;
+}
+
+void game_batch_set(GameBatch *batch, int i, const Game *game) {
+    batch->ball_x[i] = game->ball.x;
+    batch->ball_y[i] = game->ball.y;
+    batch->ball_vx[i] = game->ball.vx;
+    batch->ball_vy[i] = game->ball.vy;
+    batch->p1_y[i] = game->player1.y;
+    batch->p1_vy[i] = game->player1.vy;
+    batch->p2_y[i] = game->player2.y;
+    batch->p2_vy[i] = game->player2.vy;
+    batch->score1[i] = game->score1;
+    batch->score2[i] = game->score2;
+    batch->rng[i] = game->rng;
+    batch->tick[i] = game->tick;
+}
+
+// Rebuilds lane i as a Game (key state is not part of the batch)
+void game_batch_get(const GameBatch *batch, int i, Game *game) {
+    game_init(game, 1);
+    game->ball.x = batch->ball_x[i];
+    game->ball.y = batch->ball_y[i];
+    game->ball.vx = batch->ball_vx[i];
+    game->ball.vy = batch->ball_vy[i];
+    game->player1.y = batch->p1_y[i];
+    game->player1.vy = batch->p1_vy[i];
+    game->player2.y = batch->p2_y[i];
+    game->player2.vy = batch->p2_vy[i];
+    game->score1 = batch->score1[i];
+    game->score2 = batch->score2[i];
+    game->rng = batch->rng[i];
+    game->tick = batch->tick[i];
+}
+
+void game_batch_free(GameBatch *batch) {
+    free(batch->ball_x);
+    free(batch->ball_y);
+    free(batch->ball_vx);
+    free(batch->ball_vy);
+    free(batch->p1_y);
+    free(batch->p1_vy);
+    free(batch->p2_y);
+    free(batch->p2_vy);
+    free(batch->score1);
+    free(batch->score2);
+    free(batch->rng);
+    free(batch->tick);
+    memset(batch, 0, sizeof(GameBatch));
+}
+
+// Allocates room for count matches, all initialized with game_init(seed i + 1)
+bool game_batch_init(GameBatch *batch, int count) {
+    memset(batch, 0, sizeof(GameBatch));
+    batch->count = count;
+    batch->capacity = (count + GAME_BATCH_LANES - 1) / GAME_BATCH_LANES * GAME_BATCH_LANES;
+    if (batch->capacity == 0) batch->capacity = GAME_BATCH_LANES;
+
+    int cap = batch->capacity;
+    batch->ball_x = game_batch_alloc(cap, sizeof(float));
+    batch->ball_y = game_batch_alloc(cap, sizeof(float));
+    batch->ball_vx = game_batch_alloc(cap, sizeof(float));
+    batch->ball_vy = game_batch_alloc(cap, sizeof(float));
+    batch->p1_y = game_batch_alloc(cap, sizeof(float));
+    batch->p1_vy = game_batch_alloc(cap, sizeof(float));
+    batch->p2_y = game_batch_alloc(cap, sizeof(float));
+    batch->p2_vy = game_batch_alloc(cap, sizeof(float));
+    batch->score1 = game_batch_alloc(cap, sizeof(int32_t));
+    batch->score2 = game_batch_alloc(cap, sizeof(int32_t));
+    batch->rng = game_batch_alloc(cap, sizeof(uint32_t));
+    batch->tick = game_batch_alloc(cap, sizeof(uint32_t));
+    if (!batch->ball_x || !batch->ball_y || !batch->ball_vx || !batch->ball_vy ||
+        !batch->p1_y || !batch->p1_vy || !batch->p2_y || !batch->p2_vy ||
+        !batch->score1 || !batch->score2 || !batch->rng || !batch->tick) {
+        game_batch_free(batch);
+        return false;
+    }
+
+    // Padding lanes are finished matches, so the kernels never change them
+    for (int i = 0; i < cap; i++) {
+        Game game;
+        game_init(&game, (uint32_t)i + 1);
+        if (i >= count) game.score1 = WINNING_SCORE;
+        game_batch_set(batch, i, &game);
+    }
+    return true;
+}
+
+static inline bool game_batch_over(const GameBatch *batch, int i) {
+    return batch->score1[i] >= WINNING_SCORE || batch->score2[i] >= WINNING_SCORE;
+}
+
+// The ball's part of game_update() for one lane, from the ball as it was
+// before the step and the paddles as they are after it
+static void game_batch_collide(GameBatch *batch, int i) {
+    Game game;
+    game.player1 = (Paddle){ PADDLE_MARGIN, batch->p1_y[i], PADDLE_WIDTH, PADDLE_HEIGHT, batch->p1_vy[i] };
+    game.player2 = (Paddle){ WINDOW_WIDTH - PADDLE_MARGIN - PADDLE_WIDTH, batch->p2_y[i],
+                             PADDLE_WIDTH, PADDLE_HEIGHT, batch->p2_vy[i] };
+    game.ball = (Ball){ batch->ball_x[i], batch->ball_y[i], batch->ball_vx[i], batch->ball_vy[i] };
+    game.score1 = batch->score1[i];
+    game.score2 = batch->score2[i];
+    game.rng = batch->rng[i];
+
+    GameEvents events = {false, false, false, 0};
+    game_update_ball(&game, GAME_DT, NULL, &events);
+
+    batch->ball_x[i] = game.ball.x;
+    batch->ball_y[i] = game.ball.y;
+    batch->ball_vx[i] = game.ball.vx;
+    batch->ball_vy[i] = game.ball.vy;
+    batch->score1[i] = game.score1;
+    batch->score2[i] = game.score2;
+    batch->rng[i] = game.rng;
+}
+
+// Reference path: game_step() on one lane, field by field
+static void game_batch_step_scalar(GameBatch *batch, int begin, int end,
+                                   const uint8_t *buttons1, const uint8_t *buttons2) {
+    Paddle p1 = { PADDLE_MARGIN, 0, PADDLE_WIDTH, PADDLE_HEIGHT, 0 };
+    Paddle p2 = { WINDOW_WIDTH - PADDLE_MARGIN - PADDLE_WIDTH, 0, PADDLE_WIDTH, PADDLE_HEIGHT, 0 };
+
+    for (int i = begin; i < end; i++) {
+        if (game_batch_over(batch, i)) continue;
+
+        Game game;
+        game.player1 = p1;
+        game.player2 = p2;
+        game.player1.y = batch->p1_y[i];
+        game.player1.vy = batch->p1_vy[i];
+        game.player2.y = batch->p2_y[i];
+        game.player2.vy = batch->p2_vy[i];
+        game.ball = (Ball){ batch->ball_x[i], batch->ball_y[i], batch->ball_vx[i], batch->ball_vy[i] };
+        game.score1 = batch->score1[i];
+        game.score2 = batch->score2[i];
+        game.rng = batch->rng[i];
+
+        paddle_apply_input(&game.player1, buttons1[i]);
+        paddle_apply_input(&game.player2, buttons2[i]);
+        game_update(&game, GAME_DT);
+
+        batch->ball_x[i] = game.ball.x;
+        batch->ball_y[i] = game.ball.y;
+        batch->ball_vx[i] = game.ball.vx;
+        batch->ball_vy[i] = game.ball.vy;
+        batch->p1_y[i] = game.player1.y;
+        batch->p1_vy[i] = game.player1.vy;
+        batch->p2_y[i] = game.player2.y;
+        batch->p2_vy[i] = game.player2.vy;
+        batch->score1[i] = game.score1;
+        batch->score2[i] = game.score2;
+        batch->rng[i] = game.rng;
+        batch->tick[i]++;
+    }
+}
+
+#ifdef GAME_BATCH_X86
+
+// One kernel body for both vector widths. V is the float vector type and the
+// macros map to its intrinsics; every step mirrors a line of game_update().
+#define GAME_BATCH_KERNEL(V, W, LOAD, STORE, SET1, ADD, MUL, XOR, AND, OR,           \
+                          BLEND, CMPLT, CMPLE, CMPGT, CMPGE, MOVEMASK, LIVE, TICK, \
+                          INPUT)                                                     \
+    const V dt = SET1(GAME_DT);                                                      \
+    const V zero = SET1(0.0f);                                                       \
+    const V all = CMPGE(zero, zero);                                                 \
+    const V height = SET1((float)WINDOW_HEIGHT);                                     \
+    const V paddle_h = SET1((float)PADDLE_HEIGHT);                                   \
+    const V paddle_max = SET1(WINDOW_HEIGHT - (float)PADDLE_HEIGHT);                 \
+    const V ball_size = SET1((float)BALL_SIZE);                                      \
+    const V p1_face = SET1((float)PADDLE_MARGIN + PADDLE_WIDTH);                     \
+    const V p2_face = SET1((float)(WINDOW_WIDTH - PADDLE_MARGIN - PADDLE_WIDTH       \
+                                   - BALL_SIZE));                                    \
+                                                                                     \
+    for (int i = begin; i < end; i += W) {                                           \
+        V live = LIVE(i);                                                            \
+        V p1y = LOAD(batch->p1_y + i), p1vy = LOAD(batch->p1_vy + i);                \
+        V p2y = LOAD(batch->p2_y + i), p2vy = LOAD(batch->p2_vy + i);                \
+        V bx = LOAD(batch->ball_x + i), by = LOAD(batch->ball_y + i);                \
+        V bvx = LOAD(batch->ball_vx + i), bvy = LOAD(batch->ball_vy + i);            \
+                                                                                     \
+        /* paddle_apply_input() */                                                   \
+        p1vy = BLEND(p1vy, INPUT(buttons1 + i), live);                               \
+        p2vy = BLEND(p2vy, INPUT(buttons2 + i), live);                               \
+        STORE(batch->p1_vy + i, p1vy);                                               \
+        STORE(batch->p2_vy + i, p2vy);                                               \
+                                                                                     \
+        /* paddle_update() */                                                        \
+        p1y = ADD(p1y, MUL(p1vy, dt));                                               \
+        p1y = BLEND(p1y, zero, CMPLT(p1y, zero));                                    \
+        p1y = BLEND(p1y, paddle_max, CMPGT(ADD(p1y, paddle_h), height));             \
+        p2y = ADD(p2y, MUL(p2vy, dt));                                               \
+        p2y = BLEND(p2y, zero, CMPLT(p2y, zero));                                    \
+        p2y = BLEND(p2y, paddle_max, CMPGT(ADD(p2y, paddle_h), height));             \
+        STORE(batch->p1_y + i, BLEND(LOAD(batch->p1_y + i), p1y, live));             \
+        STORE(batch->p2_y + i, BLEND(LOAD(batch->p2_y + i), p2y, live));             \
+                                                                                     \
+        /* game_update_ball() with nothing in the way */                             \
+        bx = ADD(bx, MUL(bvx, dt));                                                  \
+        by = ADD(by, MUL(bvy, dt));                                                  \
+                                                                                     \
+        /* Lanes that reach a wall or pass a paddle face finish on the scalar */     \
+        /* path; finished matches keep their old values */                           \
+        V slow = OR(OR(CMPLE(by, zero), CMPGE(ADD(by, ball_size), height)),          \
+                    OR(CMPLT(bx, p1_face), CMPGT(bx, p2_face)));                     \
+        V moved = AND(live, XOR(slow, all));                                         \
+        STORE(batch->ball_x + i, BLEND(LOAD(batch->ball_x + i), bx, moved));         \
+        STORE(batch->ball_y + i, BLEND(LOAD(batch->ball_y + i), by, moved));         \
+                                                                                     \
+        int collide = MOVEMASK(AND(slow, live));                                     \
+        for (int l = 0; collide; l++, collide >>= 1) {                               \
+            if (collide & 1) game_batch_collide(batch, i + l);                       \
+        }                                                                            \
+        TICK(i, live);                                                               \
+    }
+
+// SSE2 has no blendv: (a & ~m) | (b & m)
+static inline __m128 sse_blend(__m128 a, __m128 b, __m128 m) {
+    return _mm_or_ps(_mm_andnot_ps(m, a), _mm_and_ps(m, b));
+}
+
+static inline __m128 sse_live(const GameBatch *batch, int i) {
+    __m128i limit = _mm_set1_epi32(WINNING_SCORE);
+    __m128i s1 = _mm_load_si128((const __m128i *)(batch->score1 + i));
+    __m128i s2 = _mm_load_si128((const __m128i *)(batch->score2 + i));
+    __m128i live = _mm_and_si128(_mm_cmplt_epi32(s1, limit), _mm_cmplt_epi32(s2, limit));
+    return _mm_castsi128_ps(live);
+}
+
+// paddle_apply_input() for 4 lanes of buttons. Both buttons cancel to +0,
+// just as 0 - SPEED + SPEED does.
+static inline __m128 sse_input_vy(const uint8_t *buttons) {
+    int32_t packed;
+    memcpy(&packed, buttons, sizeof(packed));
+    __m128i zero = _mm_setzero_si128();
+    __m128i b = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    __m128 up = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, _mm_set1_epi32(INPUT_UP)), _mm_set1_epi32(INPUT_UP)));
+    __m128 down = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, _mm_set1_epi32(INPUT_DOWN)), _mm_set1_epi32(INPUT_DOWN)));
+    return _mm_or_ps(_mm_and_ps(_mm_andnot_ps(down, up), _mm_set1_ps(-PADDLE_SPEED)),
+                     _mm_and_ps(_mm_andnot_ps(up, down), _mm_set1_ps(PADDLE_SPEED)));
+}
+
+// tick - (-1) on live lanes
+static inline void sse_tick(GameBatch *batch, int i, __m128 live) {
+    __m128i *tick = (__m128i *)(batch->tick + i);
+    _mm_store_si128(tick, _mm_sub_epi32(_mm_load_si128(tick), _mm_castps_si128(live)));
+}
+
+static void game_batch_step_sse2(GameBatch *batch, int begin, int end,
+                                 const uint8_t *buttons1, const uint8_t *buttons2) {
+#define SSE_LIVE(i) sse_live(batch, i)
+#define SSE_TICK(i, live) sse_tick(batch, i, live)
+
+    GAME_BATCH_KERNEL(__m128, 4, _mm_load_ps, _mm_store_ps, _mm_set1_ps, _mm_add_ps,
+                      _mm_mul_ps, _mm_xor_ps, _mm_and_ps, _mm_or_ps, sse_blend, _mm_cmplt_ps,
+                      _mm_cmple_ps, _mm_cmpgt_ps, _mm_cmpge_ps, _mm_movemask_ps, SSE_LIVE, SSE_TICK,
+                      sse_input_vy)
+#undef SSE_LIVE
+#undef SSE_TICK
+}
+
+__attribute__((target("avx2")))
+static inline __m256 avx2_live(const GameBatch *batch, int i) {
+    __m256i limit = _mm256_set1_epi32(WINNING_SCORE);
+    __m256i s1 = _mm256_load_si256((const __m256i *)(batch->score1 + i));
+    __m256i s2 = _mm256_load_si256((const __m256i *)(batch->score2 + i));
+    __m256i live = _mm256_and_si256(_mm256_cmpgt_epi32(limit, s1), _mm256_cmpgt_epi32(limit, s2));
+    return _mm256_castsi256_ps(live);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 avx2_input_vy(const uint8_t *buttons) {
+    __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)buttons));
+    __m256 up = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(b, _mm256_set1_epi32(INPUT_UP)),
+                                                       _mm256_set1_epi32(INPUT_UP)));
+    __m256 down = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(b, _mm256_set1_epi32(INPUT_DOWN)),
+                                                         _mm256_set1_epi32(INPUT_DOWN)));
+    return _mm256_or_ps(_mm256_and_ps(_mm256_andnot_ps(down, up), _mm256_set1_ps(-PADDLE_SPEED)),
+                        _mm256_and_ps(_mm256_andnot_ps(up, down), _mm256_set1_ps(PADDLE_SPEED)));
+}
+
+__attribute__((target("avx2")))
+static inline void avx2_tick(GameBatch *batch, int i, __m256 live) {
+    __m256i *tick = (__m256i *)(batch->tick + i);
+    _mm256_store_si256(tick, _mm256_sub_epi32(_mm256_load_si256(tick), _mm256_castps_si256(live)));
+}
+
+#define AVX_CMPLT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define AVX_CMPLE(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define AVX_CMPGT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define AVX_CMPGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+
+__attribute__((target("avx2")))
+static void game_batch_step_avx2(GameBatch *batch, int begin, int end,
+                                 const uint8_t *buttons1, const uint8_t *buttons2) {
+#define AVX_LIVE(i) avx2_live(batch, i)
+#define AVX_TICK(i, live) avx2_tick(batch, i, live)
+    GAME_BATCH_KERNEL(__m256, 8, _mm256_load_ps, _mm256_store_ps, _mm256_set1_ps, _mm256_add_ps,
+                      _mm256_mul_ps, _mm256_xor_ps, _mm256_and_ps, _mm256_or_ps,
+                      _mm256_blendv_ps, AVX_CMPLT, AVX_CMPLE, AVX_CMPGT, AVX_CMPGE,
+                      _mm256_movemask_ps, AVX_LIVE, AVX_TICK, avx2_input_vy)
+#undef AVX_LIVE
+#undef AVX_TICK
+}
+
+#endif
+
+typedef enum {
+    GAME_BATCH_SCALAR,
+    GAME_BATCH_SSE2,
+    GAME_BATCH_AVX2,
+} GameBatchKernel;
+
+// Widest kernel this CPU runs
+GameBatchKernel game_batch_best_kernel(void) {
+#ifdef GAME_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return GAME_BATCH_AVX2;
+    return GAME_BATCH_SSE2;
+#else
+    return GAME_BATCH_SCALAR;
+#endif
+}
+
+const char *game_batch_kernel_name(GameBatchKernel kernel) {
+    switch (kernel) {
+        case GAME_BATCH_AVX2: return "avx2";
+        case GAME_BATCH_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+// game_step() for every live match in lanes [begin, end) with one tick of
+// buttons (INPUT_UP | INPUT_DOWN) per lane. begin and end must be multiples
+// of GAME_BATCH_LANES, and the button arrays hold batch->capacity entries
+// (padding lanes are read but ignored).
+void game_batch_step(GameBatch *batch, int begin, int end, const uint8_t *buttons1,
+                     const uint8_t *buttons2, GameBatchKernel kernel) {
+    switch (kernel) {
+#ifdef GAME_BATCH_X86
+        case GAME_BATCH_AVX2: game_batch_step_avx2(batch, begin, end, buttons1, buttons2); break;
+        case GAME_BATCH_SSE2: game_batch_step_sse2(batch, begin, end, buttons1, buttons2); break;
+#endif
+        default: game_batch_step_scalar(batch, begin, end, buttons1, buttons2); break;
+    }
+}
+
+#endif
@@ -0,0 +1,435 @@
+// Tests for the simulation in game.c
+//
+// Without arguments it runs the ball through game_update_ball() in the
+// cases a discrete overlap test gets wrong: a ball that covers more than a
+// paddle's width in one tick, a hit on a paddle's corner, a wall and a
+// paddle in the same tick, a paddle that moves into the ball's path, and a
+// lag-compensated paddle that the ball its player saw went through. It
+// then steps matches through game_step() and through every game_batch.c
+// kernel this CPU runs and checks each lane stays bit-identical.
+//
+// The Go match handler (nakama/modules/go/game.go) is a port of game.c that
+// must stay bit-identical to it. This records a trace of seeds, inputs and
+// the state after every tick, and game_test.go replays it through the port.
+// Run against the committed trace, it also checks that game.c itself still
+// produces it, so a physics change fails here until the trace is recorded
+// again (and the Go port updated to match).
+//
+//   game_test                  collision cases and batch kernel parity
+//   game_test --check FILE     replay a trace through game.c
+//   game_test --record FILE    write a new trace
+//
+// Trace format, one line per record, floats as the hex of their bits:
+//   game SEED DT BALL_X BALL_Y BALL_VX BALL_VY PADDLE1_Y PADDLE2_Y
+//     game_init(SEED), then the ball and paddles are placed as given and
+//     every following tick steps DT seconds
+//   BUTTONS1 BUTTONS2 BALL_X BALL_Y BALL_VX BALL_VY PADDLE1_Y PADDLE2_Y
+//   SCORE1 SCORE2 RNG EVENTS
+//     one tick: the inputs applied, then the state after game_update and
+//     its events as three digits (paddle_hit, wall_hit, scored)
+
+#include "game.c"
+#include "game_batch.c"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_GAMES 32
+#define TRACE_TICKS 64
+#define BATCH_GAMES 64      // multiple of GAME_BATCH_LANES
+#define BATCH_TICKS 3000
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Close enough for positions after a bounce, which round differently from
+// the straight-line arithmetic the expectations use
+#define NEAR(a, b) (fabsf((a) - (b)) < 0.01f)
+
+static uint32_t float_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float bits_float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// Writes one traced tick into line, in the format above
+static void trace_format_tick(char *line, size_t size, uint8_t buttons1, uint8_t buttons2,
+                              const Game *game, GameEvents events) {
+    snprintf(line, size, "%u %u %08x %08x %08x %08x %08x %08x %d %d %08x %d%d%d",
+             buttons1, buttons2,
+             float_bits(game->ball.x), float_bits(game->ball.y),
+             float_bits(game->ball.vx), float_bits(game->ball.vy),
+             float_bits(game->player1.y), float_bits(game->player2.y),
+             game->score1, game->score2, game->rng,
+             events.paddle_hit, events.wall_hit, events.scored);
+}
+
+// Scripted matches: half start from the serve at the fixed tick, the rest
+// from random positions and velocities up to 5000 px/s with step lengths
+// up to a whole second, so the sweep and its bounce limit are exercised
+static int trace_record(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+
+    static const int rates[] = { 60, 30, 20, 10, 4, 2, 1 };
+    uint32_t rng = 12345;
+    for (int g = 0; g < TRACE_GAMES; g++) {
+        Game game;
+        game_init(&game, (uint32_t)g);
+        float dt = GAME_DT;
+        if (g % 2) {
+            dt = 1.0f / (float)rates[game_rand(&rng) % 7];
+            game.ball.x = (float)(int)(game_rand(&rng) % (WINDOW_WIDTH - BALL_SIZE + 1));
+            game.ball.y = (float)(int)(game_rand(&rng) % (WINDOW_HEIGHT - BALL_SIZE + 1));
+            game.ball.vx = (float)((int)(game_rand(&rng) % 10001) - 5000);
+            game.ball.vy = (float)((int)(game_rand(&rng) % 6001) - 3000);
+            game.player1.y = (float)(int)(game_rand(&rng) % (WINDOW_HEIGHT - PADDLE_HEIGHT + 1));
+            game.player2.y = (float)(int)(game_rand(&rng) % (WINDOW_HEIGHT - PADDLE_HEIGHT + 1));
+        }
+        fprintf(file, "game %d %08x %08x %08x %08x %08x %08x %08x\n", g, float_bits(dt),
+                float_bits(game.ball.x), float_bits(game.ball.y),
+                float_bits(game.ball.vx), float_bits(game.ball.vy),
+                float_bits(game.player1.y), float_bits(game.player2.y));
+
+        for (int t = 0; t < TRACE_TICKS; t++) {
+            uint32_t r = game_rand(&rng);
+            uint8_t buttons1 = (uint8_t)(r % 3);
+            uint8_t buttons2 = (uint8_t)((r >> 4) % 3);
+            paddle_apply_input(&game.player1, buttons1);
+            paddle_apply_input(&game.player2, buttons2);
+            GameEvents events = game_update(&game, dt);
+
+            char line[160];
+            trace_format_tick(line, sizeof(line), buttons1, buttons2, &game, events);
+            fprintf(file, "%s\n", line);
+        }
+    }
+
+    if (fclose(file) != 0) {
+        perror(path);
+        return 1;
+    }
+    printf("game_test: recorded %d games of %d ticks to %s\n", TRACE_GAMES, TRACE_TICKS, path);
+    return 0;
+}
+
+static int trace_check(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+
+    Game game;
+    float dt = GAME_DT;
+    bool started = false;
+    int line_no = 0;
+    int ticks = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        line_no++;
+        line[strcspn(line, "\n")] = '\0';
+
+        unsigned seed;
+        unsigned b[7];
+        if (sscanf(line, "game %u %x %x %x %x %x %x %x", &seed, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6]) == 8) {
+            game_init(&game, seed);
+            dt = bits_float(b[0]);
+            game.ball = (Ball){ bits_float(b[1]), bits_float(b[2]), bits_float(b[3]), bits_float(b[4]) };
+            game.player1.y = bits_float(b[5]);
+            game.player2.y = bits_float(b[6]);
+            started = true;
+            continue;
+        }
+
+        unsigned buttons1, buttons2;
+        if (!started || sscanf(line, "%u %u", &buttons1, &buttons2) != 2) {
+            fprintf(stderr, "%s:%d: malformed line\n", path, line_no);
+            fclose(file);
+            return 1;
+        }
+        paddle_apply_input(&game.player1, (uint8_t)buttons1);
+        paddle_apply_input(&game.player2, (uint8_t)buttons2);
+        GameEvents events = game_update(&game, dt);
+
+        char got[160];
+        trace_format_tick(got, sizeof(got), (uint8_t)buttons1, (uint8_t)buttons2, &game, events);
+        if (strcmp(got, line) != 0) {
+            fprintf(stderr, "%s:%d: game.c diverges from the trace\n  want %s\n  got  %s\n", path, line_no, line, got);
+            fclose(file);
+            return 1;
+        }
+        ticks++;
+    }
+    fclose(file);
+
+    if (ticks == 0) {
+        fprintf(stderr, "%s: no ticks\n", path);
+        return 1;
+    }
+    printf("game_test: %d ticks match %s\n", ticks, path);
+    return 0;
+}
+
+// A game with the ball and paddles placed as given, paddles standing still
+static Game test_game(float x, float y, float vx, float vy, float paddle1_y, float paddle2_y) {
+    Game game;
+    game_init(&game, 1);
+    game.ball = (Ball){ x, y, vx, vy };
+    game.player1.y = paddle1_y;
+    game.player2.y = paddle2_y;
+    return game;
+}
+
+// One tick of the ball alone, as game_update() runs it after the paddles
+static GameEvents test_ball_tick(Game *game, float dt) {
+    GameEvents events = {false, false, false, 0};
+    game_update_ball(game, dt, NULL, &events);
+    return events;
+}
+
+// 10000 px/s covers 167 px a tick, eleven paddle widths. The left face is
+// at x = 45 and the right face at x = 755 - BALL_SIZE = 740.
+static void test_faster_than_paddle(void) {
+    Game game = test_game(100, 300, -10000, 0, 250, 250);
+    GameEvents events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.paddle_hit && !events.scored);
+    CHECK(game.ball.vx == 10000 && game.ball.vy == 0);
+    // 55 px to the face, the rest of the tick back out
+    CHECK(NEAR(game.ball.x, 45 + 10000 * GAME_DT - 55));
+
+    game = test_game(700, 300, 10000, 0, 250, 250);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.paddle_hit && game.ball.vx == -10000);
+    CHECK(NEAR(game.ball.x, 740 - (10000 * GAME_DT - 40)));
+
+    // A whole second in one step at serve speed still meets the paddle
+    game = test_game(392.5f, 292.5f, -350, 0, 250, 250);
+    events = test_ball_tick(&game, 1.0f);
+    CHECK(events.paddle_hit && game.ball.vx == 350);
+    CHECK(NEAR(game.ball.x, 45 + 350 - (392.5f - 45)));
+
+    // One pixel clear of the paddle's end it goes through to score
+    game = test_game(100, 250 - BALL_SIZE - 1, -10000, 0, 250, 250);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(!events.paddle_hit && events.scored && game.score2 == 1);
+}
+
+// Coming down and left at the paddle's top corner (x 30..45, y from 250):
+// starting at (50, 230) the ball reaches x = 45 and y = 235 at the same
+// moment, 1/120 s in, and bounces off the face. Four pixels higher it is
+// still above the paddle when it has passed the face, and goes on to score.
+static void test_paddle_corner(void) {
+    Game game = test_game(50, 230, -600, 600, 250, 250);
+    GameEvents events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.paddle_hit && game.ball.vx == 600 && game.ball.vy == 600);
+    CHECK(NEAR(game.ball.x, 45 + 600 * (GAME_DT - 1.0f / 120)));
+    CHECK(NEAR(game.ball.y, 235 + 600 * (GAME_DT - 1.0f / 120)));
+
+    // At 6000 px/s the ball crosses the paddle's width in 5 ms and is clear
+    // of it by the end of the tick, 20 px past the goal line
+    game = test_game(80, 226, -6000, 600, 250, 250);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(!events.paddle_hit && events.scored);
+
+    // Four pixels lower it catches the corner inside the same tick
+    game = test_game(80, 230, -6000, 600, 250, 250);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.paddle_hit && !events.scored && game.ball.vx == 6000);
+}
+
+// At 3000 px/s across and 600 px/s up from (70, 2) the ball meets the top
+// wall at x = 60, then the left paddle's face at x = 45 and y = 3, both
+// within one tick
+static void test_wall_and_paddle(void) {
+    Game game = test_game(70, 2, -3000, -600, 0, 250);
+    GameEvents events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.wall_hit && events.paddle_hit && !events.scored);
+    CHECK(game.ball.vx == 3000 && game.ball.vy == 600);
+    // 25 px of travel across were used getting to the face
+    CHECK(NEAR(game.ball.x, 45 + 3000 * GAME_DT - 25));
+    CHECK(NEAR(game.ball.y, 3 + 600 * (GAME_DT - 25.0f / 3000)));
+
+    // The same off the bottom wall into the right paddle
+    game = test_game(WINDOW_WIDTH - BALL_SIZE - 70, WINDOW_HEIGHT - BALL_SIZE - 2, 3000, 600, 250, WINDOW_HEIGHT - PADDLE_HEIGHT);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.wall_hit && events.paddle_hit && !events.scored);
+    CHECK(game.ball.vx == -3000 && game.ball.vy == -600);
+    CHECK(NEAR(game.ball.x, 740 - (3000 * GAME_DT - 25)));
+}
+
+// A paddle moving down over a ball just below it: before the tick the ball
+// (y 302..317) clears the paddle (250..350 shifted up by 48, so 202..302);
+// after the paddles move it does not, and the ball goes back with the
+// paddle's spin
+static void test_moving_paddle(void) {
+    Game game = test_game(60, 302, -1200, 0, 202, 250);
+    paddle_apply_input(&game.player1, INPUT_DOWN);
+    paddle_update(&game.player1, GAME_DT);
+    GameEvents events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.paddle_hit && !events.scored);
+    CHECK(game.ball.vx == 1200);
+    CHECK(game.ball.vy == PADDLE_SPEED * 0.3f);
+
+    // Standing still the same ball passes under it
+    game = test_game(60, 302, -1200, 0, 202, 250);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(!events.paddle_hit && game.ball.vx == -1200);
+
+    // Spin is capped however fast the ball is already moving
+    game = test_game(60, 280, -1200, BALL_MAX_VY - 50, 202, 250);
+    paddle_apply_input(&game.player1, INPUT_DOWN);
+    paddle_update(&game.player1, GAME_DT);
+    events = test_ball_tick(&game, GAME_DT);
+    CHECK(events.paddle_hit && game.ball.vy == BALL_MAX_VY);
+}
+
+// With lag compensation the left paddle is judged by the ball its player
+// saw. At 10000 px/s that ball was in front of the paddle one frame and is
+// behind it the next, never overlapping it; the player saw it go through
+// the paddle, so the real ball comes back off the face.
+static void test_seen_faster_than_paddle(void) {
+    Ball seen = { 10, 300, -10000, 0 };
+    GameRewind rewind = { &seen, NULL, true };
+
+    Game game = test_game(400, 300, -10000, 0, 250, 250);
+    GameEvents events = {false, false, false, 0};
+    game_update_ball(&game, GAME_DT, &rewind, &events);
+    CHECK(events.paddle_hit && !events.held);
+    CHECK(game.ball.vx == 10000 && game.ball.x == 45);
+
+    // One pixel clear of the paddle's end it is a miss
+    seen.y = 250 - BALL_SIZE - 1;
+    game = test_game(100, 300, -10000, 0, 250, 250);
+    events = (GameEvents){false, false, false, 0};
+    game_update_ball(&game, GAME_DT, &rewind, &events);
+    CHECK(!events.paddle_hit && events.held == 2 && game.ball.x == 0);
+
+    // A held goal survives merging the ticks of one frame
+    GameEvents merged = {false, false, false, 0};
+    game_events_merge(&merged, events);
+    game_events_merge(&merged, (GameEvents){false, true, false, 0});
+    CHECK(merged.held == 2 && merged.wall_hit);
+}
+
+// Lane i's fields against the reference game, bit for bit
+static bool batch_lane_matches(const GameBatch *batch, int i, const Game *want) {
+    Game got;
+    game_batch_get(batch, i, &got);
+    float a[] = { got.ball.x, got.ball.y, got.ball.vx, got.ball.vy,
+                  got.player1.y, got.player1.vy, got.player2.y, got.player2.vy };
+    float b[] = { want->ball.x, want->ball.y, want->ball.vx, want->ball.vy,
+                  want->player1.y, want->player1.vy, want->player2.y, want->player2.vy };
+    for (size_t f = 0; f < sizeof(a) / sizeof(a[0]); f++) {
+        if (float_bits(a[f]) != float_bits(b[f])) return false;
+    }
+    return got.score1 == want->score1 && got.score2 == want->score2 &&
+           got.rng == want->rng && got.tick == want->tick;
+}
+
+// Steps the same matches through game_step() and through `kernel`. A
+// quarter start with the ball anywhere at up to 3000 px/s, and the left
+// paddle chases the ball, so lanes keep leaving the vector path for
+// game_batch_collide() at walls, paddles and goals. A finished match starts
+// over from its rng on both sides.
+static void test_batch_kernel(GameBatchKernel kernel) {
+    static Game games[BATCH_GAMES];
+    static uint8_t buttons1[BATCH_GAMES], buttons2[BATCH_GAMES];
+    GameBatch batch;
+    if (!game_batch_init(&batch, BATCH_GAMES)) {
+        fprintf(stderr, "Out of memory\n");
+        failures++;
+        return;
+    }
+
+    uint32_t rng = 7;
+    for (int i = 0; i < BATCH_GAMES; i++) {
+        game_init(&games[i], (uint32_t)i + 1);
+        if (i % 4 == 0) {
+            float left = PADDLE_MARGIN + PADDLE_WIDTH;
+            float right = WINDOW_WIDTH - PADDLE_MARGIN - PADDLE_WIDTH - BALL_SIZE;
+            games[i].ball.x = left + (game_rand(&rng) % 1000) / 1000.0f * (right - left);
+            games[i].ball.y = (game_rand(&rng) % 1000) / 1000.0f * (WINDOW_HEIGHT - BALL_SIZE);
+            games[i].ball.vx = ((int)(game_rand(&rng) % 600001) - 300000) / 100.0f;
+            games[i].ball.vy = ((int)(game_rand(&rng) % 600001) - 300000) / 100.0f;
+        }
+        game_batch_set(&batch, i, &games[i]);
+    }
+
+    int events[3] = {0, 0, 0};
+    int mismatches = 0;
+    for (int t = 0; t < BATCH_TICKS && !mismatches; t++) {
+        for (int i = 0; i < BATCH_GAMES; i++) {
+            if (game_is_over(&games[i])) {
+                game_init(&games[i], games[i].rng);
+                game_batch_set(&batch, i, &games[i]);
+            }
+            float center = games[i].player1.y + PADDLE_HEIGHT / 2.0f;
+            float target = games[i].ball.y + BALL_SIZE / 2.0f;
+            buttons1[i] = target < center - 10 ? INPUT_UP : target > center + 10 ? INPUT_DOWN : 0;
+            buttons2[i] = (uint8_t)(game_rand(&rng) % 3);
+
+            GameEvents e = game_step(&games[i], buttons1[i], buttons2[i]);
+            events[0] += e.paddle_hit;
+            events[1] += e.wall_hit;
+            events[2] += e.scored;
+        }
+        game_batch_step(&batch, 0, BATCH_GAMES, buttons1, buttons2, kernel);
+
+        for (int i = 0; i < BATCH_GAMES; i++) {
+            if (!batch_lane_matches(&batch, i, &games[i])) {
+                fprintf(stderr, "batch %s: lane %d diverges from game_step at tick %d\n",
+                        game_batch_kernel_name(kernel), i, t);
+                mismatches++;
+            }
+        }
+    }
+    failures += mismatches;
+    // The slow path has to have been taken for the comparison to mean much
+    if (!mismatches) CHECK(events[0] > 0 && events[1] > 0 && events[2] > 0);
+    game_batch_free(&batch);
+}
+
+static int test_collisions(void) {
+    test_faster_than_paddle();
+    test_paddle_corner();
+    test_wall_and_paddle();
+    test_moving_paddle();
+    test_seen_faster_than_paddle();
+    for (int kernel = GAME_BATCH_SCALAR; kernel <= (int)game_batch_best_kernel(); kernel++) {
+        test_batch_kernel((GameBatchKernel)kernel);
+    }
+
+    if (failures) {
+        fprintf(stderr, "game_test: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("game_test: all checks passed\n");
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 1) return test_collisions();
+    if (argc == 3 && strcmp(argv[1], "--record") == 0) return trace_record(argv[2]);
+    if (argc == 3 && strcmp(argv[1], "--check") == 0) return trace_check(argv[2]);
+
+    fprintf(stderr, "Usage: %s [--check FILE | --record FILE]\n", argv[0]);
+    return 2;
+}
@@ -22,13 +22,12 @@ void input_handle_event(Game *game, SDL_Event *event) {
     }
 }
 
-void input_update(Game *game) {
-    // Update local player paddle velocity based on input
-    game->player1.vy = 0;
-    if (game->key_up) game->player1.vy -= PADDLE_SPEED;
-    if (game->key_down) game->player1.vy += PADDLE_SPEED;
-
-    // player2 is controlled via network - implement UDP to update player2.vy
+// Local paddle buttons as INPUT_UP | INPUT_DOWN bits
+uint8_t input_buttons(Game *game) {
+    uint8_t buttons = 0;
+    if (game->key_up) buttons |= INPUT_UP;
+    if (game->key_down) buttons |= INPUT_DOWN;
+    return buttons;
 }
 
 #endif
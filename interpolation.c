@@ -0,0 +1,199 @@
+#ifndef INTERPOLATION_C
+#define INTERPOLATION_C
+
+// Snapshot interpolation for entities the client does not predict (the ball
+// and the opponent's paddle).
+//
+// Server states are buffered with their server time: the tick they were
+// sent on, as a packet seq, times GAME_TICK_NS. The UDP server sends one
+// state per tick; a Nakama match sends one every few ticks, and fewer while
+// idle. Remote entities are drawn slightly in the past, between the two
+// buffered states around "now - delay".
+//
+// The delay covers the spacing between states and arrival jitter. A longer
+// gap between states counts at once, a shorter one eases in so the view
+// does not jump ahead. Jitter is tracked the way RTP does (a running mean of
+// how far each arrival strays from the expected time); its part of the
+// delay grows quickly when packets get late and shrinks slowly when they
+// are steady. If the buffer runs dry the newest state is extrapolated along
+// its velocity for at most INTERP_MAX_EXTRAPOLATE_NS.
+
+#include "game.c"
+#include "network.c"
+
+#include <math.h>
+#include <string.h>
+
+#define INTERP_BUFFER 32    // power of two, buffered server states
+
+#define INTERP_MIN_DELAY_NS ((double)GAME_TICK_NS)
+#define INTERP_MAX_DELAY_NS 250000000.0
+#define INTERP_JITTER_MARGIN 3.0    // delay = one tick + this many mean deviations
+#define INTERP_MAX_EXTRAPOLATE_NS 50000000.0
+
+typedef struct {
+    GameState states[INTERP_BUFFER];
+    int64_t times[INTERP_BUFFER];   // server time in ns
+    int count;
+    int newest;
+
+    uint16_t last_seq;
+    int64_t server_ticks;           // last_seq unwrapped
+
+    // Clock estimate
+    bool synced;
+    double offset_ns;   // local arrival time minus server time, smoothed
+    double jitter_ns;   // mean deviation of arrivals from offset_ns
+    double delay_ns;    // how far in the past remote entities are drawn, for jitter
+    double spacing_ns;  // further delay for states sent less often than every tick
+    double render_ns;   // server time of the last sample; it never goes back
+    int64_t view;       // server tick of the last sample, in 1/256 ticks
+
+    // Stats
+    uint32_t frames;
+    uint32_t extrapolated;  // frames drawn past the newest state
+} Interpolator;
+
+void interpolation_reset(Interpolator *interp) {
+    memset(interp, 0, sizeof(Interpolator));
+    interp->newest = -1;
+}
+
+// Buffers a server state received at local time now_ns. States must arrive
+// in seq order (the caller already drops stale packets).
+void interpolation_push(Interpolator *interp, uint16_t seq, const GameState *state, uint64_t now_ns) {
+    if (interp->count == 0) {
+        interp->server_ticks = seq;
+    } else {
+        interp->server_ticks += (int16_t)(seq - interp->last_seq);
+    }
+    interp->last_seq = seq;
+
+    int64_t server_ns = interp->server_ticks * (int64_t)GAME_TICK_NS;
+    if (interp->count > 0) {
+        double spacing = (double)(server_ns - interp->times[interp->newest]) - INTERP_MIN_DELAY_NS;
+        if (spacing < 0.0) spacing = 0.0;
+        if (spacing > interp->spacing_ns) {
+            interp->spacing_ns = spacing;
+        } else {
+            interp->spacing_ns += (spacing - interp->spacing_ns) / 10.0;
+        }
+    }
+    interp->newest = (interp->newest + 1) & (INTERP_BUFFER - 1);
+    interp->states[interp->newest] = *state;
+    interp->times[interp->newest] = server_ns;
+    if (interp->count < INTERP_BUFFER) interp->count++;
+
+    double sample = (double)(int64_t)now_ns - (double)server_ns;
+    if (!interp->synced) {
+        interp->offset_ns = sample;
+        interp->jitter_ns = 0.0;
+        interp->delay_ns = 2.0 * INTERP_MIN_DELAY_NS;
+        interp->synced = true;
+        return;
+    }
+
+    double deviation = sample - interp->offset_ns;
+    interp->offset_ns += deviation / 16.0;
+    interp->jitter_ns += ((deviation < 0 ? -deviation : deviation) - interp->jitter_ns) / 16.0;
+
+    double target = INTERP_MIN_DELAY_NS + INTERP_JITTER_MARGIN * interp->jitter_ns;
+    if (target > INTERP_MAX_DELAY_NS) target = INTERP_MAX_DELAY_NS;
+    interp->delay_ns += (target - interp->delay_ns) * (target > interp->delay_ns ? 0.25 : 0.01);
+}
+
+static float lerpf(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void interpolate_states(GameState *out, const GameState *a, const GameState *b, float t) {
+    *out = *b;
+    for (int p = 0; p < 2; p++) {
+        out->players[p].y = lerpf(a->players[p].y, b->players[p].y, t);
+    }
+
+    // A score teleports the ball to the center; switch over instead of sliding
+    if (a->scores[0] != b->scores[0] || a->scores[1] != b->scores[1]) {
+        if (t < 0.5f) out->ball = a->ball;
+        return;
+    }
+    out->ball.x = lerpf(a->ball.x, b->ball.x, t);
+    out->ball.y = lerpf(a->ball.y, b->ball.y, t);
+}
+
+static void extrapolate_state(GameState *out, const GameState *state, float seconds) {
+    *out = *state;
+    for (int p = 0; p < 2; p++) {
+        out->players[p].y = clampf(state->players[p].y + state->players[p].vy * seconds,
+                                   0.0f, WINDOW_HEIGHT - PADDLE_HEIGHT);
+    }
+    out->ball.x = state->ball.x + state->ball.vx * seconds;
+    out->ball.y = clampf(state->ball.y + state->ball.vy * seconds, 0.0f, WINDOW_HEIGHT - BALL_SIZE);
+}
+
+// Server time in 1/256 ticks; seq and fraction for lag compensation
+static int64_t interpolation_view_at(double server_ns) {
+    return (int64_t)floor(server_ns * 256.0 / (double)GAME_TICK_NS);
+}
+
+// Fills out with the remote view for local time now_ns. Returns false until
+// the first state has arrived.
+bool interpolation_sample(Interpolator *interp, uint64_t now_ns, GameState *out) {
+    if (interp->count == 0) return false;
+    interp->frames++;
+
+    double delay_ns = interp->delay_ns + interp->spacing_ns;
+    if (delay_ns > INTERP_MAX_DELAY_NS) delay_ns = INTERP_MAX_DELAY_NS;
+    double render_ns = (double)(int64_t)now_ns - interp->offset_ns - delay_ns;
+
+    // When the delay grows, hold still until render time catches up rather
+    // than replay motion already drawn
+    if (interp->frames > 1 && render_ns < interp->render_ns) render_ns = interp->render_ns;
+    interp->render_ns = render_ns;
+
+    const int mask = INTERP_BUFFER - 1;
+
+    int newer = interp->newest;
+    if (render_ns >= (double)interp->times[newer]) {
+        // The server cannot rebuild an extrapolated ball; the newest state
+        // is the closest it has
+        interp->view = interpolation_view_at((double)interp->times[newer]);
+        double ahead = render_ns - (double)interp->times[newer];
+        if (ahead > 0.0) interp->extrapolated++;
+        if (ahead > INTERP_MAX_EXTRAPOLATE_NS) ahead = INTERP_MAX_EXTRAPOLATE_NS;
+        interp->render_ns = (double)interp->times[newer] + ahead;
+        extrapolate_state(out, &interp->states[newer], (float)(ahead / 1e9));
+        return true;
+    }
+
+    // Walk back to the pair of states around render time
+    for (int i = 1; i < interp->count; i++) {
+        int older = (interp->newest - i) & mask;
+        if (render_ns >= (double)interp->times[older]) {
+            double span = (double)(interp->times[newer] - interp->times[older]);
+            float t = span > 0.0 ? (float)((render_ns - (double)interp->times[older]) / span) : 1.0f;
+            interpolate_states(out, &interp->states[older], &interp->states[newer], t);
+            interp->view = interpolation_view_at(render_ns);
+            return true;
+        }
+        newer = older;
+    }
+
+    // Older than anything buffered: hold the oldest state
+    *out = interp->states[newer];
+    interp->view = interpolation_view_at((double)interp->times[newer]);
+    return true;
+}
+
+// What the last sample showed, as the seq of a server state and 1/256ths of
+// the way to the next one (the view fields of PKT_INPUT)
+void interpolation_view(const Interpolator *interp, uint16_t *seq, uint8_t *frac) {
+    *seq = (uint16_t)(interp->view >> 8);
+    *frac = (uint8_t)(interp->view & 255);
+}
+
+#endif
@@ -0,0 +1,468 @@
+#ifndef JSON_C
+#define JSON_C
+
+// Streaming JSON tokenizer that pulls selected fields out in one pass.
+//
+// The caller lists the fields it wants by path and gives each one a buffer.
+// Input can then be fed in pieces of any size, e.g. straight from the socket
+// as an HTTP body arrives. The parser keeps only its state, the current key
+// and path, so documents of any length parse in constant memory and without
+// allocating. Values of fields nobody asked for are skipped.
+//
+// Paths join object keys with '.', and "[]" stands for any array element:
+//   "token"                     top-level key
+//   "match.presences[]"         every element of an array (count = length)
+//   "paddles.1.y"
+// A matched string is stored unescaped. Numbers and true/false/null are
+// stored as their text, and json_field_number reads a number whether it was
+// quoted or not. Objects and arrays only bump the field's count.
+//
+// Plain C with no SDL, so headless tools can use it too.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_MAX_DEPTH 32
+#define JSON_MAX_KEY 64         // longer keys are truncated and never match
+#define JSON_MAX_PATH 256       // deeper paths never match
+
+typedef struct {
+    const char *path;
+    char *value;            // receives the value text, always NUL-terminated
+    int value_size;
+    int count;              // times the path was seen
+    bool truncated;         // the value did not fit
+    int value_len;
+    int path_len;           // set by json_init
+} JsonField;
+
+typedef enum {
+    JSON_ERROR = -1,
+    JSON_INCOMPLETE = 0,    // valid so far, feed more
+    JSON_DONE = 1           // the top-level value is complete
+} JsonResult;
+
+typedef enum {
+    JSON_STATE_VALUE,
+    JSON_STATE_VALUE_OR_END,    // after '['
+    JSON_STATE_KEY,             // after ','
+    JSON_STATE_KEY_OR_END,      // after '{'
+    JSON_STATE_COLON,
+    JSON_STATE_AFTER_VALUE,
+    JSON_STATE_STRING,
+    JSON_STATE_ESCAPE,
+    JSON_STATE_UNICODE,
+    JSON_STATE_SCALAR,
+    JSON_STATE_DONE,
+    JSON_STATE_ERROR
+} JsonState;
+
+typedef struct {
+    JsonField *fields;
+    int field_count;
+
+    JsonState state;
+    int depth;
+    bool in_array[JSON_MAX_DEPTH];      // per open container: array or object
+    int path_len[JSON_MAX_DEPTH + 1];   // path length where each level starts
+    char path[JSON_MAX_PATH];
+    int path_used;
+    int overflow_level;                 // 1 + depth whose segment did not fit, 0 if none
+
+    // Current string or scalar
+    bool string_is_key;
+    char key[JSON_MAX_KEY];
+    int key_len;
+    JsonField *target;                  // field receiving the current value, if any
+    char scalar[8];                     // start of a literal, to validate true/false/null
+    int scalar_len;
+    uint32_t unicode;                   // \uXXXX being read
+    int unicode_digits;
+    uint32_t high_surrogate;            // pending first half of a pair
+} JsonParser;
+
+void json_init(JsonParser *parser, JsonField *fields, int field_count) {
+    memset(parser, 0, sizeof(JsonParser));
+    parser->fields = fields;
+    parser->field_count = field_count;
+    for (int i = 0; i < field_count; i++) {
+        fields[i].count = 0;
+        fields[i].truncated = false;
+        fields[i].value_len = 0;
+        fields[i].path_len = (int)strlen(fields[i].path);
+        if (fields[i].value_size > 0) fields[i].value[0] = '\0';
+    }
+}
+
+// Looks the current path up when a value starts
+static JsonField *json_match(JsonParser *parser) {
+    if (parser->overflow_level) return NULL;
+    for (int i = 0; i < parser->field_count; i++) {
+        JsonField *field = &parser->fields[i];
+        if (field->path_len == parser->path_used && memcmp(field->path, parser->path, field->path_len) == 0) {
+            field->count++;
+            field->value_len = 0;
+            if (field->value_size > 0) field->value[0] = '\0';
+            return field;
+        }
+    }
+    return NULL;
+}
+
+// Sets the path to the parent level's plus one segment
+static void json_set_path(JsonParser *parser, const char *segment, int len, bool is_key) {
+    int base = parser->path_len[parser->depth];
+    if (parser->overflow_level && parser->overflow_level <= parser->depth) return;  // inside an overflowed path
+    parser->overflow_level = 0;
+    if (base + len + 2 > JSON_MAX_PATH) {
+        parser->path[base] = '\0';
+        parser->path_used = base;
+        parser->overflow_level = parser->depth + 1;
+        return;
+    }
+    int n = base;
+    if (is_key && n > 0) parser->path[n++] = '.';
+    memcpy(parser->path + n, segment, len);
+    parser->path[n + len] = '\0';
+    parser->path_used = n + len;
+}
+
+static void json_append(JsonField *field, const char *data, int len) {
+    if (!field || field->value_size <= 0) return;
+    int room = field->value_size - 1 - field->value_len;
+    if (len > room) {
+        field->truncated = true;
+        len = room;
+    }
+    memcpy(field->value + field->value_len, data, len);
+    field->value_len += len;
+    field->value[field->value_len] = '\0';
+}
+
+// Appends decoded characters to the current key or value
+static void json_string_bytes(JsonParser *parser, const char *data, int len) {
+    if (parser->string_is_key) {
+        if (parser->key_len + len < JSON_MAX_KEY) {
+            memcpy(parser->key + parser->key_len, data, len);
+            parser->key_len += len;
+        } else {
+            parser->key_len = JSON_MAX_KEY;     // too long: never matches
+        }
+    } else {
+        json_append(parser->target, data, len);
+    }
+}
+
+static void json_string_byte(JsonParser *parser, char c) {
+    json_string_bytes(parser, &c, 1);
+}
+
+static void json_string_codepoint(JsonParser *parser, uint32_t cp) {
+    char utf8[4];
+    int n;
+    if (cp < 0x80) {
+        utf8[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        utf8[0] = (char)(0xC0 | (cp >> 6));
+        utf8[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        utf8[0] = (char)(0xE0 | (cp >> 12));
+        utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        utf8[0] = (char)(0xF0 | (cp >> 18));
+        utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        utf8[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    for (int i = 0; i < n; i++) json_string_byte(parser, utf8[i]);
+}
+
+// A value (scalar or whole container) just ended
+static void json_value_done(JsonParser *parser) {
+    parser->target = NULL;
+    parser->state = parser->depth == 0 ? JSON_STATE_DONE : JSON_STATE_AFTER_VALUE;
+}
+
+static bool json_push(JsonParser *parser, bool array) {
+    if (parser->depth == JSON_MAX_DEPTH) return false;
+    parser->in_array[parser->depth] = array;
+    parser->depth++;
+    parser->path_len[parser->depth] = parser->path_used;
+    parser->state = array ? JSON_STATE_VALUE_OR_END : JSON_STATE_KEY_OR_END;
+    return true;
+}
+
+static bool json_pop(JsonParser *parser, bool array) {
+    if (parser->depth == 0 || parser->in_array[parser->depth - 1] != array) return false;
+    parser->depth--;
+    if (parser->overflow_level > parser->depth + 1) parser->overflow_level = 0;
+    parser->path_used = parser->path_len[parser->depth + 1];
+    parser->path[parser->path_used] = '\0';
+    json_value_done(parser);
+    return true;
+}
+
+static bool json_scalar_valid(const JsonParser *parser) {
+    const char *s = parser->scalar;
+    int n = parser->scalar_len;
+    if (s[0] == 't') return n == 4 && memcmp(s, "true", 4) == 0;
+    if (s[0] == 'f') return n == 5 && memcmp(s, "false", 5) == 0;
+    if (s[0] == 'n') return n == 4 && memcmp(s, "null", 4) == 0;
+
+    // Numbers: digits, sign, point and exponent only (checked as far as kept)
+    int kept = n < (int)sizeof(parser->scalar) ? n : (int)sizeof(parser->scalar);
+    for (int i = 0; i < kept; i++) {
+        char c = s[i];
+        if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) return false;
+    }
+    return true;
+}
+
+static bool json_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool json_is_scalar_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+static int json_hex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Starts the value beginning with c; false if c cannot start one
+static bool json_begin_value(JsonParser *parser, char c) {
+    if (parser->depth > 0 && parser->in_array[parser->depth - 1]) json_set_path(parser, "[]", 2, false);
+    parser->target = json_match(parser);
+
+    if (c == '{' || c == '[') {
+        parser->target = NULL;
+        return json_push(parser, c == '[');
+    }
+    if (c == '"') {
+        parser->string_is_key = false;
+        parser->state = JSON_STATE_STRING;
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+        parser->scalar[0] = c;
+        parser->scalar_len = 1;
+        json_append(parser->target, &c, 1);
+        parser->state = JSON_STATE_SCALAR;
+        return true;
+    }
+    return false;
+}
+
+// Feeds the next len bytes. Returns JSON_DONE once the top-level value has
+// closed, JSON_ERROR on malformed input (and from then on).
+JsonResult json_feed(JsonParser *parser, const char *data, int len) {
+    for (int i = 0; i < len && parser->state != JSON_STATE_ERROR; i++) {
+        char c = data[i];
+
+        switch (parser->state) {
+            case JSON_STATE_VALUE:
+                if (json_is_space(c)) break;
+                if (!json_begin_value(parser, c)) parser->state = JSON_STATE_ERROR;
+                break;
+
+            case JSON_STATE_VALUE_OR_END:
+                if (json_is_space(c)) break;
+                if (c == ']') {
+                    json_pop(parser, true);
+                } else if (!json_begin_value(parser, c)) {
+                    parser->state = JSON_STATE_ERROR;
+                }
+                break;
+
+            case JSON_STATE_KEY:
+            case JSON_STATE_KEY_OR_END:
+                if (json_is_space(c)) break;
+                if (c == '"') {
+                    parser->string_is_key = true;
+                    parser->key_len = 0;
+                    parser->state = JSON_STATE_STRING;
+                } else if (c == '}' && parser->state == JSON_STATE_KEY_OR_END) {
+                    json_pop(parser, false);
+                } else {
+                    parser->state = JSON_STATE_ERROR;
+                }
+                break;
+
+            case JSON_STATE_COLON:
+                if (json_is_space(c)) break;
+                parser->state = c == ':' ? JSON_STATE_VALUE : JSON_STATE_ERROR;
+                break;
+
+            case JSON_STATE_AFTER_VALUE: {
+                if (json_is_space(c)) break;
+                bool array = parser->in_array[parser->depth - 1];
+                if (c == ',') {
+                    parser->state = array ? JSON_STATE_VALUE : JSON_STATE_KEY;
+                } else if ((c != ']' && c != '}') || !json_pop(parser, c == ']')) {
+                    parser->state = JSON_STATE_ERROR;
+                }
+                break;
+            }
+
+            case JSON_STATE_STRING:
+                if (!parser->high_surrogate) {
+                    // Plain characters up to the next quote or escape go in one piece
+                    int run = i;
+                    while (run < len && data[run] != '"' && data[run] != '\\' && (unsigned char)data[run] >= 0x20) run++;
+                    if (run > i) json_string_bytes(parser, data + i, run - i);
+                    if (run == len) {
+                        i = len;
+                        break;
+                    }
+                    i = run;
+                    c = data[i];
+                }
+                if (parser->high_surrogate && c != '\\') {
+                    parser->state = JSON_STATE_ERROR;   // lone high surrogate
+                } else if (c == '"') {
+                    if (parser->string_is_key) {
+                        if (parser->key_len < JSON_MAX_KEY) {
+                            json_set_path(parser, parser->key, parser->key_len, true);
+                        } else {
+                            json_set_path(parser, "\x01", 1, true);    // matches no field
+                        }
+                        parser->state = JSON_STATE_COLON;
+                    } else {
+                        json_value_done(parser);
+                    }
+                } else if (c == '\\') {
+                    parser->state = JSON_STATE_ESCAPE;
+                } else if ((unsigned char)c < 0x20) {
+                    parser->state = JSON_STATE_ERROR;
+                } else {
+                    json_string_byte(parser, c);
+                }
+                break;
+
+            case JSON_STATE_ESCAPE: {
+                char out = 0;
+                switch (c) {
+                    case '"': out = '"'; break;
+                    case '\\': out = '\\'; break;
+                    case '/': out = '/'; break;
+                    case 'b': out = '\b'; break;
+                    case 'f': out = '\f'; break;
+                    case 'n': out = '\n'; break;
+                    case 'r': out = '\r'; break;
+                    case 't': out = '\t'; break;
+                    case 'u':
+                        parser->unicode = 0;
+                        parser->unicode_digits = 0;
+                        parser->state = JSON_STATE_UNICODE;
+                        break;
+                    default:
+                        parser->state = JSON_STATE_ERROR;
+                        break;
+                }
+                if (out) {
+                    if (parser->high_surrogate) {
+                        parser->state = JSON_STATE_ERROR;
+                    } else {
+                        json_string_byte(parser, out);
+                        parser->state = JSON_STATE_STRING;
+                    }
+                }
+                break;
+            }
+
+            case JSON_STATE_UNICODE: {
+                int digit = json_hex(c);
+                if (digit < 0) {
+                    parser->state = JSON_STATE_ERROR;
+                    break;
+                }
+                parser->unicode = parser->unicode << 4 | (uint32_t)digit;
+                if (++parser->unicode_digits < 4) break;
+
+                uint32_t cp = parser->unicode;
+                parser->state = JSON_STATE_STRING;
+                if (parser->high_surrogate) {
+                    if (cp < 0xDC00 || cp > 0xDFFF) {
+                        parser->state = JSON_STATE_ERROR;
+                        break;
+                    }
+                    cp = 0x10000 + ((parser->high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+                    parser->high_surrogate = 0;
+                } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    parser->high_surrogate = cp;    // the low half must follow
+                    break;
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    parser->state = JSON_STATE_ERROR;
+                    break;
+                }
+                json_string_codepoint(parser, cp);
+                break;
+            }
+
+            case JSON_STATE_SCALAR:
+                if (json_is_scalar_char(c)) {
+                    if (parser->scalar_len < (int)sizeof(parser->scalar)) parser->scalar[parser->scalar_len] = c;
+                    parser->scalar_len++;
+                    json_append(parser->target, &c, 1);
+                    break;
+                }
+                // The delimiter belongs to whatever follows
+                if (!json_scalar_valid(parser)) {
+                    parser->state = JSON_STATE_ERROR;
+                    break;
+                }
+                json_value_done(parser);
+                i--;
+                break;
+
+            case JSON_STATE_DONE:
+                if (!json_is_space(c)) parser->state = JSON_STATE_ERROR;
+                break;
+
+            default:
+                parser->state = JSON_STATE_ERROR;
+                break;
+        }
+    }
+
+    if (parser->state == JSON_STATE_ERROR) return JSON_ERROR;
+    return parser->state == JSON_STATE_DONE ? JSON_DONE : JSON_INCOMPLETE;
+}
+
+// Ends the input. A number still being read at the top level is complete
+// now; anything else unfinished is an error.
+JsonResult json_finish(JsonParser *parser) {
+    if (parser->state == JSON_STATE_SCALAR && parser->depth == 0 && json_scalar_valid(parser)) {
+        parser->state = JSON_STATE_DONE;
+    }
+    return parser->state == JSON_STATE_DONE ? JSON_DONE : JSON_ERROR;
+}
+
+// Parses a complete document held in memory
+JsonResult json_parse(JsonParser *parser, JsonField *fields, int field_count, const char *data, int len) {
+    json_init(parser, fields, field_count);
+    if (json_feed(parser, data, len) == JSON_ERROR) return JSON_ERROR;
+    return json_finish(parser);
+}
+
+// Reads a matched field as a number (quoted or not). False if the field was
+// missing or is not a number.
+bool json_field_number(const JsonField *field, double *out) {
+    if (field->count == 0 || field->value_size <= 0 || field->value[0] == '\0') return false;
+    char *end;
+    *out = strtod(field->value, &end);
+    return end != field->value && *end == '\0';
+}
+
+#endif
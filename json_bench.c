@@ -0,0 +1,292 @@
+// Benchmark and fuzzer for the streaming JSON tokenizer in json.c
+//
+//   json_bench [--iterations N]           time field extraction per document
+//   json_bench --fuzz N [--seed S]        mutate documents and check invariants
+//
+// The benchmark runs the documents the client actually parses (an auth
+// response, an RPC reply whose payload is escaped JSON, a realtime envelope)
+// through json.c, both in one piece and fed in small chunks as they would
+// arrive from a socket. It compares against the strstr scan the client used
+// before. The strstr numbers are only a reference: that scan also gets the
+// escaped RPC payload wrong.
+//
+// The fuzzer mutates the same documents (flips, inserts, deletes, splices,
+// truncations, deep nesting) and checks that parsing never overruns a field
+// buffer, that every value stays NUL-terminated, and that feeding the input
+// in random pieces gives exactly the same result as feeding it at once.
+// Build with -fsanitize=address,undefined to catch memory errors as well.
+
+#include "json.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FUZZ_MAX_INPUT 4096
+
+static const char *corpus[] = {
+    // POST /v2/account/authenticate/device
+    "{\"token\":\"eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJ0aWQiOiI1YjQ0ZTM4Ni1kYzc1LTRiZDAtYjM0Ny1hYzEwZjk1YzJk"
+    "ZmYiLCJ1aWQiOiI0ZTg0YzY0NS0xZjA1LTQ0ZmMtOTZmMS0zN2M0NGQ4ZjE4YzYiLCJ1c24iOiJmT2tFTlRtVk1FIiwiZXhwIjox"
+    "NzAwMDAwMDAwfQ.sJ7uQ0q8rO6yYpX0H0kB4m7S2r9lQm5wVq1xJ3n4cE8\",\"refresh_token\":\"eyJhbGciOiJIUzI1NiIsIn"
+    "R5cCI6IkpXVCJ9.eyJ0aWQiOiI1YjQ0ZTM4Ni1kYzc1LTRiZDAtYjM0Ny1hYzEwZjk1YzJkZmYiLCJ1aWQiOiI0ZTg0YzY0NS0x"
+    "ZjA1LTQ0ZmMtOTZmMS0zN2M0NGQ4ZjE4YzYiLCJ1c24iOiJmT2tFTlRtVk1FIiwiZXhwIjoxNzAwMDAzNjAwfQ.Hk2Qk7y0aB1c"
+    "D2e3F4g5H6i7J8k9L0m1N2o3P4q5R6s\",\"created\":true}",
+    // POST /v2/rpc/find_match: the RPC result is a JSON string inside JSON
+    "{\"id\":\"find_match\",\"payload\":\"{\\\"match_id\\\":\\\"7f1c2a4e-9d3b-4c5e-8f6a-1b2c3d4e5f60.nakama\\\"}\"}",
+    // Realtime envelope carrying OP_GAME_STATE
+    "{\"match_data\":{\"match_id\":\"7f1c2a4e-9d3b-4c5e-8f6a-1b2c3d4e5f60.nakama\",\"presence\":{\"user_id\":"
+    "\"4e84c645-1f05-44fc-96f1-37c44d8f18c6\",\"session_id\":\"9a8b7c6d-5e4f-3a2b-1c0d-e9f8a7b6c5d4\","
+    "\"username\":\"fOkENTmVME\"},\"op_code\":\"3\",\"data\":\"eyJiYWxsIjp7IngiOjQwMCwieSI6MzAwLCJ2eCI6MzUwLCJ2eSI6"
+    "MTc1fSwicGFkZGxlcyI6eyIxIjp7InkiOjI1MH0sIjIiOnsieSI6MjUwfX0sInNjb3JlcyI6eyIxIjowLCIyIjowfX0=\","
+    "\"reliable\":true}}",
+    // Match join reply
+    " { \"cid\" : \"1\" , \"match\" : { \"match_id\" : \"m-1\", \"authoritative\" : true, \"size\" : 1,\n"
+    "   \"presences\" : [ { \"user_id\" : \"a\\u00e9\\ud83d\\ude00\" }, { \"user_id\" : \"b\" } ],\n"
+    "   \"self\" : { \"user_id\" : \"c\" }, \"numbers\" : [ -1.5e+3, 0, 12, null, false ] } } ",
+};
+#define CORPUS_SIZE ((int)(sizeof(corpus) / sizeof(corpus[0])))
+
+static const char *field_paths[] = {
+    "token", "payload", "match_id", "ticket",
+    "match_data.op_code", "match_data.data", "match.presences[]", "match.presences[].user_id",
+    "match.numbers[]", "error.message", "",
+};
+#define FIELD_COUNT ((int)(sizeof(field_paths) / sizeof(field_paths[0])))
+
+typedef struct {
+    JsonField fields[FIELD_COUNT];
+    char values[FIELD_COUNT][64];   // small on purpose: long values get truncated
+} FieldSet;
+
+static void field_set_init(FieldSet *set) {
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        set->fields[i] = (JsonField){ .path = field_paths[i], .value = set->values[i], .value_size = 64 };
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// The old extraction: one strstr scan per field, value up to the next quote
+static int strstr_field(const char *doc, const char *pattern, char *out, int out_size) {
+    const char *start = strstr(doc, pattern);
+    if (!start) return 0;
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (!end || end - start >= out_size) return 0;
+    memcpy(out, start, end - start);
+    out[end - start] = '\0';
+    return 1;
+}
+
+// Parses doc in pieces of `chunk` bytes (0 = all at once)
+static JsonResult parse_chunked(JsonParser *parser, FieldSet *set, const char *doc, int len, int chunk) {
+    json_init(parser, set->fields, FIELD_COUNT);
+    if (chunk <= 0) chunk = len;
+    for (int pos = 0; pos < len; pos += chunk) {
+        int n = len - pos < chunk ? len - pos : chunk;
+        if (json_feed(parser, doc + pos, n) == JSON_ERROR) return JSON_ERROR;
+    }
+    return json_finish(parser);
+}
+
+static int run_bench(int iterations) {
+    JsonParser parser;
+    FieldSet set;
+    field_set_init(&set);
+    volatile int sink = 0;
+
+    printf("json_bench: %d iterations per document\n", iterations);
+    printf("%-12s %6s %12s %12s %12s %10s\n", "document", "bytes", "strstr ns", "json ns", "json/16B ns", "json MB/s");
+
+    const char *names[] = { "auth", "rpc", "match_data", "match_join" };
+    for (int d = 0; d < CORPUS_SIZE; d++) {
+        const char *doc = corpus[d];
+        int len = (int)strlen(doc);
+        char out[1024];
+
+        uint64_t start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            sink += strstr_field(doc, "\"token\":\"", out, sizeof(out));
+            sink += strstr_field(doc, "\"match_id\":\"", out, sizeof(out));
+            sink += strstr_field(doc, "\"ticket\":\"", out, sizeof(out));
+            sink += strstr_field(doc, "\"op_code\":\"", out, sizeof(out));
+            sink += strstr_field(doc, "\"data\":\"", out, sizeof(out));
+        }
+        double strstr_ns = (double)(now_ns() - start) / iterations;
+
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            if (parse_chunked(&parser, &set, doc, len, 0) != JSON_DONE) return 1;
+            sink += set.fields[0].count;
+        }
+        double json_ns = (double)(now_ns() - start) / iterations;
+
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            if (parse_chunked(&parser, &set, doc, len, 16) != JSON_DONE) return 1;
+            sink += set.fields[0].count;
+        }
+        double chunked_ns = (double)(now_ns() - start) / iterations;
+
+        printf("%-12s %6d %12.1f %12.1f %12.1f %10.1f\n", names[d], len, strstr_ns, json_ns, chunked_ns,
+               len / json_ns * 1e3);
+    }
+    (void)sink;
+    return 0;
+}
+
+static bool field_sets_equal(const FieldSet *a, const FieldSet *b) {
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        const JsonField *fa = &a->fields[i], *fb = &b->fields[i];
+        if (fa->count != fb->count || fa->truncated != fb->truncated || fa->value_len != fb->value_len ||
+            memcmp(fa->value, fb->value, fa->value_len + 1) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool field_set_sane(const FieldSet *set) {
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        const JsonField *f = &set->fields[i];
+        if (f->value_len < 0 || f->value_len >= f->value_size) return false;
+        if (f->value[f->value_len] != '\0') return false;
+    }
+    return true;
+}
+
+// Builds one mutated input into buf; returns its length
+static int fuzz_input(char *buf, uint32_t *rng) {
+    uint32_t r = xorshift(rng);
+    int len;
+
+    if (r % 16 == 0) {
+        // Deep nesting, sometimes past JSON_MAX_DEPTH
+        int depth = (int)(xorshift(rng) % (JSON_MAX_DEPTH * 2));
+        len = 0;
+        for (int i = 0; i < depth; i++) len += sprintf(buf + len, i % 2 ? "[" : "{\"k%d\":", i);
+        len += sprintf(buf + len, "1");
+        for (int i = depth - 1; i >= 0; i--) buf[len++] = i % 2 ? ']' : '}';
+        buf[len] = '\0';
+    } else {
+        const char *doc = corpus[xorshift(rng) % CORPUS_SIZE];
+        len = (int)strlen(doc);
+        memcpy(buf, doc, len);
+    }
+
+    static const char interesting[] = "{}[]\":,\\u0123456789.eE+-tfn \x01\xff";
+    int mutations = (int)(xorshift(rng) % 8);
+    for (int m = 0; m < mutations && len > 0; m++) {
+        int pos = (int)(xorshift(rng) % (uint32_t)len);
+        switch (xorshift(rng) % 6) {
+            case 0:     // flip a bit
+                buf[pos] ^= (char)(1 << (xorshift(rng) % 8));
+                break;
+            case 1:     // overwrite with a structural character
+                buf[pos] = interesting[xorshift(rng) % (sizeof(interesting) - 1)];
+                break;
+            case 2:     // insert
+                if (len < FUZZ_MAX_INPUT - 1) {
+                    memmove(buf + pos + 1, buf + pos, len - pos);
+                    buf[pos] = interesting[xorshift(rng) % (sizeof(interesting) - 1)];
+                    len++;
+                }
+                break;
+            case 3:     // delete
+                memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                len--;
+                break;
+            case 4:     // truncate
+                len = pos;
+                break;
+            default: {  // duplicate a span
+                int span = (int)(xorshift(rng) % 32);
+                if (pos + span > len) span = len - pos;
+                if (len + span < FUZZ_MAX_INPUT) {
+                    memmove(buf + pos + span, buf + pos, len - pos);
+                    len += span;
+                }
+                break;
+            }
+        }
+    }
+    return len;
+}
+
+static int run_fuzz(int iterations, uint32_t seed) {
+    static char input[FUZZ_MAX_INPUT];
+    JsonParser parser;
+    FieldSet whole, pieces;
+    field_set_init(&whole);
+    field_set_init(&pieces);
+    uint32_t rng = seed ? seed : 1;
+    int counts[3] = {0};
+
+    for (int it = 0; it < iterations; it++) {
+        int len = fuzz_input(input, &rng);
+
+        JsonResult expected = parse_chunked(&parser, &whole, input, len, 0);
+        if (!field_set_sane(&whole)) {
+            fprintf(stderr, "fuzz: field buffer invariant broken (iteration %d)\n", it);
+            return 1;
+        }
+
+        // Same input in random pieces, including 1-byte ones
+        json_init(&parser, pieces.fields, FIELD_COUNT);
+        JsonResult result = JSON_INCOMPLETE;
+        for (int pos = 0; pos < len;) {
+            int n = 1 + (int)(xorshift(&rng) % 24);
+            if (n > len - pos) n = len - pos;
+            result = json_feed(&parser, input + pos, n);
+            if (result == JSON_ERROR) break;
+            pos += n;
+        }
+        if (result != JSON_ERROR) result = json_finish(&parser);
+
+        if (result != expected || (expected != JSON_ERROR && !field_sets_equal(&whole, &pieces))) {
+            fprintf(stderr, "fuzz: split parse differs (iteration %d): %.*s\n", it, len, input);
+            return 1;
+        }
+        counts[expected + 1]++;
+    }
+
+    printf("fuzz: %d inputs, seed %u: %d rejected, %d complete, all split parses matched\n",
+           iterations, seed, counts[0], counts[2]);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 200000;
+    int fuzz = 0;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            fuzz = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--iterations N] [--fuzz N [--seed S]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1) iterations = 1;
+
+    return fuzz > 0 ? run_fuzz(fuzz, seed) : run_bench(iterations);
+}
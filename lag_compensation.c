@@ -0,0 +1,119 @@
+#ifndef LAG_COMPENSATION_C
+#define LAG_COMPENSATION_C
+
+// Lag compensation for paddle hits on the authoritative server.
+//
+// A client draws the ball interpolated between server states, a little in
+// the past, and its input reaches the server half a round trip after that.
+// By then the server's ball has moved on, so a hit the player saw connect
+// can miss on the server, and the other way round. Every PKT_INPUT names the
+// state the ball on screen was drawn from (see network.c). The server keeps
+// the ball of its last BALL_HISTORY ticks per match, rebuilds the ball that
+// player was looking at, and that paddle is judged against it instead of
+// the server's ball (see GameRewind in game.c).
+//
+// The ball the player sees can still be in front of the paddle when the
+// server's ball has already crossed the goal line, so a ball that reaches a
+// goal line is held there for the rewind window before the point counts; a
+// hit that arrives in time sends it back from the paddle.
+//
+// The server quantizes the match to wire precision after every step, so the
+// history keeps the ball fields of the snapshot it sends, 8 bytes a tick,
+// without losing anything.
+//
+// A client can claim to be looking at any state it has received, so how far
+// back it may reach is capped by the rewind window; older views are judged
+// at the edge of the window. Views from before the last serve belong to a
+// finished rally and are ignored.
+
+#include "game.c"
+#include "network.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BALL_HISTORY 32     // power of two, ticks of ball positions kept per match
+
+typedef struct {
+    uint16_t x, y, vx, vy;      // quantize_pos/quantize_vel
+} BallFields;
+
+typedef struct {
+    BallFields balls[BALL_HISTORY]; // ball after each tick, by game tick
+    uint32_t newest;                // game tick of the newest entry
+    uint32_t serve_tick;            // first tick of the current rally
+    int held_ticks;                 // ticks the ball has waited at a goal line
+} BallHistory;
+
+static Ball ball_from_fields(const BallFields *fields) {
+    return (Ball){
+        .x = dequantize_pos(fields->x),
+        .y = dequantize_pos(fields->y),
+        .vx = dequantize_vel(fields->vx),
+        .vy = dequantize_vel(fields->vy)
+    };
+}
+
+// Records the ball of the snapshot sent for game tick `tick`; `scored` is
+// the event of the step that led to it
+void ball_history_record(BallHistory *history, uint32_t tick, const Snapshot *snap, bool scored) {
+    BallFields *fields = &history->balls[tick & (BALL_HISTORY - 1)];
+    fields->x = snap->fields[SNAP_BALL_X];
+    fields->y = snap->fields[SNAP_BALL_Y];
+    fields->vx = snap->fields[SNAP_BALL_VX];
+    fields->vy = snap->fields[SNAP_BALL_VY];
+    history->newest = tick;
+    if (scored) history->serve_tick = tick;
+}
+
+// Starts a new game's history with its serve, so a view of the state sent
+// before the first step finds the ball that state showed
+void ball_history_reset(BallHistory *history, const Game *game) {
+    BallFields *fields = &history->balls[game->tick & (BALL_HISTORY - 1)];
+    fields->x = quantize_pos(game->ball.x);
+    fields->y = quantize_pos(game->ball.y);
+    fields->vx = quantize_vel(game->ball.vx);
+    fields->vy = quantize_vel(game->ball.vy);
+    history->newest = game->tick;
+    history->serve_tick = game->tick;
+    history->held_ticks = 0;
+}
+
+// Rebuilds the ball as drawn frac/256 of the way from `tick` to the next
+// tick, the way interpolation_sample() blends it. rewind_ticks is the
+// window; 0 turns compensation off.
+bool ball_history_seen(const BallHistory *history, uint32_t tick, uint8_t frac, int rewind_ticks, Ball *seen) {
+    if (rewind_ticks <= 0 || (int32_t)(history->newest - tick) < 0) return false;
+    if (rewind_ticks > BALL_HISTORY - 1) rewind_ticks = BALL_HISTORY - 1;
+    if (history->newest - tick > (uint32_t)rewind_ticks) {
+        tick = history->newest - (uint32_t)rewind_ticks;
+        frac = 0;
+    }
+    if ((int32_t)(tick - history->serve_tick) < 0) return false;
+
+    Ball a = ball_from_fields(&history->balls[tick & (BALL_HISTORY - 1)]);
+    Ball b = tick != history->newest ? ball_from_fields(&history->balls[(tick + 1) & (BALL_HISTORY - 1)]) : a;
+    float t = frac / 256.0f;
+    *seen = a;
+    seen->x = a.x + (b.x - a.x) * t;
+    seen->y = a.y + (b.y - a.y) * t;
+    return true;
+}
+
+// Steps a match judging each paddle against the ball its player saw (NULL
+// when unknown), holding goals for up to rewind_ticks
+GameEvents lag_compensated_step(Game *game, BallHistory *history, uint8_t buttons1, uint8_t buttons2,
+                                const Ball *seen1, const Ball *seen2, int rewind_ticks) {
+    GameRewind rewind = { seen1, seen2, rewind_ticks > 0 };
+    GameEvents events = game_step_rewound(game, buttons1, buttons2, &rewind);
+    if (!events.held) {
+        history->held_ticks = 0;
+    } else if (++history->held_ticks > rewind_ticks) {
+        game_award_point(game, events.held);
+        events.scored = true;
+        history->held_ticks = 0;
+    }
+    return events;
+}
+
+#endif
@@ -0,0 +1,408 @@
+// Lag compensation simulator
+//
+// Plays a bot match through the client's own prediction.c and
+// interpolation.c against a server loop that steps the match the way
+// server.c does, over a simulated link with a fixed round trip and no loss.
+// Packets go through the real PKT_INPUT/PKT_STATE encoders.
+//
+// Every time the ball comes at a paddle it compares what that player saw --
+// the interpolated ball touching its predicted paddle, or not -- with what
+// the server decided: a bounce, or a point for the other side. It reports
+// how often the two disagree with lag compensation off and for a range of
+// rewind windows. The bots aim at a random spot on the ball they see, so a
+// good share of the contacts are close calls.
+//
+//   ./lagsim [--rtt-ms 100] [--seconds 3600] [--rewind-ms N] [--seed N]
+
+#include "game.c"
+#include "network.c"
+#include "prediction.c"
+#include "interpolation.c"
+#include "lag_compensation.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINK_SLOTS 64           // power of two, datagrams in flight per direction
+#define MAX_RTT_MS 500
+#define CLIENT_PHASE_NS (GAME_TICK_NS * 2 / 5)  // client frames fall between server ticks
+#define AIM_SPREAD ((PADDLE_HEIGHT + BALL_SIZE) / 2.0f + 10.0f)
+
+// --- Link -----------------------------------------------------------------------
+
+typedef struct {
+    uint64_t at;        // delivery time
+    int len;
+    uint8_t data[MAX_PACKET_SIZE];
+} Datagram;
+
+// One direction of a fixed-latency link, so datagrams arrive in send order
+typedef struct {
+    Datagram slots[LINK_SLOTS];
+    unsigned head, tail;
+} Link;
+
+static void link_send(Link *link, uint64_t at, const uint8_t *data, int len) {
+    if (len <= 0 || link->head - link->tail == LINK_SLOTS) return;
+    Datagram *d = &link->slots[link->head++ & (LINK_SLOTS - 1)];
+    d->at = at;
+    d->len = len;
+    memcpy(d->data, data, (size_t)len);
+}
+
+static const Datagram *link_receive(Link *link, uint64_t now) {
+    if (link->head == link->tail) return NULL;
+    const Datagram *d = &link->slots[link->tail & (LINK_SLOTS - 1)];
+    if (d->at > now) return NULL;
+    link->tail++;
+    return d;
+}
+
+// --- Server side ----------------------------------------------------------------
+
+// One player's seat on the simulated server: what server.c keeps in Client
+typedef struct {
+    Link in;                    // PKT_INPUT from the client
+    uint16_t seq;               // last state seq sent
+    uint32_t tick_base;         // game tick minus seq of the last state sent
+    uint16_t input_tick;        // newest input tick applied
+    uint8_t buttons;
+
+    InputPacket queue[LINK_SLOTS];  // received, not yet applied; one per tick
+    unsigned queue_head, queue_tail;
+
+    // Judgements, one per time the ball came at this paddle
+    bool *hits;
+    int count;
+} SimSeat;
+
+// --- Client side ----------------------------------------------------------------
+
+typedef struct {
+    int player;
+    Link in;                    // PKT_STATE from the server
+    bool started;
+    Prediction prediction;
+    Interpolator interp;
+    uint32_t rng;
+
+    bool approaching;           // the ball on screen is coming at us
+    bool saw_hit;               // ...and has touched our paddle on screen
+    int scores[2];              // on screen last frame
+    float aim;                  // where on the paddle the bot wants the ball
+
+    bool *hits;
+    int count;
+} SimClient;
+
+static void record(bool **hits, int *count, bool hit) {
+    if (*count % 1024 == 0) {
+        *hits = realloc(*hits, (size_t)(*count + 1024) * sizeof(bool));
+        if (!*hits) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    (*hits)[(*count)++] = hit;
+}
+
+static float random_unit(uint32_t *rng) {
+    return (game_rand(rng) >> 8) / 16777216.0f;
+}
+
+static Paddle *own_paddle(SimClient *client) {
+    return client->player == 0 ? &client->prediction.game.player1 : &client->prediction.game.player2;
+}
+
+// Chases the ball it sees, aiming to meet it at `aim` from the paddle center
+static uint8_t bot_buttons(SimClient *client, const Ball *ball) {
+    const Paddle *paddle = own_paddle(client);
+    float target = client->approaching ? ball->y + BALL_SIZE / 2.0f + client->aim : WINDOW_HEIGHT / 2.0f;
+    float center = paddle->y + paddle->h / 2.0f;
+    float deadband = PADDLE_SPEED * GAME_DT / 2.0f;
+    if (target < center - deadband) return INPUT_UP;
+    if (target > center + deadband) return INPUT_DOWN;
+    return 0;
+}
+
+static bool ball_level_with_paddle(const Ball *ball, const Paddle *paddle) {
+    return ball->y <= paddle->y + paddle->h && ball->y + BALL_SIZE >= paddle->y;
+}
+
+// Judges the frame on screen: our predicted paddle and the interpolated ball.
+// The player sees a hit when the ball crosses the paddle (swept back over
+// the frame, as the server sweeps the ball it saw), or when it turns
+// around in front of it level with it: a ball the server bounced is drawn
+// closing in on the face and going back, never touching it.
+static void client_judge(SimClient *client, const GameState *shown) {
+    float direction = client->player == 0 ? -1.0f : 1.0f;
+    bool scored = shown->scores[0] != client->scores[0] || shown->scores[1] != client->scores[1];
+    client->scores[0] = shown->scores[0];
+    client->scores[1] = shown->scores[1];
+
+    Ball ball = { shown->ball.x, shown->ball.y, shown->ball.vx, shown->ball.vy };
+    const Paddle *paddle = own_paddle(client);
+    if (client->approaching && !scored) {
+        Ball back = { ball.x, ball.y, -ball.vx, -ball.vy };
+        if (ball_paddle_impact(&back, paddle, GAME_DT) >= 0) client->saw_hit = true;
+        if (ball.vx * direction <= 0 && ball_level_with_paddle(&ball, paddle)) client->saw_hit = true;
+    }
+    if (client->approaching && (scored || ball.vx * direction <= 0)) {
+        record(&client->hits, &client->count, client->saw_hit);
+        client->approaching = false;
+    }
+    // A frame that shows a new score may still show the old ball
+    if (!client->approaching && !scored && ball.vx * direction > 0) {
+        client->approaching = true;
+        client->saw_hit = false;
+        client->aim = (random_unit(&client->rng) * 2.0f - 1.0f) * AIM_SPREAD;
+    }
+}
+
+static void client_frame(SimClient *client, Link *out, uint64_t now, uint64_t one_way) {
+    const Datagram *d;
+    GameState state;
+    uint16_t input_tick = 0;
+    bool updated = false;
+    while ((d = link_receive(&client->in, now))) {
+        PacketReader reader;
+        PacketHeader header;
+        if (!packet_decode_header(&reader, d->data, d->len, &header) || header.type != PKT_STATE ||
+            !packet_decode_state(&reader, &input_tick, &state)) continue;
+        interpolation_push(&client->interp, header.seq, &state, now);
+        updated = true;
+    }
+    if (updated) {
+        if (!client->started) {
+            Game game;
+            game_init(&game, 0);
+            game_apply_state(&game, &state);
+            prediction_init(&client->prediction, client->player, &game);
+            client->started = true;
+        } else {
+            prediction_reconcile(&client->prediction, &state, input_tick);
+        }
+    }
+    if (!client->started) return;
+
+    // Same order as client.c: sample the view, send this frame's input with
+    // it, then draw the predicted paddle with the sampled ball
+    GameState shown;
+    interpolation_sample(&client->interp, now, &shown);
+    Ball ball = { shown.ball.x, shown.ball.y, shown.ball.vx, shown.ball.vy };
+    InputPacket input = { .count = 1 };
+    input.buttons[0] = bot_buttons(client, &ball);
+    input.tick = prediction_add_input(&client->prediction, input.buttons[0]);
+    interpolation_view(&client->interp, &input.view_seq, &input.view_frac);
+
+    uint8_t buf[MAX_PACKET_SIZE];
+    link_send(out, now + one_way, buf, packet_encode_input(buf, sizeof(buf), 0, 0, &input));
+    client_judge(client, &shown);
+}
+
+// --- Simulation -------------------------------------------------------------------
+
+typedef struct {
+    int judged;
+    int saw_hit_missed;     // the player saw a hit, the server gave the point away
+    int saw_miss_hit;       // the player saw a miss, the server bounced the ball
+    int saved;              // held at the goal line, then hit
+    int ages[BALL_HISTORY * 4];     // view age in ticks when applied
+    int age_count;
+} SimResult;
+
+static int age_percentile(const SimResult *result, int percent) {
+    int want = (result->age_count * percent + 99) / 100, seen = 0;
+    for (int a = 0; a < BALL_HISTORY * 4; a++) {
+        seen += result->ages[a];
+        if (seen >= want && want > 0) return a;
+    }
+    return BALL_HISTORY * 4 - 1;
+}
+
+static void simulate(SimResult *result, int rtt_ms, int rewind_ms, int seconds, uint32_t seed) {
+    uint64_t one_way = (uint64_t)rtt_ms * 1000000ULL / 2;
+    int rewind_ticks = rewind_ms * GAME_TICK_RATE / 1000;
+
+    static SimSeat seats[2];
+    static SimClient clients[2];
+    for (int p = 0; p < 2; p++) {
+        free(seats[p].hits);
+        free(clients[p].hits);
+        memset(&seats[p], 0, sizeof(SimSeat));
+        memset(&clients[p], 0, sizeof(SimClient));
+        clients[p].player = p;
+        clients[p].rng = seed * 2654435761u ^ (uint32_t)(p + 1) * 0x9E3779B9u;
+        if (clients[p].rng == 0) clients[p].rng = 1;
+        interpolation_reset(&clients[p].interp);
+    }
+    memset(result, 0, sizeof(SimResult));
+
+    Game game;
+    BallHistory history;
+    uint32_t game_seed = seed;
+    game_init(&game, game_seed);
+    ball_history_reset(&history, &game);
+    bool held = false;
+
+    int ticks = seconds * GAME_TICK_RATE;
+    for (int t = 1; t <= ticks; t++) {
+        uint64_t now = (uint64_t)t * GAME_TICK_NS;
+
+        // Server tick: queue arrived inputs, apply one per player
+        Ball seen[2];
+        const Ball *seen_by[2] = { NULL, NULL };
+        uint8_t buttons[2];
+        for (int p = 0; p < 2; p++) {
+            SimSeat *seat = &seats[p];
+            const Datagram *d;
+            while ((d = link_receive(&seat->in, now))) {
+                PacketReader reader;
+                PacketHeader header;
+                InputPacket input;
+                if (packet_decode_header(&reader, d->data, d->len, &header) && header.type == PKT_INPUT &&
+                    packet_decode_input(&reader, &input) && seat->queue_head - seat->queue_tail < LINK_SLOTS) {
+                    seat->queue[seat->queue_head++ & (LINK_SLOTS - 1)] = input;
+                }
+            }
+            if (seat->queue_head == seat->queue_tail) {
+                buttons[p] = seat->buttons;
+                continue;
+            }
+            const InputPacket *input = &seat->queue[seat->queue_tail++ & (LINK_SLOTS - 1)];
+            buttons[p] = seat->buttons = input->buttons[0];
+            seat->input_tick = input->tick;
+
+            // As server_seen_ball: only views of states sent in the last
+            // SNAPSHOT_HISTORY ticks count
+            if ((uint16_t)(seat->seq - input->view_seq) >= SNAPSHOT_HISTORY) continue;
+            uint32_t view_tick = seat->tick_base + input->view_seq;
+            int age = (int)(game.tick - view_tick);
+            if (age >= 0 && age < BALL_HISTORY * 4) {
+                result->ages[age]++;
+                result->age_count++;
+            }
+            if (ball_history_seen(&history, view_tick, input->view_frac, rewind_ticks, &seen[p])) {
+                seen_by[p] = &seen[p];
+            }
+        }
+
+        int scores[2] = { game.score1, game.score2 };
+        float vx = game.ball.vx;
+        GameEvents events = lag_compensated_step(&game, &history, buttons[0], buttons[1],
+                                                 seen_by[0], seen_by[1], rewind_ticks);
+        game_quantize(&game);
+
+        // Server judgements: a bounce off the paddle the ball was heading
+        // for, or a point for the other side
+        if (events.paddle_hit && (vx < 0) != (game.ball.vx < 0)) {
+            int p = vx < 0 ? 0 : 1;
+            record(&seats[p].hits, &seats[p].count, true);
+            if (held) result->saved++;
+        }
+        if (game.score2 != scores[1]) record(&seats[0].hits, &seats[0].count, false);
+        if (game.score1 != scores[0]) record(&seats[1].hits, &seats[1].count, false);
+        held = events.held != 0;
+
+        GameState state;
+        Snapshot snap;
+        game_state_from_game(&state, &game);
+        snapshot_from_state(&snap, &state);
+        ball_history_record(&history, game.tick, &snap, events.scored);
+
+        for (int p = 0; p < 2; p++) {
+            SimSeat *seat = &seats[p];
+            uint8_t buf[MAX_PACKET_SIZE];
+            uint16_t seq = ++seat->seq;
+            seat->tick_base = game.tick - seq;
+            link_send(&clients[p].in, now + one_way, buf,
+                      packet_encode_snapshot(buf, sizeof(buf), seq, 0, seat->input_tick, &snap));
+        }
+
+        if (game_is_over(&game)) {
+            game_init(&game, ++game_seed);
+            ball_history_reset(&history, &game);
+            held = false;
+        }
+
+        // Client frames, between this server tick and the next
+        for (int p = 0; p < 2; p++) {
+            client_frame(&clients[p], &seats[p].in, now + CLIENT_PHASE_NS, one_way);
+        }
+    }
+
+    // The n-th time the ball came at a paddle on the server is the n-th time
+    // it came at it on that player's screen
+    for (int p = 0; p < 2; p++) {
+        int n = seats[p].count < clients[p].count ? seats[p].count : clients[p].count;
+        for (int i = 0; i < n; i++) {
+            bool server_hit = seats[p].hits[i], client_hit = clients[p].hits[i];
+            result->judged++;
+            if (client_hit && !server_hit) result->saw_hit_missed++;
+            if (!client_hit && server_hit) result->saw_miss_hit++;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int rtt_ms = 100;
+    int seconds = 3600;
+    int rewind_ms = -1;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rtt-ms") == 0 && i + 1 < argc) {
+            rtt_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rewind-ms") == 0 && i + 1 < argc) {
+            rewind_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--rtt-ms N] [--seconds N] [--rewind-ms N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    int max_rewind_ms = (BALL_HISTORY - 1) * 1000 / GAME_TICK_RATE;
+    if (rtt_ms < 0 || rtt_ms > MAX_RTT_MS || seconds < 1 || rewind_ms > max_rewind_ms) {
+        fprintf(stderr, "--rtt-ms must be 0..%d, --seconds positive, --rewind-ms at most %d\n",
+                MAX_RTT_MS, max_rewind_ms);
+        return 1;
+    }
+
+    // Compensation off, then the given window or a sweep
+    int windows[] = { 0, 50, 100, 150, 200, 300, 500 };
+    int window_count = (int)(sizeof(windows) / sizeof(windows[0]));
+    if (rewind_ms >= 0) {
+        windows[1] = rewind_ms;
+        window_count = rewind_ms > 0 ? 2 : 1;
+    }
+
+    printf("lagsim: %d s of play per run, %d ms RTT, no loss or jitter\n", seconds, rtt_ms);
+    printf("%-8s %8s %14s %14s %10s %7s\n", "rewind", "contacts", "saw hit/miss", "saw miss/hit", "disagree", "saved");
+    int age_p50 = 0, age_p99 = 0;
+    for (int w = 0; w < window_count; w++) {
+        SimResult result;
+        simulate(&result, rtt_ms, windows[w], seconds, seed);
+        if (w == 0) {
+            age_p50 = age_percentile(&result, 50);
+            age_p99 = age_percentile(&result, 99);
+        }
+        char name[16];
+        if (windows[w] == 0) {
+            snprintf(name, sizeof(name), "off");
+        } else {
+            snprintf(name, sizeof(name), "%d ms", windows[w]);
+        }
+        double n = result.judged > 0 ? result.judged : 1;
+        printf("%-8s %8d %8d %4.1f%% %8d %4.1f%% %9.2f%% %7d\n", name, result.judged,
+               result.saw_hit_missed, 100.0 * result.saw_hit_missed / n,
+               result.saw_miss_hit, 100.0 * result.saw_miss_hit / n,
+               100.0 * (result.saw_hit_missed + result.saw_miss_hit) / n, result.saved);
+    }
+    printf("Views were %.0f ms old at p50 (p99 %.0f ms) when the server applied them\n",
+           age_p50 * 1000.0 / GAME_TICK_RATE, age_p99 * 1000.0 / GAME_TICK_RATE);
+    return 0;
+}
@@ -0,0 +1,200 @@
+// UDP Pong load generator
+// Simulates many clients against a running server: every client joins, then
+// sends its paddle input once per tick and drains whatever the server sends.
+
+#include "game.c"
+#include "network.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define TICK_RATE GAME_TICK_RATE
+#define TICK_NS GAME_TICK_NS
+
+typedef struct {
+    int fd;
+    bool welcomed;
+    uint8_t buttons;
+    uint8_t recent[INPUT_REDUNDANCY];  // last inputs sent, newest first
+    uint16_t input_tick;
+    uint16_t seq;
+    uint16_t remote_seq;
+    SnapshotRing received;  // baselines for delta snapshots
+} BotClient;
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline) {
+    uint64_t now = now_ns();
+    if (deadline <= now) return;
+    struct timespec ts = {
+        .tv_sec = (time_t)((deadline - now) / 1000000000ULL),
+        .tv_nsec = (long)((deadline - now) % 1000000000ULL)
+    };
+    nanosleep(&ts, NULL);
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = SERVER_ADDR;
+    uint16_t port = SERVER_PORT;
+    int client_count = 1000;
+    int seconds = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            client_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--host ADDR] [--port N] [--clients N] [--seconds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // One socket (and so one source port) per simulated client
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)client_count + 16) {
+        limit.rlim_cur = limit.rlim_max < (rlim_t)client_count + 16 ? limit.rlim_max : (rlim_t)client_count + 16;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    struct sockaddr_in server_addr = {0};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid server address: %s\n", host);
+        return 1;
+    }
+
+    BotClient *clients = calloc((size_t)client_count, sizeof(BotClient));
+    if (!clients) return 1;
+
+    for (int i = 0; i < client_count; i++) {
+        clients[i].fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (clients[i].fd < 0) {
+            perror("socket");
+            client_count = i;
+            break;
+        }
+        fcntl(clients[i].fd, F_SETFL, O_NONBLOCK);
+        connect(clients[i].fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    printf("loadgen: %d clients -> %s:%d for %d s\n", client_count, host, port, seconds);
+
+    uint64_t packets_in = 0, bytes_in = 0, packets_out = 0, states = 0, delta_misses = 0;
+    int welcomed = 0;
+    uint64_t start = now_ns();
+    uint64_t next_tick = start;
+    uint64_t tick = 0;
+    uint8_t buf[MAX_PACKET_SIZE];
+    uint8_t out[MAX_PACKET_SIZE];
+
+    while (running && now_ns() - start < (uint64_t)seconds * 1000000000ULL) {
+        for (int i = 0; i < client_count; i++) {
+            BotClient *bot = &clients[i];
+
+            ssize_t n;
+            while ((n = recv(bot->fd, buf, sizeof(buf), 0)) > 0) {
+                packets_in++;
+                bytes_in += (uint64_t)n;
+
+                PacketReader reader;
+                PacketHeader header;
+                if (!packet_decode_header(&reader, buf, (int)n, &header)) continue;
+                if (bot->remote_seq != 0 && !sequence_greater(header.seq, bot->remote_seq)) continue;
+
+                Snapshot snap;
+                uint16_t input_tick, baseline_seq;
+                const Snapshot *baseline;
+                if (header.type == PKT_WELCOME && !bot->welcomed) {
+                    bot->welcomed = true;
+                    bot->remote_seq = header.seq;
+                    welcomed++;
+                } else if (header.type == PKT_STATE) {
+                    if (packet_decode_input_ack(&reader, &input_tick) && packet_decode_snapshot(&reader, &snap)) {
+                        snapshot_ring_put(&bot->received, header.seq, &snap);
+                        bot->remote_seq = header.seq;
+                        states++;
+                    }
+                } else if (header.type == PKT_STATE_DELTA) {
+                    if (packet_decode_input_ack(&reader, &input_tick) &&
+                        packet_decode_delta_baseline(&reader, &baseline_seq) &&
+                        (baseline = snapshot_ring_get(&bot->received, baseline_seq)) &&
+                        packet_decode_delta(&reader, baseline, &snap)) {
+                        snapshot_ring_put(&bot->received, header.seq, &snap);
+                        bot->remote_seq = header.seq;
+                        states++;
+                    } else {
+                        delta_misses++;
+                    }
+                }
+            }
+
+            if (!bot->welcomed) {
+                // Resend JOIN twice a second until the server answers
+                if (tick % (TICK_RATE / 2) == (uint64_t)i % (TICK_RATE / 2)) {
+                    int len = packet_encode_join(out, sizeof(out), ++bot->seq, bot->remote_seq);
+                    send(bot->fd, out, (size_t)len, 0);
+                    packets_out++;
+                }
+                continue;
+            }
+
+            // Wiggle the paddle so inputs change every few ticks
+            if ((tick + (uint64_t)i) % 20 == 0) bot->buttons = (uint8_t)(rand() % 3);
+            memmove(bot->recent + 1, bot->recent, INPUT_REDUNDANCY - 1);
+            bot->recent[0] = bot->buttons;
+            // Bots look at the newest state, so the server does rewind work
+            InputPacket input = { .tick = ++bot->input_tick, .count = INPUT_REDUNDANCY,
+                                  .view_seq = bot->remote_seq };
+            memcpy(input.buttons, bot->recent, INPUT_REDUNDANCY);
+            int len = packet_encode_input(out, sizeof(out), ++bot->seq, bot->remote_seq, &input);
+            send(bot->fd, out, (size_t)len, 0);
+            packets_out++;
+        }
+
+        tick++;
+        next_tick += TICK_NS;
+        sleep_until(next_tick);
+    }
+
+    double elapsed = (now_ns() - start) / 1e9;
+    printf("loadgen: %d/%d clients welcomed\n", welcomed, client_count);
+    printf("loadgen: out %.0f pkt/s, in %.0f pkt/s (%.0f states/s, %llu undecodable deltas), %.1f KB/s in\n",
+           packets_out / elapsed, packets_in / elapsed, states / elapsed,
+           (unsigned long long)delta_misses, bytes_in / elapsed / 1024.0);
+
+    for (int i = 0; i < client_count; i++) close(clients[i].fd);
+    free(clients);
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <SDL3/SDL.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
+#include "text_cache.c"
+
 typedef enum {
     MENU_ITEM_FIND_MATCH,
     MENU_ITEM_LOCAL_PLAY,
@@ -72,12 +74,12 @@ void menu_handle_event(MenuState *menu, SDL_Event *event, bool *start_matchmakin
     }
 }
 
-void menu_render(SDL_Renderer *renderer, MenuState *menu, TTF_Font *font, TTF_TextEngine *text_engine) {
+void menu_render(SDL_Renderer *renderer, MenuState *menu, TTF_Font *font, TextCache *text_cache) {
     // Clear with dark background
     SDL_SetRenderDrawColor(renderer, 15, 20, 35, 255);
     SDL_RenderClear(renderer);
 
-    if (!font || !text_engine) {
+    if (!font || !text_cache->engine) {
         // Fallback without font - draw simple rectangles for menu items
         for (int i = 0; i < MENU_ITEM_COUNT; i++) {
             SDL_FRect rect = {
@@ -101,13 +103,7 @@ void menu_render(SDL_Renderer *renderer, MenuState *menu, TTF_Font *font, TTF_Te
     }
 
     // Draw title
-    TTF_Text *title = TTF_CreateText(text_engine, font, "UDP PONG", 0);
-    if (title) {
-        int w, h;
-        TTF_GetTextSize(title, &w, &h);
-        TTF_DrawRendererText(title, WINDOW_WIDTH / 2.0f - w / 2.0f, 80);
-        TTF_DestroyText(title);
-    }
+    text_cache_draw_centered(text_cache, font, "UDP PONG", WINDOW_WIDTH / 2.0f, 80);
 
     // Draw menu items
     const char *items[] = { "Find Match", "Local Play", "Quit" };
@@ -124,34 +120,17 @@ void menu_render(SDL_Renderer *renderer, MenuState *menu, TTF_Font *font, TTF_Te
             SDL_RenderFillRect(renderer, &highlight);
         }
 
-        TTF_Text *item = TTF_CreateText(text_engine, font, items[i], 0);
-        if (item) {
-            int w, h;
-            TTF_GetTextSize(item, &w, &h);
-            TTF_DrawRendererText(item, WINDOW_WIDTH / 2.0f - w / 2.0f, 200.0f + i * 70);
-            TTF_DestroyText(item);
-        }
+        text_cache_draw_centered(text_cache, font, items[i], WINDOW_WIDTH / 2.0f, 200.0f + i * 70);
     }
 
     // Draw status text
     if (strlen(menu->status_text) > 0) {
-        TTF_Text *status = TTF_CreateText(text_engine, font, menu->status_text, 0);
-        if (status) {
-            int w, h;
-            TTF_GetTextSize(status, &w, &h);
-            TTF_DrawRendererText(status, WINDOW_WIDTH / 2.0f - w / 2.0f, 450);
-            TTF_DestroyText(status);
-        }
+        text_cache_draw_centered(text_cache, font, menu->status_text, WINDOW_WIDTH / 2.0f, 450);
     }
 
     // Draw instructions
-    TTF_Text *instructions = TTF_CreateText(text_engine, font, "UP/DOWN to select, ENTER to confirm", 0);
-    if (instructions) {
-        int w, h;
-        TTF_GetTextSize(instructions, &w, &h);
-        TTF_DrawRendererText(instructions, WINDOW_WIDTH / 2.0f - w / 2.0f, WINDOW_HEIGHT - 60);
-        TTF_DestroyText(instructions);
-    }
+    text_cache_draw_centered(text_cache, font, "UP/DOWN to select, ENTER to confirm",
+                             WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT - 60);
 
     SDL_RenderPresent(renderer);
 }
@@ -0,0 +1,306 @@
+package main
+
+// Port of the simulation in game.c, so the match handler can own the
+// physics. It has to stay bit-for-bit identical to the C version: the same
+// float32 operations in the same order, the same xorshift32 PRNG and the
+// same fixed SimDT. Products that feed an addition are converted to
+// float32 explicitly, because the Go compiler may otherwise fuse them into
+// FMA instructions (as it does on arm64), just as -ffp-contract=off keeps
+// the C compiler from doing it.
+
+// Simulation constants (must match game.c)
+const (
+	PaddleWidth  = 15
+	PaddleSpeed  = 400
+	PaddleMargin = 30
+
+	SimRate = 60 // GAME_TICK_RATE: physics steps per second
+
+	BallMaxVY      = BallSpeed * 2 // BALL_MAX_VY: paddle spin stops adding speed here
+	BallMaxBounces = 8             // BALL_MAX_BOUNCES per step
+
+	InputUp   = 0x01
+	InputDown = 0x02
+)
+
+// GAME_DT, rounded to float32 once like 1.0f / 60 in C
+const SimDT float32 = 1.0 / SimRate
+
+type Paddle struct {
+	X, Y, W, H float32
+	VY         float32
+}
+
+type Ball struct {
+	X, Y, VX, VY float32
+}
+
+// Events from one step, as GameEvents in game.c
+type GameEvents struct {
+	PaddleHit bool
+	WallHit   bool
+	Scored    bool
+}
+
+type Game struct {
+	Paddles [2]Paddle // left, right
+	Ball    Ball
+	Scores  [2]int
+	Rng     uint32 // never zero
+	Tick    uint32
+}
+
+// gameRand is xorshift32, the same generator as game_rand
+func gameRand(state *uint32) uint32 {
+	x := *state
+	x ^= x << 13
+	x ^= x >> 17
+	x ^= x << 5
+	*state = x
+	return x
+}
+
+func (b *Ball) reset(rng *uint32) {
+	r := gameRand(rng)
+	b.X = WindowWidth/2.0 - BallSize/2.0
+	b.Y = WindowHeight/2.0 - BallSize/2.0
+	b.VX = BallSpeed
+	if r&1 == 0 {
+		b.VX = -BallSpeed
+	}
+	b.VY = BallSpeed * 0.5
+	if r&2 == 0 {
+		b.VY = -BallSpeed * 0.5
+	}
+}
+
+// init matches game_init with the same seed
+func (g *Game) init(seed uint32) {
+	g.Paddles[0] = Paddle{X: PaddleMargin, Y: WindowHeight/2.0 - PaddleHeight/2.0, W: PaddleWidth, H: PaddleHeight}
+	g.Paddles[1] = Paddle{X: WindowWidth - PaddleMargin - PaddleWidth, Y: WindowHeight/2.0 - PaddleHeight/2.0, W: PaddleWidth, H: PaddleHeight}
+
+	g.Rng = seed*2654435761 ^ 0x9E3779B9
+	if g.Rng == 0 {
+		g.Rng = 0x9E3779B9
+	}
+	g.Tick = 0
+
+	g.Ball.reset(&g.Rng)
+	g.Scores = [2]int{}
+}
+
+func (p *Paddle) applyInput(buttons uint8) {
+	p.VY = 0
+	if buttons&InputUp != 0 {
+		p.VY -= PaddleSpeed
+	}
+	if buttons&InputDown != 0 {
+		p.VY += PaddleSpeed
+	}
+}
+
+func (p *Paddle) update(dt float32) {
+	p.Y += float32(p.VY * dt)
+
+	if p.Y < 0 {
+		p.Y = 0
+	}
+	if p.Y+p.H > WindowHeight {
+		p.Y = WindowHeight - p.H
+	}
+}
+
+func (b *Ball) collides(p *Paddle) bool {
+	return b.X < p.X+p.W &&
+		b.X+BallSize > p.X &&
+		b.Y < p.Y+p.H &&
+		b.Y+BallSize > p.Y
+}
+
+func (g *Game) isOver() bool {
+	return g.Scores[0] >= WinningScore || g.Scores[1] >= WinningScore
+}
+
+// addSpin is ball_add_spin
+func (b *Ball) addSpin(p *Paddle) {
+	b.VY += float32(p.VY * 0.3)
+	if b.VY > BallMaxVY {
+		b.VY = BallMaxVY
+	}
+	if b.VY < -BallMaxVY {
+		b.VY = -BallMaxVY
+	}
+}
+
+// paddleImpact is ball_paddle_impact: the swept AABB test, the earliest
+// time in [0, t] the ball overlaps p, or -1
+func (b *Ball) paddleImpact(p *Paddle, t float32) float32 {
+	enter, leave := float32(0), t
+	slab := func(pos, vel, lo, hi float32) bool {
+		if vel == 0 {
+			return pos > lo && pos < hi
+		}
+		t1 := (lo - pos) / vel
+		t2 := (hi - pos) / vel
+		if t1 > t2 {
+			t1, t2 = t2, t1
+		}
+		if t1 > enter {
+			enter = t1
+		}
+		if t2 < leave {
+			leave = t2
+		}
+		return true
+	}
+	if !slab(b.X, b.VX, p.X-BallSize, p.X+p.W) || !slab(b.Y, b.VY, p.Y-BallSize, p.Y+p.H) {
+		return -1
+	}
+	if enter < leave {
+		return enter
+	}
+	return -1
+}
+
+// What the ball reaches first in a sweep
+const (
+	hitNone = iota
+	hitTop
+	hitBottom
+	hitLeft
+	hitRight
+)
+
+// sweep is ball_sweep: the ball bounces off walls and paddles at the time
+// it reaches them, so a long step cannot carry it through a paddle
+func (b *Ball) sweep(left, right *Paddle, dt float32, events *GameEvents) {
+	t := dt
+	for bounce := 0; bounce < BallMaxBounces; bounce++ {
+		x := b.X + float32(b.VX*t)
+		y := b.Y + float32(b.VY*t)
+
+		// Earliest impact within t; a wall wins a tie with a paddle
+		hit := hitNone
+		when := t
+		if y <= 0 && b.VY < 0 {
+			hit = hitTop
+			when = -b.Y / b.VY
+		} else if y+BallSize >= WindowHeight && b.VY > 0 {
+			hit = hitBottom
+			when = (WindowHeight - BallSize - b.Y) / b.VY
+		}
+		if b.VX < 0 {
+			if at := b.paddleImpact(left, t); at >= 0 && (hit == hitNone || at < when) {
+				hit = hitLeft
+				when = at
+			}
+		}
+		if b.VX > 0 {
+			if at := b.paddleImpact(right, t); at >= 0 && (hit == hitNone || at < when) {
+				hit = hitRight
+				when = at
+			}
+		}
+
+		if hit == hitNone {
+			b.X, b.Y = x, y
+			return
+		}
+		if when < 0 {
+			when = 0
+		}
+		if when > t {
+			when = t
+		}
+		t -= when
+
+		switch hit {
+		case hitTop, hitBottom:
+			b.X += float32(b.VX * when)
+			b.Y = 0
+			if hit == hitBottom {
+				b.Y = WindowHeight - BallSize
+			}
+			b.VY = -b.VY
+			events.WallHit = true
+		case hitLeft:
+			b.X = left.X + left.W
+			b.Y += float32(b.VY * when)
+			b.VX = -b.VX
+			b.addSpin(left)
+			events.PaddleHit = true
+		default:
+			b.X = right.X - BallSize
+			b.Y += float32(b.VY * when)
+			b.VX = -b.VX
+			b.addSpin(right)
+			events.PaddleHit = true
+		}
+	}
+
+	// Out of bounces: finish the step without collisions, inside the walls
+	b.X += float32(b.VX * t)
+	b.Y += float32(b.VY * t)
+	if b.Y < 0 {
+		b.Y = 0
+	}
+	if b.Y > WindowHeight-BallSize {
+		b.Y = WindowHeight - BallSize
+	}
+}
+
+// update is game_update
+func (g *Game) update(dt float32) GameEvents {
+	var events GameEvents
+	b := &g.Ball
+	left, right := &g.Paddles[0], &g.Paddles[1]
+
+	left.update(dt)
+	right.update(dt)
+
+	// Clear of the walls and in front of both faces only the move happens
+	x := b.X + float32(b.VX*dt)
+	y := b.Y + float32(b.VY*dt)
+	if y > 0 && y+BallSize < WindowHeight && x >= left.X+left.W && x <= right.X-BallSize {
+		b.X, b.Y = x, y
+		return events
+	}
+	b.sweep(left, right, dt, &events)
+
+	// A paddle that moved into the side of the ball sends it back too
+	if b.collides(left) {
+		b.X = left.X + left.W
+		b.VX = -b.VX
+		b.addSpin(left)
+		events.PaddleHit = true
+	}
+	if b.collides(right) {
+		b.X = right.X - BallSize
+		b.VX = -b.VX
+		b.addSpin(right)
+		events.PaddleHit = true
+	}
+
+	// Scoring
+	if b.X < 0 {
+		g.Scores[1]++
+		b.reset(&g.Rng)
+		events.Scored = true
+	}
+	if b.X+BallSize > WindowWidth {
+		g.Scores[0]++
+		b.reset(&g.Rng)
+		events.Scored = true
+	}
+
+	return events
+}
+
+// step is game_step: one fixed tick with both paddles' inputs
+func (g *Game) step(buttons1, buttons2 uint8) GameEvents {
+	g.Paddles[0].applyInput(buttons1)
+	g.Paddles[1].applyInput(buttons2)
+	events := g.update(SimDT)
+	g.Tick++
+	return events
+}
@@ -0,0 +1,85 @@
+package main
+
+import (
+	"bufio"
+	"fmt"
+	"math"
+	"os"
+	"strings"
+	"testing"
+)
+
+// TestPhysicsTrace replays testdata/physics_trace.txt, recorded from game.c
+// by game_test --record, and checks the port reproduces every tick bit for
+// bit. game_test --check replays the same file through game.c.
+func TestPhysicsTrace(t *testing.T) {
+	file, err := os.Open("testdata/physics_trace.txt")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer file.Close()
+
+	var g Game
+	var dt float32
+	started := false
+	lineNo, ticks := 0, 0
+	scanner := bufio.NewScanner(file)
+	for scanner.Scan() {
+		lineNo++
+		line := scanner.Text()
+
+		if strings.HasPrefix(line, "game ") {
+			var seed uint32
+			var b [7]uint32
+			if _, err := fmt.Sscanf(line, "game %d %x %x %x %x %x %x %x", &seed, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6]); err != nil {
+				t.Fatalf("line %d: %v", lineNo, err)
+			}
+			g.init(seed)
+			dt = math.Float32frombits(b[0])
+			g.Ball = Ball{
+				X: math.Float32frombits(b[1]), Y: math.Float32frombits(b[2]),
+				VX: math.Float32frombits(b[3]), VY: math.Float32frombits(b[4]),
+			}
+			g.Paddles[0].Y = math.Float32frombits(b[5])
+			g.Paddles[1].Y = math.Float32frombits(b[6])
+			started = true
+			continue
+		}
+
+		var buttons1, buttons2 uint8
+		if _, err := fmt.Sscanf(line, "%d %d", &buttons1, &buttons2); err != nil || !started {
+			t.Fatalf("line %d: malformed: %q", lineNo, line)
+		}
+		g.Paddles[0].applyInput(buttons1)
+		g.Paddles[1].applyInput(buttons2)
+		events := g.update(dt)
+
+		if got := traceTick(buttons1, buttons2, &g, events); got != line {
+			t.Fatalf("line %d: game.go diverges from game.c\n  want %s\n  got  %s", lineNo, line, got)
+		}
+		ticks++
+	}
+	if err := scanner.Err(); err != nil {
+		t.Fatal(err)
+	}
+	if ticks == 0 {
+		t.Fatal("no ticks in trace")
+	}
+}
+
+// traceTick formats a tick as trace_format_tick in game_test.c does
+func traceTick(buttons1, buttons2 uint8, g *Game, events GameEvents) string {
+	digit := func(b bool) int {
+		if b {
+			return 1
+		}
+		return 0
+	}
+	return fmt.Sprintf("%d %d %08x %08x %08x %08x %08x %08x %d %d %08x %d%d%d",
+		buttons1, buttons2,
+		math.Float32bits(g.Ball.X), math.Float32bits(g.Ball.Y),
+		math.Float32bits(g.Ball.VX), math.Float32bits(g.Ball.VY),
+		math.Float32bits(g.Paddles[0].Y), math.Float32bits(g.Paddles[1].Y),
+		g.Scores[0], g.Scores[1], g.Rng,
+		digit(events.PaddleHit), digit(events.WallHit), digit(events.Scored))
+}
@@ -0,0 +1,622 @@
+//go:build loadtest
+
+// Offline load test for the pong module. It registers the module against a
+// fake Nakama (runtime.Initializer, NakamaModule and MatchDispatcher are
+// stand-ins kept in this file), then drives thousands of PongMatch
+// instances the way Nakama would: every player calls find_match and joins
+// the match it gets, every match ticks at its tick rate with a synthetic
+// stream of paddle inputs, and everyone leaves at the end. No Nakama,
+// Postgres or network is involved.
+//
+//	go run -tags loadtest . [-matches N] [-seconds S] [-input-hz N] [-idle-rate N] [-seed N]
+//	go run -tags loadtest . -burst N [-spread D] [-join-delay D] [-list-latency D] [-create-latency D]
+//
+// It reports the cost of each phase per call (ns and heap allocations)
+// and, for the match loop, ns and allocations per match tick, CPU per
+// match-second and the bytes broadcast per match. Everything runs on one
+// goroutine, so the numbers are per core.
+//
+// With -burst it only matchmakes instead: N players arrive over -spread,
+// each on its own goroutine, call find_match and join -join-delay after the
+// reply, as a client would after a round trip. MatchList and MatchCreate
+// take the given time, like the database and registry work behind them.
+// It reports how long players take to get paired and how many matches were
+// created for nobody or turned a player away.
+//
+// The fake MatchList keeps open matches in a list, so find_match here
+// costs less than against a real Nakama, whose MatchList is a label query.
+package main
+
+import (
+	"context"
+	"database/sql"
+	"errors"
+	"flag"
+	"fmt"
+	"os"
+	goruntime "runtime"
+	"slices"
+	"strconv"
+	"sync"
+	"time"
+
+	"github.com/heroiclabs/nakama-common/api"
+	"github.com/heroiclabs/nakama-common/runtime"
+)
+
+// --- Fake Nakama ----------------------------------------------------------
+
+type nopLogger struct{}
+
+func (l nopLogger) Debug(format string, v ...interface{})                   {}
+func (l nopLogger) Info(format string, v ...interface{})                    {}
+func (l nopLogger) Warn(format string, v ...interface{})                    {}
+func (l nopLogger) Error(format string, v ...interface{})                   {}
+func (l nopLogger) WithField(key string, v interface{}) runtime.Logger      { return l }
+func (l nopLogger) WithFields(fields map[string]interface{}) runtime.Logger { return l }
+func (l nopLogger) Fields() map[string]interface{}                          { return nil }
+
+// Embedding the interfaces makes the fakes satisfy them; anything the
+// module calls that is not implemented here panics.
+type fakeInitializer struct {
+	runtime.Initializer
+	rpcs    map[string]func(context.Context, runtime.Logger, *sql.DB, runtime.NakamaModule, string) (string, error)
+	matches map[string]func(context.Context, runtime.Logger, *sql.DB, runtime.NakamaModule) (runtime.Match, error)
+}
+
+func (i *fakeInitializer) RegisterRpc(id string, fn func(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, payload string) (string, error)) error {
+	i.rpcs[id] = fn
+	return nil
+}
+
+func (i *fakeInitializer) RegisterMatch(name string, fn func(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule) (runtime.Match, error)) error {
+	i.matches[name] = fn
+	return nil
+}
+
+type fakePresence struct {
+	userID, sessionID string
+}
+
+func (p *fakePresence) GetHidden() bool                   { return false }
+func (p *fakePresence) GetPersistence() bool              { return false }
+func (p *fakePresence) GetUsername() string               { return p.userID }
+func (p *fakePresence) GetStatus() string                 { return "" }
+func (p *fakePresence) GetReason() runtime.PresenceReason { return 0 }
+func (p *fakePresence) GetUserId() string                 { return p.userID }
+func (p *fakePresence) GetSessionId() string              { return p.sessionID }
+func (p *fakePresence) GetNodeId() string                 { return "loadtest" }
+
+type fakeMatchData struct {
+	*fakePresence
+	opCode int64
+	data   []byte
+}
+
+func (d *fakeMatchData) GetOpCode() int64      { return d.opCode }
+func (d *fakeMatchData) GetData() []byte       { return d.data }
+func (d *fakeMatchData) GetReliable() bool     { return true }
+func (d *fakeMatchData) GetReceiveTime() int64 { return 0 }
+
+// Counts what the match broadcasts. Nakama delivers a broadcast with nil
+// presences to everyone in the match.
+type fakeDispatcher struct {
+	match    *fakeMatch
+	messages [9]int64 // by op code
+	payload  int64    // bytes handed to BroadcastMessage
+	sent     int64    // payload bytes times recipients
+}
+
+func (d *fakeDispatcher) BroadcastMessage(opCode int64, data []byte, presences []runtime.Presence, sender runtime.Presence, reliable bool) error {
+	if opCode >= 0 && opCode < int64(len(d.messages)) {
+		d.messages[opCode]++
+	}
+	recipients := len(presences)
+	if presences == nil {
+		recipients = len(d.match.presences)
+	}
+	d.payload += int64(len(data))
+	d.sent += int64(len(data) * recipients)
+	return nil
+}
+
+func (d *fakeDispatcher) BroadcastMessageDeferred(opCode int64, data []byte, presences []runtime.Presence, sender runtime.Presence, reliable bool) error {
+	return d.BroadcastMessage(opCode, data, presences, sender, reliable)
+}
+
+func (d *fakeDispatcher) MatchKick(presences []runtime.Presence) error { return nil }
+func (d *fakeDispatcher) MatchLabelUpdate(label string) error          { return nil }
+
+type fakeMatch struct {
+	id         string
+	label      string
+	tickRate   int
+	handler    runtime.Match
+	state      interface{}
+	dispatcher fakeDispatcher
+	presences  []runtime.Presence
+	tick       int64
+	ended      bool
+	pairedAt   time.Time // when the second player joined
+}
+
+// The mutex lets -burst call in from many goroutines; the latencies are
+// slept outside it
+type fakeNakama struct {
+	runtime.NakamaModule
+	mu            sync.Mutex
+	listLatency   time.Duration
+	createLatency time.Duration
+	init          *fakeInitializer
+	matches       map[string]*fakeMatch
+	open          []*fakeMatch // matches with room, oldest first
+	created       int
+	listCalls     int
+}
+
+func (nk *fakeNakama) MatchCreate(ctx context.Context, module string, params map[string]interface{}) (string, error) {
+	factory, ok := nk.init.matches[module]
+	if !ok {
+		return "", errors.New("match handler not registered: " + module)
+	}
+	handler, err := factory(ctx, nopLogger{}, nil, nk)
+	if err != nil {
+		return "", err
+	}
+	if nk.createLatency > 0 {
+		time.Sleep(nk.createLatency)
+	}
+
+	nk.mu.Lock()
+	defer nk.mu.Unlock()
+	nk.created++
+	m := &fakeMatch{id: fmt.Sprintf("%08x-loadtest.local", nk.created), handler: handler}
+	m.dispatcher.match = m
+	matchCtx := context.WithValue(ctx, runtime.RUNTIME_CTX_MATCH_ID, m.id)
+	m.state, m.tickRate, m.label = handler.MatchInit(matchCtx, nopLogger{}, nil, nk, params)
+	nk.matches[m.id] = m
+	nk.open = append(nk.open, m)
+	return m.id, nil
+}
+
+func (nk *fakeNakama) MatchList(ctx context.Context, limit int, authoritative bool, label string, minSize, maxSize *int, query string) ([]*api.Match, error) {
+	if nk.listLatency > 0 {
+		time.Sleep(nk.listLatency)
+	}
+	nk.mu.Lock()
+	defer nk.mu.Unlock()
+	nk.listCalls++
+	var out []*api.Match
+	for _, m := range nk.open {
+		size := len(m.presences)
+		if len(out) >= limit {
+			break
+		}
+		if m.ended || m.label != label || (minSize != nil && size < *minSize) || (maxSize != nil && size > *maxSize) {
+			continue
+		}
+		out = append(out, &api.Match{MatchId: m.id, Authoritative: true, Size: int32(size)})
+	}
+	return out, nil
+}
+
+func (nk *fakeNakama) MatchSignal(ctx context.Context, id string, data string) (string, error) {
+	nk.mu.Lock()
+	defer nk.mu.Unlock()
+	m, ok := nk.matches[id]
+	if !ok || m.ended {
+		return "", errors.New("match not found")
+	}
+	var reply string
+	m.state, reply = m.handler.MatchSignal(ctx, nopLogger{}, nil, nk, &m.dispatcher, m.tick, m.state, data)
+	return reply, nil
+}
+
+// join runs the join attempt and join for one presence
+func (nk *fakeNakama) join(ctx context.Context, m *fakeMatch, p runtime.Presence) bool {
+	nk.mu.Lock()
+	defer nk.mu.Unlock()
+	state, ok, _ := m.handler.MatchJoinAttempt(ctx, nopLogger{}, nil, nk, &m.dispatcher, m.tick, m.state, p, nil)
+	m.state = state
+	if !ok {
+		return false
+	}
+	m.presences = append(m.presences, p)
+	m.state = m.handler.MatchJoin(ctx, nopLogger{}, nil, nk, &m.dispatcher, m.tick, m.state, []runtime.Presence{p})
+	if len(m.presences) >= 2 {
+		m.pairedAt = time.Now()
+		for i, open := range nk.open {
+			if open == m {
+				nk.open = append(nk.open[:i], nk.open[i+1:]...)
+				break
+			}
+		}
+	}
+	return true
+}
+
+func (nk *fakeNakama) lookup(id string) *fakeMatch {
+	nk.mu.Lock()
+	defer nk.mu.Unlock()
+	return nk.matches[id]
+}
+
+// --- Synthetic players ----------------------------------------------------
+
+// Holds a random input for a random time, like the scripted paddles in
+// bench.c, and sends a message whenever the input changes
+type player struct {
+	ctx       context.Context // carries the user id, as Nakama's RPC context does
+	presence  *fakePresence
+	match     *fakeMatch
+	rng       uint32
+	ticksLeft int
+	message   fakeMatchData
+	buttons   [1]byte
+}
+
+func (p *player) next(inputHz int, tickRate int) bool {
+	if p.ticksLeft > 0 {
+		p.ticksLeft--
+		return false
+	}
+	r := gameRand(&p.rng)
+	p.buttons[0] = uint8(r % 3) // none, up, down
+	mean := max(tickRate/max(inputHz, 1), 1)
+	p.ticksLeft = int(r>>8)%(2*mean) + 1
+	return true
+}
+
+// --- Measurement ----------------------------------------------------------
+
+// Time and heap allocations of one phase. A phase can be paused so the
+// harness's own bookkeeping between calls is not counted.
+type phase struct {
+	name    string
+	start   time.Time
+	mem     goruntime.MemStats
+	elapsed time.Duration
+	mallocs uint64
+	bytes   uint64
+	calls   int64
+	running bool
+}
+
+func (p *phase) begin(name string) {
+	*p = phase{name: name}
+	goruntime.GC()
+	p.resume()
+}
+
+func (p *phase) resume() {
+	goruntime.ReadMemStats(&p.mem)
+	p.start = time.Now()
+	p.running = true
+}
+
+func (p *phase) pause() {
+	if !p.running {
+		return
+	}
+	p.running = false
+	p.elapsed += time.Since(p.start)
+	var after goruntime.MemStats
+	goruntime.ReadMemStats(&after)
+	p.mallocs += after.Mallocs - p.mem.Mallocs
+	p.bytes += after.TotalAlloc - p.mem.TotalAlloc
+}
+
+func (p *phase) end() {
+	p.pause()
+	if p.calls == 0 {
+		fmt.Printf("%-12s %10d %12s %12s %12s\n", p.name, p.calls, "-", "-", "-")
+		return
+	}
+	n := float64(p.calls)
+	fmt.Printf("%-12s %10d %12.0f %12.2f %12.1f\n", p.name, p.calls,
+		float64(p.elapsed.Nanoseconds())/n, float64(p.mallocs)/n, float64(p.bytes)/n)
+}
+
+// --- Load test ------------------------------------------------------------
+
+type loadTest struct {
+	ctx       context.Context
+	nk        *fakeNakama
+	findMatch func(context.Context, runtime.Logger, *sql.DB, runtime.NakamaModule, string) (string, error)
+	idleRate  int
+
+	matches  []*fakeMatch // running, in pairing order
+	byMatch  map[*fakeMatch][]*player
+	rematch  []*player // finished a game, waiting to queue again
+	finished int
+}
+
+// matchmake has the player call find_match and join the match it gets, as
+// the client does, so the next caller sees the match filled
+func (lt *loadTest) matchmake(p *player) {
+	reply, err := lt.findMatch(p.ctx, nopLogger{}, nil, lt.nk, "{}")
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "find_match:", err)
+		os.Exit(1)
+	}
+	p.match = lt.nk.matches[replyMatchID(reply)]
+	if p.match == nil || !lt.nk.join(lt.ctx, p.match, p.presence) {
+		p.match = nil
+		return
+	}
+	if lt.byMatch[p.match] == nil {
+		lt.matches = append(lt.matches, p.match)
+		if lt.idleRate > 0 {
+			lt.signalIdleRate(p.match)
+		}
+	}
+	lt.byMatch[p.match] = append(lt.byMatch[p.match], p)
+}
+
+func (lt *loadTest) signalIdleRate(m *fakeMatch) {
+	if _, err := lt.nk.MatchSignal(lt.ctx, m.id, fmt.Sprintf(`{"idle_rate":%d}`, lt.idleRate)); err != nil {
+		fmt.Fprintln(os.Stderr, "MatchSignal:", err)
+		os.Exit(1)
+	}
+}
+
+// leave takes the player out of its match
+func (lt *loadTest) leave(p *player) {
+	m := p.match
+	p.match = nil
+	if m == nil || m.ended {
+		return
+	}
+	m.state = m.handler.MatchLeave(lt.ctx, nopLogger{}, nil, lt.nk, &m.dispatcher, m.tick, m.state, []runtime.Presence{p.presence})
+	if m.state == nil {
+		m.ended = true
+	}
+}
+
+func main() {
+	matches := flag.Int("matches", 4096, "matches to run (two players each)")
+	seconds := flag.Int("seconds", 60, "match time to simulate, in seconds")
+	inputHz := flag.Int("input-hz", 4, "average input changes per player per second")
+	idleRate := flag.Int("idle-rate", 0, "if set, signal every match to this idle rate")
+	seed := flag.Uint("seed", 1, "seed for the synthetic inputs")
+	burstPlayers := flag.Int("burst", 0, "if set, only matchmake this many concurrent players")
+	spread := flag.Duration("spread", 200*time.Millisecond, "-burst: time over which players arrive")
+	joinDelay := flag.Duration("join-delay", 50*time.Millisecond, "-burst: time from the find_match reply to the join")
+	listLatency := flag.Duration("list-latency", 2*time.Millisecond, "-burst: time a MatchList call takes")
+	createLatency := flag.Duration("create-latency", time.Millisecond, "-burst: time a MatchCreate call takes")
+	flag.Parse()
+	if *matches < 1 || *seconds < 1 {
+		fmt.Fprintln(os.Stderr, "-matches and -seconds must be positive")
+		os.Exit(2)
+	}
+
+	initializer := &fakeInitializer{
+		rpcs:    map[string]func(context.Context, runtime.Logger, *sql.DB, runtime.NakamaModule, string) (string, error){},
+		matches: map[string]func(context.Context, runtime.Logger, *sql.DB, runtime.NakamaModule) (runtime.Match, error){},
+	}
+	ctx := context.Background()
+	if err := InitModule(ctx, nopLogger{}, nil, nil, initializer); err != nil {
+		fmt.Fprintln(os.Stderr, "InitModule:", err)
+		os.Exit(1)
+	}
+	if *burstPlayers > 0 {
+		nk := &fakeNakama{init: initializer, matches: map[string]*fakeMatch{},
+			listLatency: *listLatency, createLatency: *createLatency}
+		burst(ctx, nk, initializer.rpcs["find_match"], *burstPlayers, *spread, *joinDelay, uint32(*seed))
+		return
+	}
+
+	lt := &loadTest{
+		ctx:       ctx,
+		nk:        &fakeNakama{init: initializer, matches: map[string]*fakeMatch{}},
+		findMatch: initializer.rpcs["find_match"],
+		idleRate:  *idleRate,
+		byMatch:   map[*fakeMatch][]*player{},
+	}
+
+	players := make([]*player, 2**matches)
+	for i := range players {
+		id := "user-" + strconv.Itoa(i)
+		p := &player{presence: &fakePresence{userID: id, sessionID: "session-" + strconv.Itoa(i)}}
+		p.ctx = context.WithValue(ctx, runtime.RUNTIME_CTX_USER_ID, id)
+		p.rng = uint32(*seed)*2654435761 ^ uint32(i+1)*0x9E3779B9
+		if p.rng == 0 {
+			p.rng = 1
+		}
+		p.message = fakeMatchData{fakePresence: p.presence, opCode: OpCodePaddleUpdate, data: p.buttons[:]}
+		players[i] = p
+	}
+
+	fmt.Printf("loadtest: %d matches, %d s of match time, ~%d input changes/s per player\n", *matches, *seconds, *inputHz)
+	fmt.Printf("%-12s %10s %12s %12s %12s\n", "phase", "calls", "ns/call", "allocs/call", "B/call")
+
+	var ph phase
+
+	ph.begin("find+join")
+	for _, p := range players {
+		lt.matchmake(p)
+		ph.calls++
+	}
+	ph.end()
+
+	// Join alone, on a separate set of matches; find_match costs the
+	// difference from the phase above
+	ph.begin("join")
+	joinNk := &fakeNakama{init: initializer, matches: map[string]*fakeMatch{}}
+	for i := 0; i < *matches; i++ {
+		id, _ := joinNk.MatchCreate(ctx, "pong", nil)
+		m := joinNk.matches[id]
+		joinNk.join(ctx, m, &fakePresence{userID: "a"})
+		joinNk.join(ctx, m, &fakePresence{userID: "b"})
+		ph.calls += 2
+	}
+	ph.end()
+
+	// Every match ticks with whatever inputs its players sent since the
+	// last tick. When a game is over both players leave and queue again,
+	// so the load stays the same; that churn is timed separately.
+	messages := make([]runtime.MatchData, 0, 2)
+	ticks := *seconds * TickRate
+	var churn phase
+	churn.begin("rematch")
+	churn.pause()
+	ph.begin("match tick")
+	for t := 0; t < ticks; t++ {
+		for _, m := range lt.matches {
+			if m.ended {
+				continue
+			}
+			messages = messages[:0]
+			for _, p := range lt.byMatch[m] {
+				if p.next(*inputHz, m.tickRate) {
+					messages = append(messages, &p.message)
+				}
+			}
+			m.tick++
+			m.state = m.handler.MatchLoop(ctx, nopLogger{}, nil, lt.nk, &m.dispatcher, m.tick, m.state, messages)
+			if m.state == nil {
+				m.ended = true
+			}
+			ph.calls++
+		}
+
+		ph.pause()
+		for _, m := range lt.matches {
+			if s, ok := m.state.(*MatchState); ok && s.Over && !m.ended {
+				lt.finished++
+				lt.rematch = append(lt.rematch, lt.byMatch[m]...)
+			}
+		}
+		if len(lt.rematch) > 0 {
+			churn.resume()
+			for _, p := range lt.rematch {
+				lt.leave(p)
+			}
+			for _, p := range lt.rematch {
+				lt.matchmake(p)
+				churn.calls++
+			}
+			churn.pause()
+			lt.rematch = lt.rematch[:0]
+		}
+		ph.resume()
+	}
+	ph.end()
+	loopNs := float64(ph.elapsed.Nanoseconds())
+	churn.end()
+
+	ph.begin("leave")
+	for _, p := range players {
+		if p.match != nil {
+			lt.leave(p)
+			ph.calls++
+		}
+	}
+	ph.end()
+
+	// Broadcast totals per second of match time (games are back to back,
+	// so that is `matches` running matches for `seconds`)
+	var messagesByOp [len(fakeDispatcher{}.messages)]int64
+	var payload, sent int64
+	for _, m := range lt.matches {
+		for op, n := range m.dispatcher.messages {
+			messagesByOp[op] += n
+		}
+		payload += m.dispatcher.payload
+		sent += m.dispatcher.sent
+	}
+	perMatchSecond := float64(*matches * *seconds)
+	fmt.Println()
+	fmt.Printf("matches: %d created, %d games finished, %d MatchList calls\n",
+		lt.nk.created, lt.finished, lt.nk.listCalls)
+	fmt.Printf("loop: %.2f us CPU per match-second\n", loopNs/1000/perMatchSecond)
+	fmt.Printf("broadcast per match-second: %.1f states, %.2f scores, %.3f game overs, %.0f B payload, %.0f B to clients\n",
+		float64(messagesByOp[OpCodeGameState])/perMatchSecond, float64(messagesByOp[OpCodeScoreUpdate])/perMatchSecond,
+		float64(messagesByOp[OpCodeGameOver])/perMatchSecond, float64(payload)/perMatchSecond, float64(sent)/perMatchSecond)
+}
+
+// burst matchmakes n players concurrently and reports pairing latency
+// (from calling find_match to the second player joining the match) and the
+// matchmaking mistakes
+func burst(ctx context.Context, nk *fakeNakama, findMatch func(context.Context, runtime.Logger, *sql.DB, runtime.NakamaModule, string) (string, error),
+	n int, spread, joinDelay time.Duration, seed uint32) {
+	type result struct {
+		start  time.Time
+		rpc    time.Duration
+		match  *fakeMatch
+		joined bool
+	}
+	results := make([]result, n)
+	rng := seed*2654435761 ^ 0x9E3779B9
+	if rng == 0 {
+		rng = 1
+	}
+
+	fmt.Printf("burst: %d players over %v, join %v after the reply, MatchList %v, MatchCreate %v\n",
+		n, spread, joinDelay, nk.listLatency, nk.createLatency)
+	var wg sync.WaitGroup
+	begin := time.Now()
+	for i := range results {
+		arrival := time.Duration(uint64(gameRand(&rng)) * uint64(spread) >> 32)
+		wg.Add(1)
+		go func(i int, r *result) {
+			defer wg.Done()
+			time.Sleep(time.Until(begin.Add(arrival)))
+			id := "user-" + strconv.Itoa(i)
+			r.start = time.Now()
+			reply, err := findMatch(context.WithValue(ctx, runtime.RUNTIME_CTX_USER_ID, id), nopLogger{}, nil, nk, "{}")
+			r.rpc = time.Since(r.start)
+			if err != nil {
+				return
+			}
+			time.Sleep(joinDelay)
+			r.match = nk.lookup(replyMatchID(reply))
+			r.joined = r.match != nil && nk.join(ctx, r.match, &fakePresence{userID: id, sessionID: "session-" + strconv.Itoa(i)})
+		}(i, &results[i])
+	}
+	wg.Wait()
+
+	var rpcs, paired []time.Duration
+	rejected, alone := 0, 0
+	for _, r := range results {
+		rpcs = append(rpcs, r.rpc)
+		switch {
+		case !r.joined:
+			rejected++
+		case r.match.pairedAt.IsZero():
+			alone++
+		default:
+			paired = append(paired, r.match.pairedAt.Sub(r.start))
+		}
+	}
+	empty := 0
+	for _, m := range nk.matches {
+		if len(m.presences) == 0 {
+			empty++
+		}
+	}
+	fmt.Printf("find_match: p50 %v, p99 %v, max %v\n", percentile(rpcs, 50), percentile(rpcs, 99), percentile(rpcs, 100))
+	fmt.Printf("paired:     %d players, p50 %v, p99 %v, max %v\n", len(paired),
+		percentile(paired, 50), percentile(paired, 99), percentile(paired, 100))
+	fmt.Printf("matches: %d created, %d needed, %d never joined, %d MatchList calls\n",
+		nk.created, (n+1)/2, empty, nk.listCalls)
+	fmt.Printf("players: %d turned away from a full match, %d left waiting alone\n", rejected, alone)
+}
+
+func percentile(d []time.Duration, p int) time.Duration {
+	if len(d) == 0 {
+		return 0
+	}
+	slices.Sort(d)
+	return d[min((len(d)*p+99)/100, len(d))-1].Round(10 * time.Microsecond)
+}
+
+// The match id from find_match's {"match_id":"..."}, without going through
+// encoding/json so the harness adds no allocations of its own
+func replyMatchID(reply string) string {
+	const prefix = `{"match_id":"`
+	if len(reply) < len(prefix)+2 || reply[:len(prefix)] != prefix {
+		return ""
+	}
+	return reply[len(prefix) : len(reply)-2]
+}
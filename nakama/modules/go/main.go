@@ -3,7 +3,12 @@ package main
 import (
 	"context"
 	"database/sql"
+	"encoding/binary"
 	"encoding/json"
+	"fmt"
+	"hash/fnv"
+	"math"
+	"sync"
 
 	"github.com/heroiclabs/nakama-common/runtime"
 )
@@ -17,6 +22,7 @@ const (
 	OpCodeGameStart    = 5
 	OpCodeScoreUpdate  = 6
 	OpCodeGameOver     = 7
+	OpCodePlayerAssign = 8
 )
 
 // Game constants
@@ -30,17 +36,71 @@ const (
 	TickRate      = 30
 )
 
+// Physics steps per match tick; TickRate must divide SimRate
+const StepsPerTick = SimRate / TickRate
+
+// Default per-match rates, in state updates per second. Nakama fixes a
+// match's tick rate when it is created, so a slower rate skips ticks: the
+// handler does its work every TickRate/rate ticks and catches the
+// simulation up then. Both can be changed per match through MatchSignal.
+const (
+	ActiveRate = TickRate // rallies
+	IdleRate   = 5        // waiting for a player, serve pause, game over
+	ServeDelay = SimRate  // physics steps the ball waits after a point
+)
+
+// A player left waiting alone this long puts the match up for pairing
+// again, in case the caller it was handed to never joined
+const ReofferTicks = 5 * TickRate
+
+// Binary match data, big-endian like the UDP protocol in network.c.
+//
+// OpCodePaddleUpdate, client to server (PaddleUpdateSize bytes):
+//
+//	uint8   input bits, InputUp | InputDown
+//
+// OpCodeGameState, every tick (GameStateSize bytes):
+//
+//	uint32  physics steps since the match started, serve pauses included:
+//	        the state's time in 1/SimRate seconds, which clients
+//	        interpolate by
+//	float32 ball x, y, vx, vy
+//	float32 paddle 1 y, paddle 2 y
+//
+// OpCodeScoreUpdate, when a point is scored (ScoreUpdateSize bytes):
+//
+//	uint8   score 1, score 2
+//
+// OpCodeGameOver, once (GameOverSize bytes):
+//
+//	uint8   winning player number
+//
+// OpCodePlayerAssign, to a player when it joins, and again when its
+// opponent leaves and it waits for a new one (PlayerAssignSize bytes):
+//
+//	uint8   its player number, 1 (left paddle) or 2
+//
+// Messages of any other length are dropped.
+const (
+	PaddleUpdateSize = 1
+	GameStateSize    = 28
+	ScoreUpdateSize  = 2
+	GameOverSize     = 1
+	PlayerAssignSize = 1
+)
+
 func InitModule(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, initializer runtime.Initializer) error {
 	logger.Info("Pong module loading...")
 
 	// Register RPC for finding/creating matches
-	if err := initializer.RegisterRpc("find_match", rpcFindMatch); err != nil {
+	queue := &matchQueue{byID: make(map[string]*openMatch)}
+	if err := initializer.RegisterRpc("find_match", queue.rpcFindMatch); err != nil {
 		return err
 	}
 
 	// Register match handler
 	if err := initializer.RegisterMatch("pong", func(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule) (runtime.Match, error) {
-		return &PongMatch{}, nil
+		return &PongMatch{queue: queue}, nil
 	}); err != nil {
 		return err
 	}
@@ -49,90 +109,257 @@ func InitModule(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runti
 	return nil
 }
 
+// matchQueue pairs find_match callers in constant time. A caller takes the
+// oldest match still waiting for a second player. If there is none, it
+// queues a placeholder, creates the match outside the lock and fills the
+// placeholder in; a caller that takes the placeholder meanwhile waits for
+// that. Every entry goes to exactly one caller, so two callers never both
+// create a match for lack of one, or both get the last free slot.
+//
+// The queue only knows matches created by this process. The first call
+// seeds it from MatchList to pick up matches that were open before the
+// module (re)loaded; after that MatchList is never called.
+type matchQueue struct {
+	mu     sync.Mutex
+	fifo   []*openMatch // from head; entries may no longer be available
+	head   int
+	byID   map[string]*openMatch
+	seeded bool
+}
+
+type openMatch struct {
+	id        string        // empty while being created
+	available bool          // not yet handed out or withdrawn
+	created   chan struct{} // closed once id or err is set
+	err       error
+}
+
+var closedChan = func() chan struct{} {
+	c := make(chan struct{})
+	close(c)
+	return c
+}()
+
+// offer puts an existing match up for pairing, unless it already is
+func (q *matchQueue) offer(id string) {
+	q.mu.Lock()
+	q.offerLocked(id)
+	q.mu.Unlock()
+}
+
+func (q *matchQueue) offerLocked(id string) {
+	if q.byID[id] != nil {
+		return
+	}
+	e := &openMatch{id: id, available: true, created: closedChan}
+	q.byID[id] = e
+	q.fifo = append(q.fifo, e)
+}
+
+// remove withdraws a match, e.g. because it ended. Its entry stays in the
+// FIFO until takeLocked skips over it.
+func (q *matchQueue) remove(id string) {
+	q.mu.Lock()
+	if e := q.byID[id]; e != nil {
+		e.available = false
+		delete(q.byID, id)
+	}
+	q.mu.Unlock()
+}
+
+// takeLocked hands out the oldest available entry
+func (q *matchQueue) takeLocked() (*openMatch, bool) {
+	for q.head < len(q.fifo) {
+		e := q.fifo[q.head]
+		q.fifo[q.head] = nil
+		q.head++
+		if e.available {
+			e.available = false
+			if e.id != "" {
+				delete(q.byID, e.id)
+			}
+			q.compactLocked()
+			return e, true
+		}
+	}
+	q.compactLocked()
+	return nil, false
+}
+
+// compactLocked reclaims the consumed front of the FIFO
+func (q *matchQueue) compactLocked() {
+	if q.head == len(q.fifo) {
+		q.fifo = q.fifo[:0]
+		q.head = 0
+	} else if q.head >= 1024 && q.head*2 >= len(q.fifo) {
+		q.fifo = q.fifo[:copy(q.fifo, q.fifo[q.head:])]
+		q.head = 0
+	}
+}
+
+// seedLocked offers the matches with room that MatchList knows about
+func (q *matchQueue) seedLocked(ctx context.Context, logger runtime.Logger, nk runtime.NakamaModule) error {
+	minSize := 0
+	maxSize := 1
+	matches, err := nk.MatchList(ctx, 100, true, "pong-match", &minSize, &maxSize, "")
+	if err != nil {
+		return err
+	}
+	for _, match := range matches {
+		q.offerLocked(match.MatchId)
+	}
+	q.seeded = true
+	logger.Info("Matchmaking queue seeded with %d open matches", len(matches))
+	return nil
+}
+
 // RPC to find or create a match
-func rpcFindMatch(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, payload string) (string, error) {
+func (q *matchQueue) rpcFindMatch(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, payload string) (string, error) {
 	userID, ok := ctx.Value(runtime.RUNTIME_CTX_USER_ID).(string)
 	if !ok {
 		userID = "anonymous"
 	}
 	logger.Info("User %s looking for match", userID)
 
-	// Try to find an existing match with space
-	limit := 10
-	authoritative := true
-	label := "pong-match"
-	minSize := 0
-	maxSize := 1
-	query := ""
+	q.mu.Lock()
+	if !q.seeded {
+		if err := q.seedLocked(ctx, logger, nk); err != nil {
+			q.mu.Unlock()
+			logger.Error("Error listing matches: %v", err)
+			return "", err
+		}
+	}
 
-	matches, err := nk.MatchList(ctx, limit, authoritative, label, &minSize, &maxSize, query)
-	if err != nil {
-		logger.Error("Error listing matches: %v", err)
-		return "", err
+	e, found := q.takeLocked()
+	if !found {
+		e = &openMatch{available: true, created: make(chan struct{})}
+		q.fifo = append(q.fifo, e)
 	}
+	q.mu.Unlock()
 
-	var matchID string
-	if len(matches) > 0 {
-		matchID = matches[0].MatchId
-		logger.Info("Found existing match: %s", matchID)
+	if found {
+		<-e.created
+		if e.err != nil {
+			logger.Error("Error creating match: %v", e.err)
+			return "", e.err
+		}
+		logger.Info("Found existing match: %s", e.id)
 	} else {
-		// Create new match
-		matchID, err = nk.MatchCreate(ctx, "pong", map[string]interface{}{})
+		// Create new match; it waits in the queue for the next caller
+		id, err := nk.MatchCreate(ctx, "pong", map[string]interface{}{})
+		q.mu.Lock()
+		e.id, e.err = id, err
+		if err != nil {
+			e.available = false
+		} else if e.available {
+			q.byID[id] = e
+		}
+		q.mu.Unlock()
+		close(e.created)
 		if err != nil {
 			logger.Error("Error creating match: %v", err)
 			return "", err
 		}
-		logger.Info("Created new match: %s", matchID)
+		logger.Info("Created new match: %s", id)
 	}
 
-	response, _ := json.Marshal(map[string]string{"match_id": matchID})
+	response, _ := json.Marshal(map[string]string{"match_id": e.id})
 	return string(response), nil
 }
 
 // PongMatch implements the match handler
-type PongMatch struct{}
+type PongMatch struct {
+	queue *matchQueue
+}
 
-// Match state
+// Match state. The match owns the simulation: clients only send which
+// way they want their paddle to move.
 type MatchState struct {
-	Presences   map[string]*PlayerPresence `json:"presences"`
-	PlayerCount int                        `json:"player_count"`
-	Started     bool                       `json:"started"`
-	Ball        Ball                       `json:"ball"`
-	Paddles     map[int]*Paddle            `json:"paddles"`
-	Scores      map[int]int                `json:"scores"`
+	ID          string
+	Presences   map[string]*PlayerPresence
+	PlayerCount int
+	Seats       [2]string // user id per paddle, "" while free
+	Started     bool
+	Over        bool
+	Game        Game
+	Inputs      [2]uint8 // latest input bits, indexed by player number - 1
+	Rates       TickRates
+	ServeSteps  int    // serve pause left, in physics steps
+	LastWork    int64  // match tick the simulation has caught up to
+	NextWork    int64  // next match tick that does work
+	AloneSince  int64  // match tick the only player was left waiting
+	Steps       uint32 // physics steps run, serve pauses included
+
+	// Reused for every broadcast. BroadcastMessage encodes the envelope
+	// before it returns, so the buffers are free again next tick.
+	stateBuf [GameStateSize]byte
+	eventBuf [ScoreUpdateSize]byte
 }
 
 type PlayerPresence struct {
-	UserID    string `json:"user_id"`
-	PlayerNum int    `json:"player_num"`
+	UserID    string
+	PlayerNum int
+}
+
+// TickRates is also the MatchSignal request and reply:
+// {"active_rate":30,"idle_rate":5}. Rates must divide TickRate; a missing
+// or zero field keeps the current value.
+type TickRates struct {
+	Active int `json:"active_rate"`
+	Idle   int `json:"idle_rate"`
 }
 
-type Ball struct {
-	X  float64 `json:"x"`
-	Y  float64 `json:"y"`
-	VX float64 `json:"vx"`
-	VY float64 `json:"vy"`
+type signalReply struct {
+	TickRates
+	Error string `json:"error,omitempty"`
 }
 
-type Paddle struct {
-	Y float64 `json:"y"`
+func validRate(rate int) bool {
+	return rate >= 1 && rate <= TickRate && TickRate%rate == 0
 }
 
-type GameStateMessage struct {
-	Ball    Ball           `json:"ball"`
-	Paddles map[int]*Paddle `json:"paddles"`
-	Scores  map[int]int    `json:"scores"`
+// encodeGameState writes the OpCodeGameState payload into the state's
+// buffer and returns it
+func encodeGameState(s *MatchState) []byte {
+	b := s.stateBuf[:]
+	g := &s.Game
+	be := binary.BigEndian
+	be.PutUint32(b[0:], s.Steps)
+	be.PutUint32(b[4:], math.Float32bits(g.Ball.X))
+	be.PutUint32(b[8:], math.Float32bits(g.Ball.Y))
+	be.PutUint32(b[12:], math.Float32bits(g.Ball.VX))
+	be.PutUint32(b[16:], math.Float32bits(g.Ball.VY))
+	be.PutUint32(b[20:], math.Float32bits(g.Paddles[0].Y))
+	be.PutUint32(b[24:], math.Float32bits(g.Paddles[1].Y))
+	return b
+}
+
+// decodePaddleUpdate reads an OpCodePaddleUpdate payload
+func decodePaddleUpdate(data []byte) (uint8, bool) {
+	if len(data) != PaddleUpdateSize {
+		return 0, false
+	}
+	return data[0] & (InputUp | InputDown), true
+}
+
+// matchSeed derives the simulation seed from the match id
+func matchSeed(id string) uint32 {
+	h := fnv.New32a()
+	h.Write([]byte(id))
+	return h.Sum32()
 }
 
 func (m *PongMatch) MatchInit(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, params map[string]interface{}) (interface{}, int, string) {
+	id, _ := ctx.Value(runtime.RUNTIME_CTX_MATCH_ID).(string)
 	state := &MatchState{
+		ID:          id,
 		Presences:   make(map[string]*PlayerPresence),
 		PlayerCount: 0,
 		Started:     false,
-		Ball:        Ball{X: 400, Y: 300, VX: BallSpeed, VY: BallSpeed * 0.5},
-		Paddles:     map[int]*Paddle{1: {Y: 250}, 2: {Y: 250}},
-		Scores:      map[int]int{1: 0, 2: 0},
+		Rates:       TickRates{Active: ActiveRate, Idle: IdleRate},
+		ServeSteps:  ServeDelay,
 	}
+	state.Game.init(matchSeed(id))
 	return state, TickRate, "pong-match"
 }
 
@@ -144,68 +371,177 @@ func (m *PongMatch) MatchJoinAttempt(ctx context.Context, logger runtime.Logger,
 func (m *PongMatch) MatchJoin(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, dispatcher runtime.MatchDispatcher, tick int64, state interface{}, presences []runtime.Presence) interface{} {
 	s := state.(*MatchState)
 	for _, p := range presences {
+		// A player who left before the start frees its seat, so the
+		// joiner takes whichever paddle is free rather than the count
+		seat := 0
+		if s.Seats[0] != "" {
+			seat = 1
+		}
+		s.Seats[seat] = p.GetUserId()
+		s.Inputs[seat] = 0
 		s.PlayerCount++
 		s.Presences[p.GetUserId()] = &PlayerPresence{
 			UserID:    p.GetUserId(),
-			PlayerNum: s.PlayerCount,
+			PlayerNum: seat + 1,
 		}
-		logger.Info("Player joined: %s as player %d", p.GetUserId(), s.PlayerCount)
+		s.eventBuf[0] = uint8(seat + 1)
+		dispatcher.BroadcastMessage(OpCodePlayerAssign, s.eventBuf[:PlayerAssignSize], []runtime.Presence{p}, nil, true)
+		logger.Info("Player joined: %s as player %d", p.GetUserId(), seat+1)
 	}
+	s.AloneSince = tick
 	return s
 }
 
 func (m *PongMatch) MatchLeave(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, dispatcher runtime.MatchDispatcher, tick int64, state interface{}, presences []runtime.Presence) interface{} {
 	s := state.(*MatchState)
 	for _, p := range presences {
+		presence, ok := s.Presences[p.GetUserId()]
+		if !ok {
+			continue
+		}
+		s.Seats[presence.PlayerNum-1] = ""
 		delete(s.Presences, p.GetUserId())
 		s.PlayerCount--
 		logger.Info("Player left: %s", p.GetUserId())
 	}
 	if s.PlayerCount < 1 {
+		m.queue.remove(s.ID)
 		return nil // End match
 	}
+	if s.Started {
+		m.reset(dispatcher, s)
+	}
+	s.AloneSince = tick
+	m.queue.offer(s.ID)
 	return s
 }
 
+// reset puts a started match whose opponent left back to waiting, as the
+// UDP server does: the player left keeps its paddle, is told its seat again
+// and gets a fresh game, and the match is offered to the next caller
+func (m *PongMatch) reset(dispatcher runtime.MatchDispatcher, s *MatchState) {
+	s.Game.init(s.Game.Rng)
+	s.Started = false
+	s.Over = false
+	s.Inputs = [2]uint8{}
+	s.ServeSteps = ServeDelay
+
+	for _, presence := range s.Presences {
+		s.eventBuf[0] = uint8(presence.PlayerNum)
+		dispatcher.BroadcastMessage(OpCodePlayerAssign, s.eventBuf[:PlayerAssignSize], nil, nil, true)
+	}
+	s.eventBuf[0] = 0
+	s.eventBuf[1] = 0
+	dispatcher.BroadcastMessage(OpCodeScoreUpdate, s.eventBuf[:ScoreUpdateSize], nil, nil, true)
+	dispatcher.BroadcastMessage(OpCodeGameState, encodeGameState(s), nil, nil, true)
+}
+
 func (m *PongMatch) MatchLoop(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, dispatcher runtime.MatchDispatcher, tick int64, state interface{}, messages []runtime.MatchData) interface{} {
 	s := state.(*MatchState)
 
-	// Process incoming messages (paddle updates from clients)
+	// Process incoming messages (paddle inputs from clients)
 	for _, msg := range messages {
 		switch msg.GetOpCode() {
 		case OpCodePaddleUpdate:
-			// Update paddle position from client
-			var paddleUpdate struct {
-				Y float64 `json:"y"`
-			}
-			if err := json.Unmarshal(msg.GetData(), &paddleUpdate); err == nil {
-				if presence, ok := s.Presences[msg.GetUserId()]; ok {
-					if paddle, ok := s.Paddles[presence.PlayerNum]; ok {
-						paddle.Y = paddleUpdate.Y
-					}
+			if buttons, ok := decodePaddleUpdate(msg.GetData()); ok {
+				if presence, ok := s.Presences[msg.GetUserId()]; ok && presence.PlayerNum >= 1 && presence.PlayerNum <= 2 {
+					s.Inputs[presence.PlayerNum-1] = buttons
 				}
 			}
 		}
 	}
 
-	// Broadcast game state to all players
-	if s.PlayerCount >= 2 {
-		gameState := GameStateMessage{
-			Ball:    s.Ball,
-			Paddles: s.Paddles,
-			Scores:  s.Scores,
+	// The game runs while both players are in and until someone wins.
+	// Time spent waiting is not simulated.
+	if s.PlayerCount < 2 || s.Over {
+		s.LastWork = tick
+		if !s.Started && s.PlayerCount == 1 && tick > s.AloneSince && (tick-s.AloneSince)%ReofferTicks == 0 {
+			m.queue.offer(s.ID)
+		}
+		return s
+	}
+	s.Started = true
+	if tick < s.NextWork {
+		return s
+	}
+
+	// Catch up on every physics step since the last working tick. During
+	// the serve pause only the paddles move.
+	steps := int(tick-s.LastWork) * StepsPerTick
+	s.LastWork = tick
+	for i := 0; i < steps && !s.Over; i++ {
+		s.Steps++
+		if s.ServeSteps > 0 {
+			s.ServeSteps--
+			for p := range s.Game.Paddles {
+				s.Game.Paddles[p].applyInput(s.Inputs[p])
+				s.Game.Paddles[p].update(SimDT)
+			}
+			continue
+		}
+
+		events := s.Game.step(s.Inputs[0], s.Inputs[1])
+		if !events.Scored {
+			continue
+		}
+		s.ServeSteps = ServeDelay
+
+		s.eventBuf[0] = uint8(s.Game.Scores[0])
+		s.eventBuf[1] = uint8(s.Game.Scores[1])
+		dispatcher.BroadcastMessage(OpCodeScoreUpdate, s.eventBuf[:ScoreUpdateSize], nil, nil, true)
+
+		if s.Game.isOver() {
+			s.Over = true
+			s.eventBuf[0] = 1
+			if s.Game.Scores[1] > s.Game.Scores[0] {
+				s.eventBuf[0] = 2
+			}
+			dispatcher.BroadcastMessage(OpCodeGameOver, s.eventBuf[:GameOverSize], nil, nil, true)
+			logger.Info("Match over: player %d wins %d-%d", s.eventBuf[0], s.Game.Scores[0], s.Game.Scores[1])
 		}
-		data, _ := json.Marshal(gameState)
-		dispatcher.BroadcastMessage(OpCodeGameState, data, nil, nil, true)
 	}
 
+	dispatcher.BroadcastMessage(OpCodeGameState, encodeGameState(s), nil, nil, true)
+
+	interval := int64(TickRate / s.Rates.Active)
+	if s.ServeSteps > 0 {
+		// Idle, but wake up in time for the serve
+		serve := int64((s.ServeSteps + StepsPerTick - 1) / StepsPerTick)
+		interval = min(int64(TickRate/s.Rates.Idle), serve)
+	}
+	s.NextWork = tick + interval
 	return s
 }
 
 func (m *PongMatch) MatchTerminate(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, dispatcher runtime.MatchDispatcher, tick int64, state interface{}, graceSeconds int) interface{} {
+	m.queue.remove(state.(*MatchState).ID)
 	return nil
 }
 
+// MatchSignal changes the match's tick rates (see TickRates) and replies
+// with the rates in effect
 func (m *PongMatch) MatchSignal(ctx context.Context, logger runtime.Logger, db *sql.DB, nk runtime.NakamaModule, dispatcher runtime.MatchDispatcher, tick int64, state interface{}, data string) (interface{}, string) {
-	return state, data
+	s := state.(*MatchState)
+	var reply signalReply
+	var req TickRates
+	if err := json.Unmarshal([]byte(data), &req); err != nil {
+		reply.Error = "bad signal: " + err.Error()
+	} else if (req.Active != 0 && !validRate(req.Active)) || (req.Idle != 0 && !validRate(req.Idle)) {
+		reply.Error = fmt.Sprintf("rates must divide %d", TickRate)
+	} else {
+		if req.Active != 0 {
+			s.Rates.Active = req.Active
+		}
+		if req.Idle != 0 {
+			s.Rates.Idle = req.Idle
+		}
+		// Apply the new rate from the next tick rather than after the
+		// current interval
+		s.NextWork = min(s.NextWork, tick+1)
+		logger.Info("Tick rates now %d Hz active, %d Hz idle", s.Rates.Active, s.Rates.Idle)
+	}
+
+	reply.TickRates = s.Rates
+	response, _ := json.Marshal(reply)
+	return s, string(response)
 }
@@ -0,0 +1,171 @@
+package main
+
+import (
+	"context"
+	"testing"
+
+	"github.com/heroiclabs/nakama-common/runtime"
+)
+
+// Minimal stand-ins for what MatchLoop touches. The load test has fuller
+// fakes, but it is behind a build tag and these have to build without it.
+// Anything not implemented here panics through the nil embedded interface.
+
+type testLogger struct{ runtime.Logger }
+
+func (testLogger) Info(format string, v ...interface{}) {}
+
+type testDispatcher struct {
+	runtime.MatchDispatcher
+	messages [9]int64 // by op code
+}
+
+func (d *testDispatcher) BroadcastMessage(opCode int64, data []byte, presences []runtime.Presence, sender runtime.Presence, reliable bool) error {
+	d.messages[opCode]++
+	return nil
+}
+
+type testPresence struct {
+	runtime.Presence
+	userID string
+}
+
+func (p *testPresence) GetUserId() string { return p.userID }
+
+type testMatchData struct {
+	*testPresence
+	data [PaddleUpdateSize]byte
+}
+
+func (d *testMatchData) GetOpCode() int64      { return OpCodePaddleUpdate }
+func (d *testMatchData) GetData() []byte       { return d.data[:] }
+func (d *testMatchData) GetReliable() bool     { return true }
+func (d *testMatchData) GetReceiveTime() int64 { return 0 }
+
+// matchLoopBench is a started two-player match that sends both paddle
+// updates every tick, so each tick decodes inputs, steps the game and
+// encodes a state
+type matchLoopBench struct {
+	ctx        context.Context
+	logger     runtime.Logger
+	match      *PongMatch
+	state      *MatchState
+	dispatcher testDispatcher
+	inputs     [2]testMatchData
+	messages   []runtime.MatchData
+	tick       int64
+}
+
+func newMatchLoopBench() *matchLoopBench {
+	ctx := context.WithValue(context.Background(), runtime.RUNTIME_CTX_MATCH_ID, "bench.nakama")
+	// Boxed once: testLogger is not zero-sized, so converting it on every
+	// call would allocate in the test rather than in the module
+	lb := &matchLoopBench{ctx: ctx, logger: testLogger{}, match: &PongMatch{}}
+	state, _, _ := lb.match.MatchInit(ctx, lb.logger, nil, nil, nil)
+	presences := []runtime.Presence{&testPresence{userID: "a"}, &testPresence{userID: "b"}}
+	lb.state = lb.match.MatchJoin(ctx, lb.logger, nil, nil, &lb.dispatcher, 0, state, presences).(*MatchState)
+	for i := range lb.inputs {
+		lb.inputs[i].testPresence = presences[i].(*testPresence)
+		lb.messages = append(lb.messages, &lb.inputs[i])
+	}
+	return lb
+}
+
+// step runs match ticks up to and including the next one that does work
+// and broadcasts a state. Ticks in between (the idle rate during the serve
+// pause) return at once; counting them would hide a per-state allocation.
+func (lb *matchLoopBench) step() {
+	states := lb.dispatcher.messages[OpCodeGameState]
+	for lb.dispatcher.messages[OpCodeGameState] == states {
+		lb.tick++
+		// The paddles sweep up and down out of phase, so rallies and
+		// points both happen
+		lb.inputs[0].data[0] = uint8(1 + lb.tick/20%2)
+		lb.inputs[1].data[0] = uint8(1 + lb.tick/27%2)
+		lb.match.MatchLoop(lb.ctx, lb.logger, nil, nil, &lb.dispatcher, lb.tick, lb.state, lb.messages)
+	}
+
+	// Start over when a game ends, so every step keeps simulating
+	if lb.state.Over {
+		lb.state.Game.init(lb.state.Game.Rng)
+		lb.state.Over = false
+		lb.state.ServeSteps = ServeDelay
+	}
+}
+
+// The match tick is the binary opcode path: decodePaddleUpdate on every
+// input and encodeGameState into the reused buffer. It must not allocate.
+func TestMatchLoopAllocs(t *testing.T) {
+	lb := newMatchLoopBench()
+	if allocs := testing.AllocsPerRun(2000, lb.step); allocs != 0 {
+		t.Fatalf("match tick allocates %.2f times per state, want 0", allocs)
+	}
+	if lb.dispatcher.messages[OpCodeGameState] == 0 || lb.dispatcher.messages[OpCodeScoreUpdate] == 0 {
+		t.Fatalf("match did not play: %v broadcasts by op code", lb.dispatcher.messages)
+	}
+}
+
+func BenchmarkMatchLoop(b *testing.B) {
+	lb := newMatchLoopBench()
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		lb.step()
+	}
+}
+
+func BenchmarkEncodeGameState(b *testing.B) {
+	lb := newMatchLoopBench()
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		encodeGameState(lb.state)
+	}
+}
+
+func BenchmarkDecodePaddleUpdate(b *testing.B) {
+	data := []byte{InputUp}
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		decodePaddleUpdate(data)
+	}
+}
+
+// A player leaving a started match puts the one left back to waiting with a
+// fresh game, and a new joiner plays against it
+func TestMatchLeaveReseats(t *testing.T) {
+	lb := newMatchLoopBench()
+	lb.match.queue = &matchQueue{byID: make(map[string]*openMatch)}
+	for lb.dispatcher.messages[OpCodeScoreUpdate] == 0 {
+		lb.step()
+	}
+
+	assigns := lb.dispatcher.messages[OpCodePlayerAssign]
+	states := lb.dispatcher.messages[OpCodeGameState]
+	if lb.match.MatchLeave(lb.ctx, lb.logger, nil, nil, &lb.dispatcher, lb.tick, lb.state, []runtime.Presence{lb.inputs[0].testPresence}) == nil {
+		t.Fatal("match ended with a player still in it")
+	}
+	s := lb.state
+	if s.Started || s.PlayerCount != 1 || s.Game.Scores != [2]int{} || s.Seats[0] != "" || s.Seats[1] != "b" {
+		t.Fatalf("not back to waiting: started %v, %d players, scores %v, seats %q", s.Started, s.PlayerCount, s.Game.Scores, s.Seats)
+	}
+	if lb.dispatcher.messages[OpCodePlayerAssign] != assigns+1 || lb.dispatcher.messages[OpCodeGameState] != states+1 {
+		t.Fatal("the player left was not told its seat and the new game")
+	}
+	if lb.match.queue.byID[s.ID] == nil {
+		t.Fatal("match not offered for pairing")
+	}
+
+	joiner := &testPresence{userID: "c"}
+	lb.match.MatchJoin(lb.ctx, lb.logger, nil, nil, &lb.dispatcher, lb.tick, s, []runtime.Presence{joiner})
+	lb.inputs[0].testPresence = joiner
+	lb.step()
+	if !s.Started || s.Seats[0] != "c" {
+		t.Fatalf("joiner did not start a new game: started %v, seats %q", s.Started, s.Seats)
+	}
+
+	lb.match.MatchLeave(lb.ctx, lb.logger, nil, nil, &lb.dispatcher, lb.tick, s, []runtime.Presence{joiner})
+	if lb.match.MatchLeave(lb.ctx, lb.logger, nil, nil, &lb.dispatcher, lb.tick, s, []runtime.Presence{lb.inputs[1].testPresence}) != nil {
+		t.Fatal("empty match did not end")
+	}
+}
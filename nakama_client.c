@@ -5,13 +5,25 @@
 #include <SDL3_net/SDL_net.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "json.c"
+#include "websocket.c"
+#include "interpolation.c"
 
 // Nakama server configuration
 #define NAKAMA_HOST "127.0.0.1"
-#define NAKAMA_HTTP_PORT 7350
+#ifndef NAKAMA_HTTP_PORT
+#define NAKAMA_HTTP_PORT 7350   // http_bench.c points it at its stub server
+#endif
 #define NAKAMA_WS_PORT 7350
 #define NAKAMA_SERVER_KEY "defaultkey"
 
+#define HTTP_BUFFER_SIZE 8192   // receive buffer; also the largest response head
+#define HTTP_TIMEOUT_MS 5000
+
+#define NAKAMA_QUEUE_SIZE 8         // requests in flight or awaiting their event
+
 // Op codes (must match server)
 typedef enum {
     OP_PADDLE_UPDATE = 1,
@@ -21,15 +33,66 @@ typedef enum {
     OP_GAME_START = 5,
     OP_SCORE_UPDATE = 6,
     OP_GAME_OVER = 7,
+    OP_PLAYER_ASSIGN = 8,
 } OpCode;
 
-// Match state from server
+// Match state from server. The match handler runs the simulation; scores
+// and the winner arrive as events, the rest with every state.
 typedef struct {
+    Uint32 tick;
     float ball_x, ball_y, ball_vx, ball_vy;
     float paddle1_y, paddle2_y;
     int score1, score2;
+    int winner;             // 0 until OP_GAME_OVER
 } ServerGameState;
 
+// Incremental HTTP/1.1 response parser. Bytes are fed in as they arrive and
+// the parser consumes exactly the bytes of one response, so whatever
+// follows stays in the connection buffer. The body is never stored: it goes
+// straight into a JSON parser, so its size does not matter.
+typedef enum {
+    HTTP_PARSE_HEAD,
+    HTTP_PARSE_BODY,            // Content-Length bytes, or up to close
+    HTTP_PARSE_CHUNK_SIZE,
+    HTTP_PARSE_CHUNK_DATA,
+    HTTP_PARSE_CHUNK_END,       // CRLF after a chunk
+    HTTP_PARSE_TRAILERS,
+    HTTP_PARSE_DONE
+} HttpParseState;
+
+typedef struct {
+    HttpParseState state;
+    int status;
+    bool keep_alive;        // connection can carry the next request
+    long long remaining;    // body or chunk bytes left, -1 = until close
+
+    JsonParser *json;       // receives the body, may be NULL
+    long long body_len;
+} HttpResponse;
+
+// Requests run on the HTTP worker thread so the render loop never waits on
+// the network. Each one is posted back to the main loop as an SDL event of
+// NakamaClient.event_type once its response (or failure) is in.
+typedef enum {
+    NAKAMA_REQUEST_NONE,
+    NAKAMA_REQUEST_AUTHENTICATE,
+    NAKAMA_REQUEST_FIND_MATCH
+} NakamaRequestType;
+
+typedef struct {
+    NakamaRequestType type;
+    char path[256];
+    char body[256];
+
+    // Filled in by the worker
+    bool ok;                    // a complete HTTP response arrived
+    bool parsed;                // and its body was valid JSON
+    char token[512];            // authenticate
+    char payload[512];          // RPC result, JSON inside a JSON string
+    char match_id[128];         // find_match: top level or inside payload
+    char ticket[128];
+} NakamaRequest;
+
 // Nakama client state
 typedef struct {
     // Connection state
@@ -45,102 +108,268 @@ typedef struct {
     char match_id[128];
     char matchmaker_ticket[128];
 
-    // Player number (1 or 2)
+    // Player number (1 or 2), 0 until OP_PLAYER_ASSIGN
     int player_num;
 
-    // Network
-    NET_StreamSocket *http_socket;
+    // Request ring. Slots from done_pos to run_pos are finished and wait
+    // for the main loop, slots from run_pos to queue_pos wait for the worker.
+    SDL_Thread *worker;
+    SDL_Mutex *lock;
+    SDL_Condition *wake;
+    bool quitting;
+    Uint32 event_type;
+    NakamaRequest requests[NAKAMA_QUEUE_SIZE];
+    Uint32 queue_pos;   // main thread
+    Uint32 run_pos;     // worker, read under lock
+    Uint32 done_pos;    // main thread
+
+    // Realtime socket for match join and match data (main thread only)
+    WebSocket realtime;
+    bool join_sent;
+    bool joined;            // the match accepted us
+    int sent_buttons;       // last input bits sent, -1 = none yet
+
+    // Network (worker thread only once it runs)
+    NET_StreamSocket *http_socket;  // kept alive between requests
     NET_Address *server_addr;
+    char http_in[HTTP_BUFFER_SIZE]; // received, not yet parsed
+    int http_in_len;
+
+    // HTTP stats
+    Uint32 http_requests;
+    Uint32 http_connects;
+    Uint64 http_ns_total;
+    Uint64 http_ns_max;
 
     // Game state from server
     ServerGameState server_state;
     bool state_updated;
+    Interpolator interp;    // every state, for drawing the ball and the opponent
 
     // Status message for UI
     char status_message[256];
 } NakamaClient;
 
-// Simple base64 encoding for auth
-static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
+// Base64 of a C string, for the Basic auth header
 static void base64_encode(const char *input, char *output) {
-    int len = strlen(input);
-    int i = 0, j = 0;
-    unsigned char arr3[3], arr4[4];
-
-    while (len--) {
-        arr3[i++] = *(input++);
-        if (i == 3) {
-            arr4[0] = (arr3[0] & 0xfc) >> 2;
-            arr4[1] = ((arr3[0] & 0x03) << 4) + ((arr3[1] & 0xf0) >> 4);
-            arr4[2] = ((arr3[1] & 0x0f) << 2) + ((arr3[2] & 0xc0) >> 6);
-            arr4[3] = arr3[2] & 0x3f;
-            for (i = 0; i < 4; i++) output[j++] = base64_chars[arr4[i]];
-            i = 0;
-        }
-    }
-    if (i) {
-        for (int k = i; k < 3; k++) arr3[k] = '\0';
-        arr4[0] = (arr3[0] & 0xfc) >> 2;
-        arr4[1] = ((arr3[0] & 0x03) << 4) + ((arr3[1] & 0xf0) >> 4);
-        arr4[2] = ((arr3[1] & 0x0f) << 2) + ((arr3[2] & 0xc0) >> 6);
-        for (int k = 0; k < i + 1; k++) output[j++] = base64_chars[arr4[k]];
-        while (i++ < 3) output[j++] = '=';
-    }
-    output[j] = '\0';
+    base64_encode_bytes(input, (int)strlen(input), output);
 }
 
-bool nakama_init(NakamaClient *client) {
-    memset(client, 0, sizeof(NakamaClient));
+// --- HTTP/1.1 ---------------------------------------------------------------
 
-    if (!NET_Init()) {
-        SDL_Log("Failed to init SDL_net: %s", SDL_GetError());
-        return false;
+// json (if any) is reset to parse the new body with the fields it was set up with
+static void http_response_init(HttpResponse *res, JsonParser *json) {
+    memset(res, 0, sizeof(HttpResponse));
+    res->json = json;
+    if (json) json_init(json, json->fields, json->field_count);
+}
+
+static const char *http_find(const char *data, int len, const char *needle) {
+    int n = (int)strlen(needle);
+    for (int i = 0; i + n <= len; i++) {
+        if (memcmp(data + i, needle, n) == 0) return data + i;
     }
+    return NULL;
+}
 
-    // Resolve server address
-    client->server_addr = NET_ResolveHostname(NAKAMA_HOST);
-    if (!client->server_addr) {
-        SDL_Log("Failed to resolve hostname: %s", SDL_GetError());
-        return false;
+static void http_append_body(HttpResponse *res, const char *data, int len) {
+    // JSON errors stick in the parser; the body is still consumed to the end
+    if (res->json) json_feed(res->json, data, len);
+    res->body_len += len;
+}
+
+// Parses the status line and headers (head_len bytes, without the blank
+// line) and picks how the body is framed. Returns false when malformed.
+static bool http_parse_head(HttpResponse *res, const char *head, int head_len) {
+    int minor = 0;
+    if (head_len < 12 || sscanf(head, "HTTP/1.%d %d", &minor, &res->status) != 2) return false;
+
+    // HTTP/1.1 connections persist unless the server says otherwise
+    res->keep_alive = minor >= 1;
+    bool chunked = false;
+    long long content_length = -1;
+
+    const char *line = memchr(head, '\n', head_len);
+    const char *end = head + head_len;
+    while (line && ++line < end) {
+        const char *next = memchr(line, '\n', end - line);
+        int line_len = (int)((next ? next : end) - line);
+        char value[128];
+
+        if (line_len > 15 && SDL_strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = strtoll(line + 15, NULL, 10);
+            if (content_length < 0) return false;
+        } else if (line_len > 18 && SDL_strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            snprintf(value, sizeof(value), "%.*s", line_len - 18, line + 18);
+            chunked = SDL_strcasestr(value, "chunked") != NULL;
+        } else if (line_len > 11 && SDL_strncasecmp(line, "Connection:", 11) == 0) {
+            snprintf(value, sizeof(value), "%.*s", line_len - 11, line + 11);
+            if (SDL_strcasestr(value, "close")) res->keep_alive = false;
+            if (SDL_strcasestr(value, "keep-alive")) res->keep_alive = true;
+        }
+        line = next;
     }
 
-    // Wait for resolution
-    while (NET_GetAddressStatus(client->server_addr) == 0) {
-        SDL_Delay(10);
+    if ((res->status >= 100 && res->status < 200) || res->status == 204 || res->status == 304) {
+        res->state = HTTP_PARSE_DONE;
+    } else if (chunked) {
+        res->state = HTTP_PARSE_CHUNK_SIZE;
+    } else if (content_length >= 0) {
+        res->remaining = content_length;
+        res->state = content_length > 0 ? HTTP_PARSE_BODY : HTTP_PARSE_DONE;
+    } else {
+        // No framing: the body runs until the server closes
+        res->remaining = -1;
+        res->keep_alive = false;
+        res->state = HTTP_PARSE_BODY;
     }
+    return true;
+}
 
-    if (NET_GetAddressStatus(client->server_addr) == -1) {
-        SDL_Log("Failed to resolve hostname");
-        return false;
+// Feeds received bytes to the parser. Returns how many it consumed (the rest
+// must be fed again with more data appended), or -1 if the response is malformed.
+static int http_response_feed(HttpResponse *res, const char *data, int len) {
+    int pos = 0;
+    while (pos < len && res->state != HTTP_PARSE_DONE) {
+        const char *rest = data + pos;
+        int avail = len - pos;
+
+        switch (res->state) {
+            case HTTP_PARSE_HEAD: {
+                const char *end = http_find(rest, avail, "\r\n\r\n");
+                if (!end) return pos;
+                if (!http_parse_head(res, rest, (int)(end - rest))) return -1;
+                pos += (int)(end - rest) + 4;
+                break;
+            }
+
+            case HTTP_PARSE_BODY:
+            case HTTP_PARSE_CHUNK_DATA: {
+                int n = avail;
+                if (res->remaining >= 0 && res->remaining < n) n = (int)res->remaining;
+                http_append_body(res, rest, n);
+                pos += n;
+                if (res->remaining > 0) res->remaining -= n;
+                if (res->remaining == 0) {
+                    res->state = res->state == HTTP_PARSE_BODY ? HTTP_PARSE_DONE : HTTP_PARSE_CHUNK_END;
+                }
+                break;
+            }
+
+            case HTTP_PARSE_CHUNK_SIZE: {
+                const char *end = http_find(rest, avail, "\r\n");
+                if (!end) return pos;
+                char *digits_end;
+                long long size = strtoll(rest, &digits_end, 16);    // stops at any ;extension
+                if (digits_end == rest || size < 0) return -1;
+                pos += (int)(end - rest) + 2;
+                res->remaining = size;
+                res->state = size > 0 ? HTTP_PARSE_CHUNK_DATA : HTTP_PARSE_TRAILERS;
+                break;
+            }
+
+            case HTTP_PARSE_CHUNK_END:
+                if (avail < 2) return pos;
+                if (rest[0] != '\r' || rest[1] != '\n') return -1;
+                pos += 2;
+                res->state = HTTP_PARSE_CHUNK_SIZE;
+                break;
+
+            case HTTP_PARSE_TRAILERS: {
+                const char *end = http_find(rest, avail, "\r\n");
+                if (!end) return pos;
+                if (end == rest) res->state = HTTP_PARSE_DONE;  // blank line ends the message
+                pos += (int)(end - rest) + 2;
+                break;
+            }
+
+            default:
+                return pos;
+        }
     }
+    return pos;
+}
 
-    snprintf(client->status_message, sizeof(client->status_message), "Initialized");
-    return true;
+static void http_disconnect(NakamaClient *client) {
+    if (client->http_socket) NET_DestroyStreamSocket(client->http_socket);
+    client->http_socket = NULL;
+    client->http_in_len = 0;
 }
 
-// Simple HTTP POST request
-static bool http_post(NakamaClient *client, const char *path, const char *body, char *response, int response_size) {
-    NET_StreamSocket *sock = NET_CreateClient(client->server_addr, NAKAMA_HTTP_PORT);
-    if (!sock) {
-        SDL_Log("Failed to connect: %s", SDL_GetError());
+static bool http_connect(NakamaClient *client) {
+    if (client->http_socket) return true;
+
+    // Resolution started in nakama_init; usually long done by now
+    if (NET_WaitUntilResolved(client->server_addr, HTTP_TIMEOUT_MS) != NET_SUCCESS) {
+        SDL_Log("Failed to resolve hostname");
         return false;
     }
 
-    // Wait for connection
-    int timeout = 5000;
-    while (NET_GetConnectionStatus(sock) == 0 && timeout > 0) {
-        SDL_Delay(10);
-        timeout -= 10;
+    client->http_socket = NET_CreateClient(client->server_addr, NAKAMA_HTTP_PORT);
+    if (!client->http_socket) {
+        SDL_Log("Failed to connect: %s", SDL_GetError());
+        return false;
     }
-
-    if (NET_GetConnectionStatus(sock) != 1) {
+    if (NET_WaitUntilConnected(client->http_socket, HTTP_TIMEOUT_MS) != NET_SUCCESS) {
         SDL_Log("Connection failed");
-        NET_DestroyStreamSocket(sock);
+        http_disconnect(client);
         return false;
     }
+    client->http_connects++;
+    return true;
+}
+
+// Reads one response off the connection, blocking until its last byte has
+// arrived. *received counts the bytes read from the socket.
+static bool http_read_response(NakamaClient *client, HttpResponse *res, int *received) {
+    Uint64 deadline = SDL_GetTicks() + HTTP_TIMEOUT_MS;
+    *received = 0;
+
+    for (;;) {
+        int used = http_response_feed(res, client->http_in, client->http_in_len);
+        if (used < 0) {
+            SDL_Log("Malformed HTTP response");
+            return false;
+        }
+        client->http_in_len -= used;
+        memmove(client->http_in, client->http_in + used, client->http_in_len);
+        if (res->state == HTTP_PARSE_DONE) return true;
+        if (client->http_in_len == HTTP_BUFFER_SIZE) {
+            SDL_Log("HTTP response head too large");
+            return false;
+        }
+
+        Uint64 now = SDL_GetTicks();
+        if (now >= deadline) {
+            SDL_Log("HTTP response timed out");
+            return false;
+        }
+        void *sock = client->http_socket;
+        if (NET_WaitUntilInputAvailable(&sock, 1, (Sint32)(deadline - now)) < 0) return false;
+
+        int n = NET_ReadFromStreamSocket(client->http_socket, client->http_in + client->http_in_len,
+                                         HTTP_BUFFER_SIZE - client->http_in_len);
+        if (n < 0) {
+            // Closed: only the end of an unframed body
+            if (res->state == HTTP_PARSE_BODY && res->remaining < 0) {
+                res->state = HTTP_PARSE_DONE;
+                return true;
+            }
+            return false;
+        }
+        client->http_in_len += n;
+        *received += n;
+    }
+}
+
+// HTTP POST over the persistent connection. The response body (without
+// headers) is fed to json as it arrives; any complete response counts as
+// success, whatever its status. A kept-alive connection the server has
+// closed in the meantime fails before any reply arrives; the request is
+// then sent once more on a fresh connection.
+static bool http_post(NakamaClient *client, const char *path, const char *body, JsonParser *json) {
+    Uint64 start = SDL_GetTicksNS();
 
-    // Build HTTP request
     char auth_plain[128];
     char auth_base64[256];
     snprintf(auth_plain, sizeof(auth_plain), "%s:", NAKAMA_SERVER_KEY);
@@ -154,133 +383,493 @@ static bool http_post(NakamaClient *client, const char *path, const char *body,
         "Authorization: Basic %s\r\n"
         "Content-Type: application/json\r\n"
         "Content-Length: %d\r\n"
-        "Connection: close\r\n"
         "\r\n"
         "%s",
         path, NAKAMA_HOST, NAKAMA_HTTP_PORT, auth_base64, body_len, body ? body : "");
-
-    // Send request
-    if (!NET_WriteToStreamSocket(sock, request, req_len)) {
-        SDL_Log("Failed to send request");
-        NET_DestroyStreamSocket(sock);
+    if (req_len >= (int)sizeof(request)) {
+        SDL_Log("HTTP request too large");
         return false;
     }
 
-    // Read response
-    SDL_Delay(100);  // Wait for response
-    int total_read = 0;
-    timeout = 3000;
+    HttpResponse res;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = client->http_socket != NULL;
+        if (!http_connect(client)) return false;
 
-    while (timeout > 0 && total_read < response_size - 1) {
-        int bytes = NET_ReadFromStreamSocket(sock, response + total_read, response_size - total_read - 1);
-        if (bytes > 0) {
-            total_read += bytes;
-        } else if (bytes == 0) {
-            SDL_Delay(10);
-            timeout -= 10;
-        } else {
+        http_response_init(&res, json);
+        int received = 0;
+        if (NET_WriteToStreamSocket(client->http_socket, request, req_len) &&
+            http_read_response(client, &res, &received)) {
             break;
         }
+
+        http_disconnect(client);
+        if (!reused || received > 0) return false;
+    }
+
+    if (!res.keep_alive) http_disconnect(client);
+    if (res.status < 200 || res.status >= 300) SDL_Log("HTTP %d from %s", res.status, path);
+
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+    client->http_requests++;
+    client->http_ns_total += elapsed;
+    if (elapsed > client->http_ns_max) client->http_ns_max = elapsed;
+    return true;
+}
+
+// --- Request queue -----------------------------------------------------------
+
+// Runs one request on the worker, pulling the fields either request type
+// needs out of the body while it streams in
+static void nakama_run_request(NakamaClient *client, NakamaRequest *request) {
+    JsonField fields[] = {
+        { .path = "token", .value = request->token, .value_size = sizeof(request->token) },
+        { .path = "payload", .value = request->payload, .value_size = sizeof(request->payload) },
+        { .path = "match_id", .value = request->match_id, .value_size = sizeof(request->match_id) },
+        { .path = "ticket", .value = request->ticket, .value_size = sizeof(request->ticket) },
+    };
+    JsonParser json;
+    json_init(&json, fields, SDL_arraysize(fields));
+
+    request->ok = http_post(client, request->path, request->body, &json);
+    request->parsed = request->ok && json_finish(&json) == JSON_DONE;
+
+    // RPCs answer {"payload":"<escaped JSON>"}; the ids are inside
+    if (request->parsed && fields[1].count > 0 && !fields[1].truncated) {
+        request->parsed = json_parse(&json, fields + 2, 2, request->payload, fields[1].value_len) == JSON_DONE;
+    }
+    for (int i = 0; i < (int)SDL_arraysize(fields); i++) {
+        if (fields[i].truncated) {
+            SDL_Log("Nakama response field %s too long", fields[i].path);
+            request->parsed = false;
+        }
     }
-    response[total_read] = '\0';
+}
+
+static int nakama_worker_main(void *data) {
+    NakamaClient *client = data;
+
+    SDL_LockMutex(client->lock);
+    for (;;) {
+        while (!client->quitting && client->run_pos == client->queue_pos) {
+            SDL_WaitCondition(client->wake, client->lock);
+        }
+        if (client->quitting) break;
+
+        // The main thread leaves queued slots alone until they are done
+        NakamaRequest *request = &client->requests[client->run_pos % NAKAMA_QUEUE_SIZE];
+        SDL_UnlockMutex(client->lock);
+
+        nakama_run_request(client, request);
 
-    NET_DestroyStreamSocket(sock);
-    return total_read > 0;
+        SDL_LockMutex(client->lock);
+        client->run_pos++;
+
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = client->event_type;
+        event.user.code = request->type;
+        SDL_PushEvent(&event);
+    }
+    SDL_UnlockMutex(client->lock);
+    return 0;
 }
 
-// Authenticate with device ID (anonymous)
-bool nakama_authenticate_device(NakamaClient *client, const char *device_id) {
-    snprintf(client->status_message, sizeof(client->status_message), "Authenticating...");
+// Starts resolving the server and the worker thread; nothing here waits on
+// the network. A host that fails to resolve shows up as a failed request.
+bool nakama_init(NakamaClient *client) {
+    memset(client, 0, sizeof(NakamaClient));
 
-    char path[256];
-    snprintf(path, sizeof(path), "/v2/account/authenticate/device?create=true");
+    if (!NET_Init()) {
+        SDL_Log("Failed to init SDL_net: %s", SDL_GetError());
+        return false;
+    }
 
+    client->server_addr = NET_ResolveHostname(NAKAMA_HOST);
+    if (!client->server_addr) {
+        SDL_Log("Failed to resolve hostname: %s", SDL_GetError());
+        return false;
+    }
+
+    client->event_type = SDL_RegisterEvents(1);
+    client->lock = SDL_CreateMutex();
+    client->wake = SDL_CreateCondition();
+    if (client->event_type == 0 || !client->lock || !client->wake) {
+        SDL_Log("Failed to set up Nakama request queue: %s", SDL_GetError());
+        return false;
+    }
+    client->worker = SDL_CreateThread(nakama_worker_main, "nakama_http", client);
+    if (!client->worker) {
+        SDL_Log("Failed to start Nakama worker: %s", SDL_GetError());
+        return false;
+    }
+
+    snprintf(client->status_message, sizeof(client->status_message), "Initialized");
+    return true;
+}
+
+// Hands a request to the worker. False when the queue is full.
+static bool nakama_submit(NakamaClient *client, NakamaRequestType type, const char *path, const char *body) {
+    if (!client->worker || client->queue_pos - client->done_pos == NAKAMA_QUEUE_SIZE) {
+        SDL_Log("Nakama request queue full");
+        return false;
+    }
+
+    NakamaRequest *request = &client->requests[client->queue_pos % NAKAMA_QUEUE_SIZE];
+    request->type = type;
+    snprintf(request->path, sizeof(request->path), "%s", path);
+    snprintf(request->body, sizeof(request->body), "%s", body);
+
+    SDL_LockMutex(client->lock);
+    client->queue_pos++;
+    SDL_SignalCondition(client->wake);
+    SDL_UnlockMutex(client->lock);
+    return true;
+}
+
+// True while any request is queued, running or waiting for its event
+bool nakama_busy(const NakamaClient *client) {
+    return client->done_pos != client->queue_pos;
+}
+
+// Queues anonymous authentication with a device ID
+bool nakama_authenticate_device(NakamaClient *client, const char *device_id) {
     char body[256];
     snprintf(body, sizeof(body), "{\"id\":\"%s\"}", device_id);
 
-    char response[4096];
-    if (!http_post(client, path, body, response, sizeof(response))) {
-        snprintf(client->status_message, sizeof(client->status_message), "Authentication failed - server unreachable");
+    if (!nakama_submit(client, NAKAMA_REQUEST_AUTHENTICATE, "/v2/account/authenticate/device?create=true", body)) {
         return false;
     }
+    snprintf(client->status_message, sizeof(client->status_message), "Authenticating...");
+    return true;
+}
 
-    // Parse token from response (simple string search)
-    char *token_start = strstr(response, "\"token\":\"");
-    if (token_start) {
-        token_start += 9;
-        char *token_end = strchr(token_start, '"');
-        if (token_end) {
-            int len = token_end - token_start;
-            if (len < (int)sizeof(client->session_token)) {
-                strncpy(client->session_token, token_start, len);
-                client->session_token[len] = '\0';
-                client->authenticated = true;
-                snprintf(client->status_message, sizeof(client->status_message), "Authenticated! Press SPACE to find match");
-                return true;
-            }
-        }
+static void nakama_finish_authenticate(NakamaClient *client, const NakamaRequest *request) {
+    if (!request->ok) {
+        snprintf(client->status_message, sizeof(client->status_message), "Authentication failed - server unreachable");
+        return;
+    }
+
+    if (request->parsed && request->token[0] != '\0') {
+        snprintf(client->session_token, sizeof(client->session_token), "%s", request->token);
+        client->authenticated = true;
+        snprintf(client->status_message, sizeof(client->status_message), "Authenticated! Press SPACE to find match");
+        return;
     }
 
     snprintf(client->status_message, sizeof(client->status_message), "Authentication failed - invalid response");
-    return false;
 }
 
-// Start matchmaking via RPC
+// Queues matchmaking via RPC
 bool nakama_find_match(NakamaClient *client) {
     if (!client->authenticated) {
         snprintf(client->status_message, sizeof(client->status_message), "Not authenticated");
         return false;
     }
 
-    snprintf(client->status_message, sizeof(client->status_message), "Finding match...");
-    client->in_matchmaking = true;
-
     // For now, we'll use a simple approach - try to join or create a match
     // In production, you'd use WebSockets for real-time matchmaking
 
-    char path[512];
+    char path[256];
     snprintf(path, sizeof(path), "/v2/rpc/find_match?http_key=%s", NAKAMA_SERVER_KEY);
+    if (!nakama_submit(client, NAKAMA_REQUEST_FIND_MATCH, path, "{}")) return false;
+
+    snprintf(client->status_message, sizeof(client->status_message), "Finding match...");
+    client->in_matchmaking = true;
+    return true;
+}
+
+static void nakama_finish_find_match(NakamaClient *client, const NakamaRequest *request) {
+    // Cancelled while the request was in flight
+    if (!client->in_matchmaking) return;
 
-    char response[4096];
-    if (!http_post(client, path, "{}", response, sizeof(response))) {
+    if (!request->ok) {
         snprintf(client->status_message, sizeof(client->status_message), "Matchmaking failed");
         client->in_matchmaking = false;
+        return;
+    }
+
+    if (!request->parsed) {
+        snprintf(client->status_message, sizeof(client->status_message), "Matchmaking failed - invalid response");
+        client->in_matchmaking = false;
+        return;
+    }
+
+    if (request->match_id[0] != '\0') {
+        snprintf(client->match_id, sizeof(client->match_id), "%s", request->match_id);
+        client->in_match = true;
+        snprintf(client->status_message, sizeof(client->status_message), "Match found! Connecting...");
+        return;
+    }
+    if (request->ticket[0] != '\0') {
+        snprintf(client->matchmaker_ticket, sizeof(client->matchmaker_ticket), "%s", request->ticket);
+    }
+
+    snprintf(client->status_message, sizeof(client->status_message), "Waiting for opponent...");
+}
+
+// Applies the oldest finished request to the client state when event is a
+// Nakama completion. Returns which request finished, NAKAMA_REQUEST_NONE for
+// any other event. Main thread only.
+NakamaRequestType nakama_handle_event(NakamaClient *client, const SDL_Event *event) {
+    if (!client->worker || event->type != client->event_type) return NAKAMA_REQUEST_NONE;
+
+    SDL_LockMutex(client->lock);
+    bool finished = client->done_pos != client->run_pos;
+    SDL_UnlockMutex(client->lock);
+    if (!finished) return NAKAMA_REQUEST_NONE;
+
+    const NakamaRequest *request = &client->requests[client->done_pos % NAKAMA_QUEUE_SIZE];
+    NakamaRequestType type = request->type;
+    switch (type) {
+        case NAKAMA_REQUEST_AUTHENTICATE: nakama_finish_authenticate(client, request); break;
+        case NAKAMA_REQUEST_FIND_MATCH: nakama_finish_find_match(client, request); break;
+        default: break;
+    }
+    client->done_pos++;
+    return type;
+}
+
+// --- Realtime match ------------------------------------------------------------
+//
+// Match traffic uses Nakama's realtime socket with JSON envelopes
+// (format=json): match_join once, then match_data_send / match_data whose
+// payloads are base64 in the envelope. It is polled from the main loop like
+// the UDP client, so each input change is one WebSocket frame with no
+// round trip.
+
+// Opens the realtime socket and joins match_id once it is up. Needs a session.
+bool nakama_join_match(NakamaClient *client) {
+    if (!client->authenticated || !client->in_match) return false;
+    if (NET_GetAddressStatus(client->server_addr) != NET_SUCCESS) return false;
+
+    char path[768];
+    snprintf(path, sizeof(path), "/ws?lang=en&status=false&format=json&token=%s", client->session_token);
+    client->join_sent = false;
+    client->joined = false;
+    client->player_num = 0;
+    SDL_zero(client->server_state);
+    client->state_updated = false;
+    interpolation_reset(&client->interp);
+    client->sent_buttons = -1;
+    if (!websocket_connect(&client->realtime, client->server_addr, NAKAMA_WS_PORT, NAKAMA_HOST, path)) {
+        snprintf(client->status_message, sizeof(client->status_message), "Realtime connection failed");
         return false;
     }
+    snprintf(client->status_message, sizeof(client->status_message), "Joining match...");
+    return true;
+}
 
-    // Parse match_id or ticket from response
-    char *match_start = strstr(response, "\"match_id\":\"");
-    if (match_start) {
-        match_start += 12;
-        char *match_end = strchr(match_start, '"');
-        if (match_end) {
-            int len = match_end - match_start;
-            strncpy(client->match_id, match_start, len);
-            client->match_id[len] = '\0';
-            client->in_match = true;
-            snprintf(client->status_message, sizeof(client->status_message), "Match found! Connecting...");
-            return true;
-        }
+// Match data is fixed-layout big-endian binary (see main.go in the Nakama
+// module):
+//   OP_PADDLE_UPDATE    u8 input bits (INPUT_UP | INPUT_DOWN), sent on change
+//   OP_GAME_STATE       u32 physics steps since the start, serve pauses
+//                       included (the state's time in GAME_TICK_NS),
+//                       f32 ball x, y, vx, vy, f32 paddle 1 y, paddle 2 y
+//   OP_SCORE_UPDATE     u8 score 1, score 2
+//   OP_GAME_OVER        u8 winning player number
+//   OP_PLAYER_ASSIGN    u8 our player number, sent to us when we join and
+//                       again when the opponent leaves and we wait for
+//                       another (the match starts over)
+#define NAKAMA_PADDLE_UPDATE_SIZE 1
+#define NAKAMA_GAME_STATE_SIZE 28
+#define NAKAMA_SCORE_UPDATE_SIZE 2
+#define NAKAMA_GAME_OVER_SIZE 1
+#define NAKAMA_PLAYER_ASSIGN_SIZE 1
+
+static Uint32 nakama_read_u32(const Uint8 *p) {
+    return ((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) | ((Uint32)p[2] << 8) | p[3];
+}
+
+static float nakama_read_f32(const Uint8 *p) {
+    Uint32 bits = nakama_read_u32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static bool nakama_decode_game_state(ServerGameState *state, const Uint8 *data, int len) {
+    if (len != NAKAMA_GAME_STATE_SIZE) return false;
+    state->tick = nakama_read_u32(data);
+    state->ball_x = nakama_read_f32(data + 4);
+    state->ball_y = nakama_read_f32(data + 8);
+    state->ball_vx = nakama_read_f32(data + 12);
+    state->ball_vy = nakama_read_f32(data + 16);
+    state->paddle1_y = nakama_read_f32(data + 20);
+    state->paddle2_y = nakama_read_f32(data + 24);
+    return true;
+}
+
+// The match state as the simulation's GameState
+void nakama_game_state(GameState *out, const ServerGameState *match) {
+    memset(out, 0, sizeof(GameState));
+    out->players[0].y = match->paddle1_y;
+    out->players[1].y = match->paddle2_y;
+    out->ball.x = match->ball_x;
+    out->ball.y = match->ball_y;
+    out->ball.vx = match->ball_vx;
+    out->ball.vy = match->ball_vy;
+    out->scores[0] = match->score1;
+    out->scores[1] = match->score2;
+}
+
+static void nakama_handle_match_data(NakamaClient *client, const JsonField *op_code, const JsonField *data) {
+    double op;
+    if (!json_field_number(op_code, &op) || data->truncated) return;
+
+    Uint8 payload[1024];
+    int len = base64_decode(data->value, data->value_len, payload, sizeof(payload));
+    if (len < 0) {
+        SDL_Log("Bad match data payload");
+        return;
     }
 
-    char *ticket_start = strstr(response, "\"ticket\":\"");
-    if (ticket_start) {
-        ticket_start += 10;
-        char *ticket_end = strchr(ticket_start, '"');
-        if (ticket_end) {
-            int len = ticket_end - ticket_start;
-            strncpy(client->matchmaker_ticket, ticket_start, len);
-            client->matchmaker_ticket[len] = '\0';
-            snprintf(client->status_message, sizeof(client->status_message), "Waiting for opponent...");
-            return true;
+    ServerGameState *state = &client->server_state;
+    switch ((int)op) {
+        case OP_GAME_STATE:
+            if (nakama_decode_game_state(state, payload, len)) {
+                GameState game_state;
+                nakama_game_state(&game_state, state);
+                interpolation_push(&client->interp, (uint16_t)state->tick, &game_state, SDL_GetTicksNS());
+                client->state_updated = true;
+            }
+            break;
+        case OP_SCORE_UPDATE:
+            if (len != NAKAMA_SCORE_UPDATE_SIZE) break;
+            state->score1 = payload[0];
+            state->score2 = payload[1];
+            break;
+        case OP_GAME_OVER:
+            if (len != NAKAMA_GAME_OVER_SIZE) break;
+            state->winner = payload[0];
+            snprintf(client->status_message, sizeof(client->status_message), "Player %d Wins!", state->winner);
+            break;
+        case OP_PLAYER_ASSIGN:
+            if (len != NAKAMA_PLAYER_ASSIGN_SIZE || (payload[0] != 1 && payload[0] != 2)) break;
+            client->player_num = payload[0];
+            state->winner = 0;
+            snprintf(client->status_message, sizeof(client->status_message),
+                     "Joined as player %d, waiting for opponent...", client->player_num);
+            break;
+    }
+}
+
+static bool nakama_realtime_lost(NakamaClient *client) {
+    snprintf(client->status_message, sizeof(client->status_message), "Connection to match lost");
+    client->joined = false;
+    return false;
+}
+
+// Drives the realtime socket and applies what arrived. False once it is
+// closed or the join was rejected; status_message says why.
+bool nakama_update(NakamaClient *client) {
+    WebSocket *ws = &client->realtime;
+    if (!websocket_update(ws)) return nakama_realtime_lost(client);
+    if (ws->state != WS_OPEN) return true;
+
+    if (!client->join_sent) {
+        char join[256];
+        int len = snprintf(join, sizeof(join), "{\"cid\":\"1\",\"match_join\":{\"match_id\":\"%s\"}}", client->match_id);
+        if (!websocket_send_text(ws, join, len)) return nakama_realtime_lost(client);
+        client->join_sent = true;
+    }
+
+    // Envelope fields, pulled out in one pass per message
+    char op_code[16];
+    char data[1400];            // base64 of up to 1 KB
+    char error[128];
+    JsonField fields[] = {
+        { .path = "match_data" },
+        { .path = "match_data.op_code", .value = op_code, .value_size = sizeof(op_code) },
+        { .path = "match_data.data", .value = data, .value_size = sizeof(data) },
+        { .path = "match" },
+        { .path = "error.message", .value = error, .value_size = sizeof(error) },
+    };
+    JsonParser parser;
+
+    WebSocketMessage message;
+    while (websocket_receive(ws, &message)) {
+        if (json_parse(&parser, fields, SDL_arraysize(fields), (const char *)message.data, message.len) != JSON_DONE) {
+            SDL_Log("Bad realtime message");
+            continue;
+        }
+
+        if (fields[0].count) {
+            nakama_handle_match_data(client, &fields[1], &fields[2]);
+        } else if (fields[3].count) {
+            // The handler tells us our paddle with OP_PLAYER_ASSIGN; who is
+            // already in the match does not say which seat is free
+            client->joined = true;
+            if (client->player_num == 0) {
+                snprintf(client->status_message, sizeof(client->status_message), "Joined, waiting for opponent...");
+            }
+        } else if (fields[4].count) {
+            SDL_Log("Nakama realtime error: %s", error);
+            snprintf(client->status_message, sizeof(client->status_message), "Match error: %s", error);
+            websocket_close(ws, WS_CLOSE_NORMAL);
+            client->joined = false;
+            return false;
         }
     }
+    return ws->state == WS_OPEN || nakama_realtime_lost(client);
+}
 
-    snprintf(client->status_message, sizeof(client->status_message), "Waiting for opponent...");
+// Sends our input bits (OP_PADDLE_UPDATE) if they changed since the last
+// send. The match moves the paddle; it never takes a position from us.
+bool nakama_send_input(NakamaClient *client, Uint8 buttons) {
+    if (!client->joined || buttons == client->sent_buttons) return true;
+
+    Uint8 data[NAKAMA_PADDLE_UPDATE_SIZE] = { buttons };
+    char data_base64[8];
+    base64_encode_bytes(data, sizeof(data), data_base64);
+
+    char envelope[512];
+    int len = snprintf(envelope, sizeof(envelope),
+                       "{\"match_data_send\":{\"match_id\":\"%s\",\"op_code\":%d,\"data\":\"%s\"}}",
+                       client->match_id, OP_PADDLE_UPDATE, data_base64);
+    if (!websocket_send_text(&client->realtime, envelope, len)) return false;
+    client->sent_buttons = buttons;
     return true;
 }
 
+// Leaves the match and closes the realtime socket
+void nakama_leave_match(NakamaClient *client) {
+    WebSocket *ws = &client->realtime;
+    if (client->joined) {
+        char leave[256];
+        int len = snprintf(leave, sizeof(leave), "{\"match_leave\":{\"match_id\":\"%s\"}}", client->match_id);
+        websocket_send_text(ws, leave, len);
+    }
+    if (ws->state != WS_CLOSED) {
+        websocket_log_stats(ws);
+        websocket_close(ws, WS_CLOSE_NORMAL);
+    }
+    client->joined = false;
+    client->in_match = false;
+    client->in_matchmaking = false;
+}
+
+// Stops the worker, waiting for a request already on the wire to finish;
+// queued ones are dropped
 void nakama_quit(NakamaClient *client) {
+    if (client->worker) {
+        SDL_LockMutex(client->lock);
+        client->quitting = true;
+        SDL_SignalCondition(client->wake);
+        SDL_UnlockMutex(client->lock);
+        SDL_WaitThread(client->worker, NULL);
+        client->worker = NULL;
+    }
+    nakama_leave_match(client);
+    if (client->wake) SDL_DestroyCondition(client->wake);
+    if (client->lock) SDL_DestroyMutex(client->lock);
+
+    if (client->http_requests > 0) {
+        SDL_Log("HTTP: %u requests over %u connections, avg %.2f ms, max %.2f ms",
+                client->http_requests, client->http_connects,
+                client->http_ns_total / 1e6 / client->http_requests, client->http_ns_max / 1e6);
+    }
+    http_disconnect(client);
     if (client->server_addr) {
         NET_UnrefAddress(client->server_addr);
     }
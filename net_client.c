@@ -0,0 +1,282 @@
+#ifndef NET_CLIENT_C
+#define NET_CLIENT_C
+
+// Client side of the dedicated UDP server protocol (see network.c)
+//
+// With --netsim (or PONG_NETSIM) this client's datagrams both ways pass
+// through an emulated link (see netsim.c). They are released once per
+// frame, so each is late by up to a frame on top of the emulated delay;
+// emulating on the server instead keeps to the millisecond.
+
+#include "network.c"
+#include "interpolation.c"
+#include "netsim.c"
+
+#include <SDL3/SDL.h>
+#include <SDL3_net/SDL_net.h>
+
+#define JOIN_RESEND_NS (500 * 1000000ULL)
+#define SERVER_SILENCE_NS (2000 * 1000000ULL)  // joined but nothing heard: join again
+#define NET_CLIENT_NETSIM_QUEUE 1024    // emulated datagrams in flight per direction
+
+typedef struct {
+    NET_DatagramSocket *socket;
+    NET_Address *server_addr;
+    Uint16 server_port;
+
+    bool joined;            // PKT_WELCOME received
+    bool rejoining;         // joined before and the server went quiet
+    bool reseated;          // welcomed to another seat: restart prediction from its states
+    bool playing;           // states received since the last welcome
+    int player;             // 0 = left paddle, 1 = right paddle
+    int match;
+    Uint64 last_heard_ns;
+
+    uint16_t seq;           // last sequence number we sent
+    uint16_t remote_seq;    // newest sequence number from the server (our ack)
+    Uint64 last_join_ns;
+    SnapshotRing received;  // baselines for PKT_STATE_DELTA
+
+    // Latest authoritative state
+    GameState state;
+    uint16_t input_tick;    // newest of our input ticks applied in `state`
+    bool state_updated;
+
+    // Every state as it arrives, for drawing remote entities
+    Interpolator interp;
+
+    // Link emulation, NULL when off
+    NetSim *sim_out;
+    NetSim *sim_in;
+} NetClient;
+
+// `netsim` emulates a bad link under this connection; NULL for none
+bool net_client_connect(NetClient *client, const char *host, Uint16 port, const NetSimConfig *netsim) {
+    memset(client, 0, sizeof(NetClient));
+    client->server_port = port;
+    interpolation_reset(&client->interp);
+
+    if (netsim) {
+        client->sim_out = netsim_create(netsim, NETSIM_OUTBOUND, NET_CLIENT_NETSIM_QUEUE);
+        client->sim_in = netsim_create(netsim, NETSIM_INBOUND, NET_CLIENT_NETSIM_QUEUE);
+        if (!client->sim_out || !client->sim_in) {
+            SDL_Log("Failed to allocate the link emulator");
+            netsim_destroy(client->sim_out);
+            netsim_destroy(client->sim_in);
+            client->sim_out = client->sim_in = NULL;
+            return false;
+        }
+        char description[256];
+        netsim_describe(netsim, description, sizeof(description));
+        SDL_Log("Emulating the link to the server: %s", description);
+    }
+
+    // Resolution finishes in the background; net_client_update waits for it
+    client->server_addr = NET_ResolveHostname(host);
+    if (!client->server_addr) {
+        SDL_Log("Failed to resolve %s: %s", host, SDL_GetError());
+        netsim_destroy(client->sim_out);
+        netsim_destroy(client->sim_in);
+        client->sim_out = client->sim_in = NULL;
+        return false;
+    }
+
+    client->socket = NET_CreateDatagramSocket(NULL, 0);
+    if (!client->socket) {
+        SDL_Log("Failed to create UDP socket: %s", SDL_GetError());
+        NET_UnrefAddress(client->server_addr);
+        client->server_addr = NULL;
+        netsim_destroy(client->sim_out);
+        netsim_destroy(client->sim_in);
+        client->sim_out = client->sim_in = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// Sends what the emulated link has delivered to the server by now
+static void net_client_flush(NetClient *client) {
+    Uint64 now = SDL_GetTicksNS();
+    const NetSimPacket *packet;
+    while ((packet = netsim_pop(client->sim_out, now))) {
+        NET_SendDatagram(client->socket, client->server_addr, client->server_port, packet->data, packet->len);
+    }
+}
+
+static void net_client_send(NetClient *client, const uint8_t *buf, int len) {
+    if (len <= 0) return;
+    if (client->sim_out) {
+        netsim_push(client->sim_out, SDL_GetTicksNS(), NULL, 0, buf, len);
+        net_client_flush(client);
+        return;
+    }
+    NET_SendDatagram(client->socket, client->server_addr, client->server_port, buf, len);
+}
+
+static void net_client_handle_packet(NetClient *client, const uint8_t *data, int len) {
+    PacketReader reader;
+    PacketHeader header;
+    if (!packet_decode_header(&reader, data, len, &header)) return;
+
+    // Drop stale or duplicated packets. A server that dropped us numbers
+    // the welcome of the new seat from the start again.
+    bool fresh = client->rejoining && header.type == PKT_WELCOME;
+    if (client->remote_seq != 0 && !sequence_greater(header.seq, client->remote_seq) && !fresh) return;
+
+    // Only packets we could use are acked, so the server never picks a
+    // baseline we do not have
+    bool accepted = false;
+
+    switch (header.type) {
+        case PKT_WELCOME: {
+            WelcomePacket welcome;
+            if (packet_decode_welcome(&reader, &welcome)) {
+                // A welcome after states is a new seat; repeats of the
+                // first one are older than any state and dropped above
+                bool moved = client->joined ? client->playing || welcome.match != client->match ||
+                                              welcome.player != client->player
+                                            : client->rejoining;
+                if (!client->joined || moved) {
+                    SDL_Log("Joined match %d as player %d", welcome.match, welcome.player + 1);
+                }
+                if (moved) {
+                    // The opponent left, or we were dropped: states of the
+                    // old seat no longer apply
+                    interpolation_reset(&client->interp);
+                    client->state_updated = false;
+                    client->reseated = true;
+                }
+                client->joined = true;
+                client->rejoining = false;
+                client->playing = false;
+                client->player = welcome.player;
+                client->match = welcome.match;
+                accepted = true;
+            }
+            break;
+        }
+
+        case PKT_STATE: {
+            uint16_t input_tick;
+            Snapshot snap;
+            if (packet_decode_input_ack(&reader, &input_tick) && packet_decode_snapshot(&reader, &snap)) {
+                snapshot_ring_put(&client->received, header.seq, &snap);
+                snapshot_to_state(&client->state, &snap);
+                client->input_tick = input_tick;
+                client->state_updated = true;
+                client->playing = true;
+                interpolation_push(&client->interp, header.seq, &client->state, SDL_GetTicksNS());
+                accepted = true;
+            }
+            break;
+        }
+
+        case PKT_STATE_DELTA: {
+            // A missing baseline means we cannot decode this one; the server
+            // sends a full snapshot once our acks stop matching its history
+            uint16_t input_tick, baseline_seq;
+            const Snapshot *baseline;
+            Snapshot snap;
+            if (packet_decode_input_ack(&reader, &input_tick) &&
+                packet_decode_delta_baseline(&reader, &baseline_seq) &&
+                (baseline = snapshot_ring_get(&client->received, baseline_seq)) &&
+                packet_decode_delta(&reader, baseline, &snap)) {
+                snapshot_ring_put(&client->received, header.seq, &snap);
+                snapshot_to_state(&client->state, &snap);
+                client->input_tick = input_tick;
+                client->state_updated = true;
+                client->playing = true;
+                interpolation_push(&client->interp, header.seq, &client->state, SDL_GetTicksNS());
+                accepted = true;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    if (accepted) {
+        client->remote_seq = header.seq;
+        client->last_heard_ns = SDL_GetTicksNS();
+    }
+}
+
+// Resends JOIN until welcomed and drains incoming datagrams. Call once per frame.
+void net_client_update(NetClient *client) {
+    if (!client->socket || NET_GetAddressStatus(client->server_addr) != 1) return;
+
+    // States stop when the server dropped us, and none come while we wait
+    // for an opponent; joining again gets a new seat or repeats the welcome
+    Uint64 now = SDL_GetTicksNS();
+    if (client->joined && now - client->last_heard_ns > SERVER_SILENCE_NS) {
+        client->joined = false;
+        client->rejoining = true;
+        client->last_join_ns = 0;
+    }
+
+    if (!client->joined) {
+        if (client->last_join_ns == 0 || now - client->last_join_ns > JOIN_RESEND_NS) {
+            uint8_t buf[MAX_PACKET_SIZE];
+            net_client_send(client, buf, packet_encode_join(buf, sizeof(buf), ++client->seq, client->remote_seq));
+            client->last_join_ns = now;
+        }
+    }
+
+    if (client->sim_out) net_client_flush(client);
+
+    NET_Datagram *dgram = NULL;
+    while (NET_ReceiveDatagram(client->socket, &dgram) && dgram) {
+        if (client->sim_in) {
+            netsim_push(client->sim_in, SDL_GetTicksNS(), NULL, 0, dgram->buf, dgram->buflen);
+        } else {
+            net_client_handle_packet(client, dgram->buf, dgram->buflen);
+        }
+        NET_DestroyDatagram(dgram);
+        dgram = NULL;
+    }
+
+    if (client->sim_in) {
+        now = SDL_GetTicksNS();
+        const NetSimPacket *packet;
+        while ((packet = netsim_pop(client->sim_in, now))) {
+            net_client_handle_packet(client, packet->data, packet->len);
+        }
+    }
+}
+
+// Sends the input for `tick` along with the ticks before it, newest first,
+// and the state the last interpolation_sample() showed
+void net_client_send_input(NetClient *client, uint16_t tick, const uint8_t *buttons, int count) {
+    if (!client->joined || count <= 0) return;
+
+    InputPacket input = { .tick = tick, .count = (uint8_t)(count < INPUT_REDUNDANCY ? count : INPUT_REDUNDANCY) };
+    memcpy(input.buttons, buttons, input.count);
+    interpolation_view(&client->interp, &input.view_seq, &input.view_frac);
+    uint8_t buf[MAX_PACKET_SIZE];
+    net_client_send(client, buf, packet_encode_input(buf, sizeof(buf), ++client->seq, client->remote_seq, &input));
+}
+
+static void net_client_log_netsim(const char *direction, const NetSim *sim) {
+    const NetSimStats *stats = &sim->stats;
+    double packets = stats->packets ? (double)stats->packets : 1.0;
+    SDL_Log("Link emulation %s: %llu packets, %.1f%% lost, %.1f%% duplicated, %.1f%% reordered, delay avg %.1f ms",
+            direction, (unsigned long long)stats->packets, 100.0 * stats->dropped / packets,
+            100.0 * stats->duplicated / packets, 100.0 * stats->reordered / packets,
+            stats->delivered ? stats->delay_ns / 1e6 / stats->delivered : 0.0);
+}
+
+void net_client_close(NetClient *client) {
+    if (client->sim_out) {
+        net_client_log_netsim("to server", client->sim_out);
+        net_client_log_netsim("from server", client->sim_in);
+        netsim_destroy(client->sim_out);
+        netsim_destroy(client->sim_in);
+    }
+    if (client->socket) NET_DestroyDatagramSocket(client->socket);
+    if (client->server_addr) NET_UnrefAddress(client->server_addr);
+    memset(client, 0, sizeof(NetClient));
+}
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef NETSIM_C
+#define NETSIM_C
+
+// Link emulator for testing on one machine. It sits under a process's UDP
+// send and receive paths and delays, drops, duplicates and reorders
+// datagrams the way a real link would, so prediction, interpolation and
+// bandwidth can be measured against bad networks without leaving
+// localhost.
+//
+// A datagram pushed into a NetSim is scheduled for `latency` plus a jitter
+// draw, or dropped, or scheduled twice. Delays are drawn independently, so
+// with jitter later datagrams can overtake earlier ones; `reorder` holds a
+// fraction of them back a further reorder_ms on top. The caller pops them
+// once they are due and hands them to the real socket (outgoing) or to its
+// packet handler (incoming).
+//
+// What happens to a datagram is drawn from a hash of the seed, its bytes
+// and its peer rather than from a running generator, so with the same seed
+// the same datagram meets the same fate whatever order the threads send in
+// and however the timing of a run differs.
+//
+// Each process emulates its own side: both directions of every link it has.
+// On the server alone it shapes all clients' links; on a client alone just
+// that client's. Enabling it on both ends adds the conditions up.
+
+#include "network.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NETSIM_ENV "PONG_NETSIM"
+#define NETSIM_USAGE "latency=MS,jitter=MS,dist=uniform|normal,loss=PCT,dup=PCT,reorder=PCT,reorder-ms=MS,seed=N"
+#define NETSIM_PEER_SIZE 16         // bytes of peer address kept per datagram
+#define NETSIM_DEFAULT_REORDER_MS 20
+
+typedef enum {
+    NETSIM_UNIFORM,     // delay uniform in latency +- jitter
+    NETSIM_NORMAL       // delay normal around latency, jitter is the deviation
+} NetSimDistribution;
+
+typedef enum {
+    NETSIM_INBOUND,
+    NETSIM_OUTBOUND
+} NetSimDirection;
+
+typedef struct {
+    double latency_ms;      // one-way delay
+    double jitter_ms;
+    NetSimDistribution distribution;
+    double loss;            // fractions of datagrams, 0..1
+    double duplicate;
+    double reorder;
+    double reorder_ms;      // extra delay of a reordered datagram
+    uint32_t seed;
+} NetSimConfig;
+
+typedef struct {
+    uint64_t sent_ns;
+    uint64_t due_ns;
+    uint64_t order;         // push order, keeps equal delays in sequence
+    uint8_t peer[NETSIM_PEER_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    int len;
+} NetSimPacket;
+
+typedef struct {
+    uint64_t packets;       // pushed
+    uint64_t dropped;       // lost on the emulated link
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t overflowed;    // dropped because the queue was full
+    uint64_t delivered;
+    uint64_t delay_ns;      // total time the delivered ones spent in flight
+} NetSimStats;
+
+// Datagrams in flight: a fixed pool of slots and a binary min-heap of slot
+// indices by due time, allocated once in netsim_create
+typedef struct {
+    NetSimConfig config;
+    uint64_t stream;        // NetSimDirection, so both directions draw apart
+    NetSimPacket *slots;
+    int *heap;
+    int *free_slots;
+    int capacity;
+    int count;
+    int free_count;
+    uint64_t next_order;
+    NetSimStats stats;
+} NetSim;
+
+static void netsim_config_default(NetSimConfig *config) {
+    memset(config, 0, sizeof(NetSimConfig));
+    config->distribution = NETSIM_UNIFORM;
+    config->reorder_ms = NETSIM_DEFAULT_REORDER_MS;
+    config->seed = 1;
+}
+
+// Percentages and milliseconds; anything else fails the whole spec
+static bool netsim_parse_value(const char *text, double max, double *value) {
+    char *end;
+    double v = strtod(text, &end);
+    if (end == text || *end != '\0' || !(v >= 0.0) || v > max) return false;
+    *value = v;
+    return true;
+}
+
+// Parses a spec such as "latency=50,jitter=10,loss=2" (see NETSIM_USAGE).
+// Rates are percentages; keys left out keep a perfect link.
+bool netsim_parse(NetSimConfig *config, const char *spec) {
+    netsim_config_default(config);
+
+    char buf[256];
+    if (snprintf(buf, sizeof(buf), "%s", spec) >= (int)sizeof(buf)) return false;
+
+    char *key = buf;
+    while (*key) {
+        char *next = strchr(key, ',');
+        if (next) *next++ = '\0';
+        else next = key + strlen(key);
+
+        char *value = strchr(key, '=');
+        if (!value) return false;
+        *value++ = '\0';
+
+        double v = 0.0;
+        bool ok = true;
+        if (strcmp(key, "latency") == 0) {
+            ok = netsim_parse_value(value, 10000.0, &config->latency_ms);
+        } else if (strcmp(key, "jitter") == 0) {
+            ok = netsim_parse_value(value, 10000.0, &config->jitter_ms);
+        } else if (strcmp(key, "dist") == 0) {
+            if (strcmp(value, "uniform") == 0) config->distribution = NETSIM_UNIFORM;
+            else if (strcmp(value, "normal") == 0) config->distribution = NETSIM_NORMAL;
+            else ok = false;
+        } else if (strcmp(key, "loss") == 0) {
+            ok = netsim_parse_value(value, 100.0, &v);
+            config->loss = v / 100.0;
+        } else if (strcmp(key, "dup") == 0) {
+            ok = netsim_parse_value(value, 100.0, &v);
+            config->duplicate = v / 100.0;
+        } else if (strcmp(key, "reorder") == 0) {
+            ok = netsim_parse_value(value, 100.0, &v);
+            config->reorder = v / 100.0;
+        } else if (strcmp(key, "reorder-ms") == 0) {
+            ok = netsim_parse_value(value, 10000.0, &config->reorder_ms);
+        } else if (strcmp(key, "seed") == 0) {
+            ok = netsim_parse_value(value, 4294967295.0, &v);
+            config->seed = (uint32_t)v;
+        } else {
+            ok = false;
+        }
+        if (!ok) return false;
+        key = next;
+    }
+    return true;
+}
+
+// One line for startup logs, e.g. "50 ms +- 10 ms uniform, 2% loss, seed 1"
+void netsim_describe(const NetSimConfig *config, char *buf, size_t size) {
+    snprintf(buf, size, "%.0f ms +- %.0f ms %s, %.1f%% loss, %.1f%% dup, %.1f%% reorder (+%.0f ms), seed %u",
+             config->latency_ms, config->jitter_ms,
+             config->distribution == NETSIM_NORMAL ? "normal" : "uniform",
+             config->loss * 100.0, config->duplicate * 100.0, config->reorder * 100.0,
+             config->reorder_ms, config->seed);
+}
+
+NetSim *netsim_create(const NetSimConfig *config, NetSimDirection direction, int capacity) {
+    NetSim *sim = calloc(1, sizeof(NetSim));
+    if (!sim) return NULL;
+    sim->config = *config;
+    sim->stream = (uint64_t)direction;
+    sim->capacity = capacity;
+    sim->slots = malloc(sizeof(NetSimPacket) * (size_t)capacity);
+    sim->heap = malloc(sizeof(int) * (size_t)capacity);
+    sim->free_slots = malloc(sizeof(int) * (size_t)capacity);
+    if (!sim->slots || !sim->heap || !sim->free_slots) {
+        free(sim->slots);
+        free(sim->heap);
+        free(sim->free_slots);
+        free(sim);
+        return NULL;
+    }
+    for (int i = 0; i < capacity; i++) sim->free_slots[i] = capacity - 1 - i;
+    sim->free_count = capacity;
+    return sim;
+}
+
+void netsim_destroy(NetSim *sim) {
+    if (!sim) return;
+    free(sim->slots);
+    free(sim->heap);
+    free(sim->free_slots);
+    free(sim);
+}
+
+// splitmix64: the finalizer turns the datagram hash into a stream of draws
+static uint64_t netsim_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Uniform in [0, 1)
+static double netsim_uniform(uint64_t *state) {
+    *state += 0x9e3779b97f4a7c15ULL;
+    return (double)(netsim_mix(*state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t netsim_delay_ns(const NetSimConfig *config, uint64_t *state) {
+    double spread;
+    if (config->distribution == NETSIM_NORMAL) {
+        // Sum of 12 uniforms (Irwin-Hall): mean 6, deviation 1
+        spread = -6.0;
+        for (int i = 0; i < 12; i++) spread += netsim_uniform(state);
+    } else {
+        spread = netsim_uniform(state) * 2.0 - 1.0;
+    }
+    double ms = config->latency_ms + config->jitter_ms * spread;
+    return ms > 0.0 ? (uint64_t)(ms * 1e6) : 0;
+}
+
+static bool netsim_before(const NetSim *sim, int a, int b) {
+    const NetSimPacket *pa = &sim->slots[a];
+    const NetSimPacket *pb = &sim->slots[b];
+    return pa->due_ns < pb->due_ns || (pa->due_ns == pb->due_ns && pa->order < pb->order);
+}
+
+static void netsim_schedule(NetSim *sim, uint64_t sent_ns, uint64_t due_ns, const void *peer, int peer_len,
+                            const uint8_t *data, int len) {
+    if (sim->free_count == 0) {
+        sim->stats.overflowed++;
+        return;
+    }
+    int slot = sim->free_slots[--sim->free_count];
+    NetSimPacket *packet = &sim->slots[slot];
+    packet->sent_ns = sent_ns;
+    packet->due_ns = due_ns;
+    packet->order = sim->next_order++;
+    memset(packet->peer, 0, sizeof(packet->peer));
+    if (peer) memcpy(packet->peer, peer, (size_t)peer_len);
+    memcpy(packet->data, data, (size_t)len);
+    packet->len = len;
+
+    int i = sim->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!netsim_before(sim, slot, sim->heap[parent])) break;
+        sim->heap[i] = sim->heap[parent];
+        i = parent;
+    }
+    sim->heap[i] = slot;
+}
+
+// Sends a datagram into the emulated link at now_ns. `peer` (up to
+// NETSIM_PEER_SIZE bytes, may be NULL) is the address it goes to or came
+// from, handed back with it by netsim_pop.
+void netsim_push(NetSim *sim, uint64_t now_ns, const void *peer, int peer_len, const uint8_t *data, int len) {
+    if (len <= 0 || len > MAX_PACKET_SIZE) return;
+    if (peer_len > NETSIM_PEER_SIZE) peer_len = NETSIM_PEER_SIZE;
+    sim->stats.packets++;
+
+    // FNV-1a over the peer and the bytes
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; peer && i < peer_len; i++) hash = (hash ^ ((const uint8_t *)peer)[i]) * 0x100000001b3ULL;
+    for (int i = 0; i < len; i++) hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    uint64_t state = netsim_mix(hash ^ ((uint64_t)sim->config.seed << 32 | sim->stream));
+
+    const NetSimConfig *config = &sim->config;
+    if (netsim_uniform(&state) < config->loss) {
+        sim->stats.dropped++;
+        return;
+    }
+    uint64_t delay = netsim_delay_ns(config, &state);
+    if (netsim_uniform(&state) < config->reorder) {
+        delay += (uint64_t)(config->reorder_ms * 1e6);
+        sim->stats.reordered++;
+    }
+    netsim_schedule(sim, now_ns, now_ns + delay, peer, peer_len, data, len);
+
+    if (netsim_uniform(&state) < config->duplicate) {
+        sim->stats.duplicated++;
+        netsim_schedule(sim, now_ns, now_ns + netsim_delay_ns(config, &state), peer, peer_len, data, len);
+    }
+}
+
+// Due time of the next datagram, UINT64_MAX when none is in flight
+uint64_t netsim_next_due(const NetSim *sim) {
+    return sim->count ? sim->slots[sim->heap[0]].due_ns : UINT64_MAX;
+}
+
+// Takes the next datagram due by now_ns, in due order, or NULL. The packet
+// stays valid until the next push into this NetSim.
+const NetSimPacket *netsim_pop(NetSim *sim, uint64_t now_ns) {
+    if (sim->count == 0) return NULL;
+    int top = sim->heap[0];
+    const NetSimPacket *packet = &sim->slots[top];
+    if (packet->due_ns > now_ns) return NULL;
+
+    int last = sim->heap[--sim->count];
+    int i = 0;
+    for (;;) {
+        int child = i * 2 + 1;
+        if (child >= sim->count) break;
+        if (child + 1 < sim->count && netsim_before(sim, sim->heap[child + 1], sim->heap[child])) child++;
+        if (!netsim_before(sim, sim->heap[child], last)) break;
+        sim->heap[i] = sim->heap[child];
+        i = child;
+    }
+    if (sim->count > 0) sim->heap[i] = last;
+    sim->free_slots[sim->free_count++] = top;
+
+    sim->stats.delivered++;
+    sim->stats.delay_ns += now_ns - packet->sent_ns;
+    return packet;
+}
+
+#endif
@@ -1,20 +1,456 @@
 #ifndef NETWORK_C
 #define NETWORK_C
 
+// Wire format shared by client and server. Every packet is a fixed layout of
+// big-endian fields written byte by byte, so it does not depend on struct
+// padding or host endianness:
+//
+//   header   u8 version, u8 type, u16 seq, u16 ack              (6 bytes)
+//   JOIN     -
+//   WELCOME  u8 player, u16 match                                (3 bytes)
+//   INPUT    u16 tick, u8 count, u8 buttons x count,
+//            u16 view seq, u8 view frac                        (7+ bytes)
+//   STATE    u16 input tick; ball x,y,vx,vy; paddle y,vy x2;
+//            u8 score x2                                       (20 bytes)
+//   DELTA    u16 input tick, u16 baseline seq, u16 field mask,
+//            changed fields                                    (6+ bytes)
+//
+// Positions are unsigned 10.6 fixed point and velocities signed 12.4, which
+// keeps a full snapshot at 18 bytes instead of 48 bytes of floats and ints.
+// `seq` counts packets from the sender; `ack` is the newest seq it has
+// received from the other side.
+//
+// PKT_STATE_DELTA carries only the snapshot fields that differ from an
+// earlier snapshot the client acked (the baseline). Both sides keep the last
+// SNAPSHOT_HISTORY snapshots by seq; the server falls back to a full
+// PKT_STATE when the client's ack is missing or too old.
+//
+// Inputs are stamped with the client's tick counter. Each PKT_INPUT repeats
+// the last few ticks (newest first) so a lost datagram does not lose input,
+// and every state packet echoes the newest input tick the server has applied
+// for that client, which is where client-side prediction replays from.
+//
+// The view fields say what the player was looking at when it sent the input:
+// the ball was drawn frac/256 of the way from the state with that seq to the
+// next one. The server uses it for lag compensation (lag_compensation.c).
+
+#include "game.c"
+
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define SERVER_PORT 7777
 #define SERVER_ADDR "127.0.0.1"
 
+#define PROTOCOL_VERSION 4
+
 // Packet types
 #define PKT_JOIN        1
 #define PKT_WELCOME     2
 #define PKT_INPUT       3
 #define PKT_STATE       4
+#define PKT_STATE_DELTA 5
+
+#define MAX_PACKET_SIZE 128
+
+#define PACKET_HEADER_SIZE 6
+#define STATE_PAYLOAD_SIZE 20
+
+#define INPUT_REDUNDANCY 4   // ticks of input repeated in every PKT_INPUT
+
+#define SNAPSHOT_HISTORY 32  // power of two
+
+#define POS_SCALE 64.0f     // 1/64 px, range 0..1023
+#define VEL_SCALE 16.0f     // 1/16 px/s, range +-2047
+
+// Snapshot of a match as seen on the wire
+typedef struct {
+    float y;
+    float vy;
+} PlayerState;
+
+typedef struct {
+    float x, y;
+    float vx, vy;
+} BallState;
+
+typedef struct {
+    PlayerState players[2];
+    BallState ball;
+    int scores[2];
+} GameState;
+
+// Quantized snapshot, one entry per wire field
+enum {
+    SNAP_BALL_X,
+    SNAP_BALL_Y,
+    SNAP_BALL_VX,
+    SNAP_BALL_VY,
+    SNAP_P1_Y,
+    SNAP_P1_VY,
+    SNAP_P2_Y,
+    SNAP_P2_VY,
+    SNAP_SCORE1,
+    SNAP_SCORE2,
+    SNAP_FIELD_COUNT
+};
+
+typedef struct {
+    uint16_t fields[SNAP_FIELD_COUNT];
+} Snapshot;
+
+// Recent snapshots by sequence number (baselines for delta packets)
+typedef struct {
+    Snapshot snapshots[SNAPSHOT_HISTORY];
+    uint16_t seqs[SNAPSHOT_HISTORY];
+    bool valid[SNAPSHOT_HISTORY];
+    uint16_t newest;
+} SnapshotRing;
+
+typedef struct {
+    uint8_t type;
+    uint16_t seq;
+    uint16_t ack;
+} PacketHeader;
+
+// Server->Client: match assignment
+typedef struct {
+    uint8_t player;     // 0 = left paddle, 1 = right paddle
+    uint16_t match;
+} WelcomePacket;
+
+// Client->Server: paddle buttons (INPUT_UP | INPUT_DOWN) for `tick` and the
+// count - 1 ticks before it, newest first, and the state on screen
+typedef struct {
+    uint16_t tick;
+    uint8_t count;
+    uint8_t buttons[INPUT_REDUNDANCY];
+    uint16_t view_seq;
+    uint8_t view_frac;
+} InputPacket;
+
+// --- Byte writer/reader ------------------------------------------------------
+
+typedef struct {
+    uint8_t *data;
+    int size;
+    int pos;
+    bool overflow;
+} PacketWriter;
+
+typedef struct {
+    const uint8_t *data;
+    int size;
+    int pos;
+    bool overflow;
+} PacketReader;
+
+static inline void write_u8(PacketWriter *w, uint8_t v) {
+    if (w->pos + 1 > w->size) { w->overflow = true; return; }
+    w->data[w->pos++] = v;
+}
+
+static inline void write_u16(PacketWriter *w, uint16_t v) {
+    if (w->pos + 2 > w->size) { w->overflow = true; return; }
+    w->data[w->pos++] = (uint8_t)(v >> 8);
+    w->data[w->pos++] = (uint8_t)v;
+}
+
+static inline uint8_t read_u8(PacketReader *r) {
+    if (r->pos + 1 > r->size) { r->overflow = true; return 0; }
+    return r->data[r->pos++];
+}
+
+static inline uint16_t read_u16(PacketReader *r) {
+    if (r->pos + 2 > r->size) { r->overflow = true; return 0; }
+    uint16_t v = (uint16_t)((r->data[r->pos] << 8) | r->data[r->pos + 1]);
+    r->pos += 2;
+    return v;
+}
+
+// --- Quantization ------------------------------------------------------------
+
+static inline uint16_t quantize_pos(float v) {
+    float q = v * POS_SCALE + 0.5f;
+    if (q < 0.0f) q = 0.0f;
+    if (q > 65535.0f) q = 65535.0f;
+    return (uint16_t)q;
+}
+
+static inline float dequantize_pos(uint16_t q) {
+    return q / POS_SCALE;
+}
+
+static inline uint16_t quantize_vel(float v) {
+    float q = v * VEL_SCALE;
+    q += (q < 0.0f) ? -0.5f : 0.5f;
+    if (q < -32768.0f) q = -32768.0f;
+    if (q > 32767.0f) q = 32767.0f;
+    return (uint16_t)(int16_t)q;
+}
+
+static inline float dequantize_vel(uint16_t q) {
+    return (int16_t)q / VEL_SCALE;
+}
+
+// True if sequence number a is newer than b, allowing for wrap-around
+static inline bool sequence_greater(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) > 0;
+}
+
+void snapshot_from_state(Snapshot *snap, const GameState *state) {
+    snap->fields[SNAP_BALL_X] = quantize_pos(state->ball.x);
+    snap->fields[SNAP_BALL_Y] = quantize_pos(state->ball.y);
+    snap->fields[SNAP_BALL_VX] = quantize_vel(state->ball.vx);
+    snap->fields[SNAP_BALL_VY] = quantize_vel(state->ball.vy);
+    snap->fields[SNAP_P1_Y] = quantize_pos(state->players[0].y);
+    snap->fields[SNAP_P1_VY] = quantize_vel(state->players[0].vy);
+    snap->fields[SNAP_P2_Y] = quantize_pos(state->players[1].y);
+    snap->fields[SNAP_P2_VY] = quantize_vel(state->players[1].vy);
+    snap->fields[SNAP_SCORE1] = (uint16_t)(state->scores[0] > 255 ? 255 : state->scores[0]);
+    snap->fields[SNAP_SCORE2] = (uint16_t)(state->scores[1] > 255 ? 255 : state->scores[1]);
+}
+
+void snapshot_to_state(GameState *state, const Snapshot *snap) {
+    state->ball.x = dequantize_pos(snap->fields[SNAP_BALL_X]);
+    state->ball.y = dequantize_pos(snap->fields[SNAP_BALL_Y]);
+    state->ball.vx = dequantize_vel(snap->fields[SNAP_BALL_VX]);
+    state->ball.vy = dequantize_vel(snap->fields[SNAP_BALL_VY]);
+    state->players[0].y = dequantize_pos(snap->fields[SNAP_P1_Y]);
+    state->players[0].vy = dequantize_vel(snap->fields[SNAP_P1_VY]);
+    state->players[1].y = dequantize_pos(snap->fields[SNAP_P2_Y]);
+    state->players[1].vy = dequantize_vel(snap->fields[SNAP_P2_VY]);
+    state->scores[0] = snap->fields[SNAP_SCORE1];
+    state->scores[1] = snap->fields[SNAP_SCORE2];
+}
+
+// --- Encode ------------------------------------------------------------------
+// Each encoder writes into buf and returns the packet length, or 0 if it did
+// not fit. Nothing here allocates.
+
+static void encode_header(PacketWriter *w, uint8_t type, uint16_t seq, uint16_t ack) {
+    write_u8(w, PROTOCOL_VERSION);
+    write_u8(w, type);
+    write_u16(w, seq);
+    write_u16(w, ack);
+}
+
+static int encode_finish(PacketWriter *w) {
+    return w->overflow ? 0 : w->pos;
+}
+
+int packet_encode_join(uint8_t *buf, int size, uint16_t seq, uint16_t ack) {
+    PacketWriter w = { buf, size, 0, false };
+    encode_header(&w, PKT_JOIN, seq, ack);
+    return encode_finish(&w);
+}
+
+int packet_encode_welcome(uint8_t *buf, int size, uint16_t seq, uint16_t ack, const WelcomePacket *welcome) {
+    PacketWriter w = { buf, size, 0, false };
+    encode_header(&w, PKT_WELCOME, seq, ack);
+    write_u8(&w, welcome->player);
+    write_u16(&w, welcome->match);
+    return encode_finish(&w);
+}
+
+int packet_encode_input(uint8_t *buf, int size, uint16_t seq, uint16_t ack, const InputPacket *input) {
+    PacketWriter w = { buf, size, 0, false };
+    encode_header(&w, PKT_INPUT, seq, ack);
+    // The decoder rejects a count past the buttons it can hold
+    uint8_t count = input->count < INPUT_REDUNDANCY ? input->count : INPUT_REDUNDANCY;
+    write_u16(&w, input->tick);
+    write_u8(&w, count);
+    for (int i = 0; i < count; i++) {
+        write_u8(&w, input->buttons[i]);
+    }
+    write_u16(&w, input->view_seq);
+    write_u8(&w, input->view_frac);
+    return encode_finish(&w);
+}
+
+static void encode_snapshot_field(PacketWriter *w, int field, uint16_t value) {
+    if (field >= SNAP_SCORE1) {
+        write_u8(w, (uint8_t)value);
+    } else {
+        write_u16(w, value);
+    }
+}
+
+int packet_encode_snapshot(uint8_t *buf, int size, uint16_t seq, uint16_t ack,
+                           uint16_t input_tick, const Snapshot *snap) {
+    PacketWriter w = { buf, size, 0, false };
+    encode_header(&w, PKT_STATE, seq, ack);
+    write_u16(&w, input_tick);
+    for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+        encode_snapshot_field(&w, f, snap->fields[f]);
+    }
+    return encode_finish(&w);
+}
+
+// Writes only the fields of snap that differ from baseline
+int packet_encode_delta(uint8_t *buf, int size, uint16_t seq, uint16_t ack, uint16_t input_tick,
+                        uint16_t baseline_seq, const Snapshot *baseline, const Snapshot *snap) {
+    PacketWriter w = { buf, size, 0, false };
+    encode_header(&w, PKT_STATE_DELTA, seq, ack);
+    write_u16(&w, input_tick);
+
+    uint16_t mask = 0;
+    for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+        if (snap->fields[f] != baseline->fields[f]) mask |= (uint16_t)(1u << f);
+    }
+    write_u16(&w, baseline_seq);
+    write_u16(&w, mask);
+    for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+        if (mask & (1u << f)) encode_snapshot_field(&w, f, snap->fields[f]);
+    }
+    return encode_finish(&w);
+}
+
+int packet_encode_state(uint8_t *buf, int size, uint16_t seq, uint16_t ack,
+                        uint16_t input_tick, const GameState *state) {
+    Snapshot snap;
+    snapshot_from_state(&snap, state);
+    return packet_encode_snapshot(buf, size, seq, ack, input_tick, &snap);
+}
+
+// --- Decode ------------------------------------------------------------------
+// packet_decode_header() checks the version and leaves the reader positioned
+// at the payload for the matching packet_decode_* call. The call that reads
+// the last field fails unless the packet ended exactly there, so truncated
+// packets and packets with trailing bytes are both rejected.
+
+static bool decode_finish(const PacketReader *r) {
+    return !r->overflow && r->pos == r->size;
+}
+
+bool packet_decode_header(PacketReader *r, const uint8_t *buf, int len, PacketHeader *header) {
+    *r = (PacketReader){ buf, len, 0, false };
+    if (len > MAX_PACKET_SIZE) return false;
+    if (read_u8(r) != PROTOCOL_VERSION) return false;
+    header->type = read_u8(r);
+    header->seq = read_u16(r);
+    header->ack = read_u16(r);
+    return !r->overflow;
+}
+
+bool packet_decode_welcome(PacketReader *r, WelcomePacket *welcome) {
+    welcome->player = read_u8(r);
+    welcome->match = read_u16(r);
+    return decode_finish(r) && welcome->player < 2;
+}
+
+bool packet_decode_input(PacketReader *r, InputPacket *input) {
+    input->tick = read_u16(r);
+    input->count = read_u8(r);
+    if (input->count == 0 || input->count > INPUT_REDUNDANCY) return false;
+    for (int i = 0; i < input->count; i++) {
+        input->buttons[i] = read_u8(r) & (INPUT_UP | INPUT_DOWN);
+    }
+    input->view_seq = read_u16(r);
+    input->view_frac = read_u8(r);
+    return decode_finish(r);
+}
+
+// Reads the input tick that starts every PKT_STATE and PKT_STATE_DELTA payload
+bool packet_decode_input_ack(PacketReader *r, uint16_t *input_tick) {
+    *input_tick = read_u16(r);
+    return !r->overflow;
+}
+
+static uint16_t decode_snapshot_field(PacketReader *r, int field) {
+    return field >= SNAP_SCORE1 ? read_u8(r) : read_u16(r);
+}
+
+bool packet_decode_snapshot(PacketReader *r, Snapshot *snap) {
+    for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+        snap->fields[f] = decode_snapshot_field(r, f);
+    }
+    return decode_finish(r);
+}
+
+// Reads the baseline seq of a PKT_STATE_DELTA; look it up, then call
+// packet_decode_delta with it
+bool packet_decode_delta_baseline(PacketReader *r, uint16_t *baseline_seq) {
+    *baseline_seq = read_u16(r);
+    return !r->overflow;
+}
+
+bool packet_decode_delta(PacketReader *r, const Snapshot *baseline, Snapshot *snap) {
+    uint16_t mask = read_u16(r);
+    for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+        snap->fields[f] = (mask & (1u << f)) ? decode_snapshot_field(r, f) : baseline->fields[f];
+    }
+    return decode_finish(r);
+}
+
+bool packet_decode_state(PacketReader *r, uint16_t *input_tick, GameState *state) {
+    Snapshot snap;
+    if (!packet_decode_input_ack(r, input_tick) || !packet_decode_snapshot(r, &snap)) return false;
+    snapshot_to_state(state, &snap);
+    return true;
+}
+
+// --- Snapshot history --------------------------------------------------------
+
+void snapshot_ring_put(SnapshotRing *ring, uint16_t seq, const Snapshot *snap) {
+    int i = seq & (SNAPSHOT_HISTORY - 1);
+    ring->snapshots[i] = *snap;
+    ring->seqs[i] = seq;
+    ring->valid[i] = true;
+    ring->newest = seq;
+}
+
+// Returns the snapshot stored for seq, or NULL if it is gone or too old
+const Snapshot *snapshot_ring_get(const SnapshotRing *ring, uint16_t seq) {
+    int i = seq & (SNAPSHOT_HISTORY - 1);
+    if (!ring->valid[i] || ring->seqs[i] != seq) return NULL;
+    if ((uint16_t)(ring->newest - seq) >= SNAPSHOT_HISTORY) return NULL;
+    return &ring->snapshots[i];
+}
+
+void snapshot_ring_clear(SnapshotRing *ring) {
+    for (int i = 0; i < SNAPSHOT_HISTORY; i++) ring->valid[i] = false;
+}
+
+// --- Game <-> wire snapshot ----------------------------------------------------
+
+void game_state_from_game(GameState *state, const Game *game) {
+    state->players[0].y = game->player1.y;
+    state->players[0].vy = game->player1.vy;
+    state->players[1].y = game->player2.y;
+    state->players[1].vy = game->player2.vy;
+    state->ball.x = game->ball.x;
+    state->ball.y = game->ball.y;
+    state->ball.vx = game->ball.vx;
+    state->ball.vy = game->ball.vy;
+    state->scores[0] = game->score1;
+    state->scores[1] = game->score2;
+}
 
-// TODO: Define packet structures
+void game_apply_state(Game *game, const GameState *state) {
+    game->player1.y = state->players[0].y;
+    game->player1.vy = state->players[0].vy;
+    game->player2.y = state->players[1].y;
+    game->player2.vy = state->players[1].vy;
+    game->ball.x = state->ball.x;
+    game->ball.y = state->ball.y;
+    game->ball.vx = state->ball.vx;
+    game->ball.vy = state->ball.vy;
+    game->score1 = state->scores[0];
+    game->score2 = state->scores[1];
+}
 
-// TODO: Implement client networking functions
+// Rounds the match to what a client will decode from the wire. The server
+// calls this after every step so a client that replays its inputs from a
+// received state computes exactly what the server did.
+void game_quantize(Game *game) {
+    GameState state;
+    Snapshot snap;
+    game_state_from_game(&state, game);
+    snapshot_from_state(&snap, &state);
+    snapshot_to_state(&state, &snap);
+    game_apply_state(game, &state);
+}
 
 #endif
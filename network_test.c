@@ -0,0 +1,260 @@
+// Round-trip tests for the wire format in network.c
+// Every packet type is encoded and decoded back, then cut short one byte at
+// a time and padded with trailing bytes; the decoders must reject all of
+// those. Each datagram is copied into a heap buffer of exactly its length,
+// so a decoder that reads past the end trips AddressSanitizer (the CMake
+// target builds with it).
+//
+//   network_test      exit status 0 when every check passes
+
+#include "network.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+typedef enum {
+    DECODE_WELCOME,
+    DECODE_INPUT,
+    DECODE_STATE,
+    DECODE_DELTA
+} DecodeKind;
+
+typedef struct {
+    PacketHeader header;
+    WelcomePacket welcome;
+    InputPacket input;
+    uint16_t input_tick;
+    uint16_t baseline_seq;
+    Snapshot snap;
+} Decoded;
+
+// Decodes len bytes of data from a buffer of exactly that size the way the
+// client and server do, against `baseline` for deltas
+static bool decode(DecodeKind kind, const uint8_t *data, int len, const Snapshot *baseline, Decoded *out) {
+    uint8_t *copy = malloc(len > 0 ? (size_t)len : 1);
+    memcpy(copy, data, (size_t)len);
+
+    PacketReader reader;
+    bool ok = packet_decode_header(&reader, copy, len, &out->header);
+    if (ok) {
+        switch (kind) {
+            case DECODE_WELCOME:
+                ok = packet_decode_welcome(&reader, &out->welcome);
+                break;
+            case DECODE_INPUT:
+                ok = packet_decode_input(&reader, &out->input);
+                break;
+            case DECODE_STATE:
+                ok = packet_decode_input_ack(&reader, &out->input_tick) && packet_decode_snapshot(&reader, &out->snap);
+                break;
+            case DECODE_DELTA:
+                ok = packet_decode_input_ack(&reader, &out->input_tick) &&
+                     packet_decode_delta_baseline(&reader, &out->baseline_seq) &&
+                     packet_decode_delta(&reader, baseline, &out->snap);
+                break;
+        }
+    }
+    free(copy);
+    return ok;
+}
+
+// Every proper prefix and every padded copy of a valid packet must fail
+static void check_malformed(DecodeKind kind, const uint8_t *packet, int len, const Snapshot *baseline) {
+    Decoded out;
+    for (int cut = 0; cut < len; cut++) {
+        if (decode(kind, packet, cut, baseline, &out)) {
+            fprintf(stderr, "type %d: accepted %d of %d bytes\n", kind, cut, len);
+            failures++;
+        }
+    }
+
+    uint8_t padded[MAX_PACKET_SIZE + 8];
+    memcpy(padded, packet, (size_t)len);
+    memset(padded + len, 0, sizeof(padded) - (size_t)len);
+    for (int extra = 1; len + extra <= (int)sizeof(padded); extra *= 2) {
+        if (decode(kind, padded, len + extra, baseline, &out)) {
+            fprintf(stderr, "type %d: accepted %d trailing bytes\n", kind, extra);
+            failures++;
+        }
+    }
+}
+
+// Encoding into a buffer one byte too small must fail without writing past it
+static void check_encode_overflow(int len, int (*encode)(uint8_t *buf, int size)) {
+    uint8_t buf[MAX_PACKET_SIZE + 1];
+    memset(buf, 0xAA, sizeof(buf));
+    CHECK(encode(buf, len - 1) == 0);
+    CHECK(buf[len - 1] == 0xAA);
+}
+
+static Snapshot test_snapshot(uint32_t *rng) {
+    Snapshot snap;
+    for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+        snap.fields[f] = (uint16_t)(f >= SNAP_SCORE1 ? game_rand(rng) % 256 : game_rand(rng));
+    }
+    return snap;
+}
+
+static const WelcomePacket test_welcome = { .player = 1, .match = 4095 };
+static const InputPacket test_input = {
+    .tick = 65535, .count = INPUT_REDUNDANCY, .buttons = { INPUT_UP, 0, INPUT_DOWN, INPUT_UP },
+    .view_seq = 12345, .view_frac = 200
+};
+
+static int encode_test_welcome(uint8_t *buf, int size) {
+    return packet_encode_welcome(buf, size, 7, 8, &test_welcome);
+}
+
+static int encode_test_input(uint8_t *buf, int size) {
+    return packet_encode_input(buf, size, 9, 10, &test_input);
+}
+
+static void test_welcome_round_trip(void) {
+    uint8_t buf[MAX_PACKET_SIZE];
+    int len = encode_test_welcome(buf, sizeof(buf));
+    CHECK(len == PACKET_HEADER_SIZE + 3);
+
+    Decoded out;
+    CHECK(decode(DECODE_WELCOME, buf, len, NULL, &out));
+    CHECK(out.header.type == PKT_WELCOME && out.header.seq == 7 && out.header.ack == 8);
+    CHECK(out.welcome.player == test_welcome.player && out.welcome.match == test_welcome.match);
+
+    check_malformed(DECODE_WELCOME, buf, len, NULL);
+    check_encode_overflow(len, encode_test_welcome);
+
+    // A version from another build is not ours to read
+    buf[0] = PROTOCOL_VERSION + 1;
+    CHECK(!decode(DECODE_WELCOME, buf, len, NULL, &out));
+}
+
+static void test_input_round_trip(void) {
+    uint8_t buf[MAX_PACKET_SIZE];
+    int len = encode_test_input(buf, sizeof(buf));
+    CHECK(len == PACKET_HEADER_SIZE + 6 + INPUT_REDUNDANCY);
+
+    Decoded out;
+    CHECK(decode(DECODE_INPUT, buf, len, NULL, &out));
+    CHECK(out.header.type == PKT_INPUT && out.header.seq == 9 && out.header.ack == 10);
+    CHECK(out.input.tick == test_input.tick && out.input.count == test_input.count);
+    CHECK(memcmp(out.input.buttons, test_input.buttons, INPUT_REDUNDANCY) == 0);
+    CHECK(out.input.view_seq == test_input.view_seq && out.input.view_frac == test_input.view_frac);
+
+    check_malformed(DECODE_INPUT, buf, len, NULL);
+    check_encode_overflow(len, encode_test_input);
+
+    // A count past INPUT_REDUNDANCY is sent as INPUT_REDUNDANCY
+    InputPacket over = test_input;
+    over.count = INPUT_REDUNDANCY + 3;
+    len = packet_encode_input(buf, sizeof(buf), 9, 10, &over);
+    CHECK(decode(DECODE_INPUT, buf, len, NULL, &out));
+    CHECK(out.input.count == INPUT_REDUNDANCY);
+    CHECK(memcmp(out.input.buttons, test_input.buttons, INPUT_REDUNDANCY) == 0);
+
+    // A count past INPUT_REDUNDANCY would read buttons that are not there
+    InputPacket bad = test_input;
+    bad.count = 1;
+    len = packet_encode_input(buf, sizeof(buf), 9, 10, &bad);
+    buf[PACKET_HEADER_SIZE + 2] = INPUT_REDUNDANCY + 1;
+    CHECK(!decode(DECODE_INPUT, buf, len, NULL, &out));
+}
+
+static void test_state_round_trip(void) {
+    uint32_t rng = 1;
+    for (int i = 0; i < 1000; i++) {
+        Snapshot snap = test_snapshot(&rng);
+        uint8_t buf[MAX_PACKET_SIZE];
+        int len = packet_encode_snapshot(buf, sizeof(buf), (uint16_t)i, 3, 0xBEEF, &snap);
+        CHECK(len == PACKET_HEADER_SIZE + STATE_PAYLOAD_SIZE);
+
+        Decoded out;
+        CHECK(decode(DECODE_STATE, buf, len, NULL, &out));
+        CHECK(out.header.type == PKT_STATE && out.header.seq == (uint16_t)i);
+        CHECK(out.input_tick == 0xBEEF);
+        CHECK(memcmp(&out.snap, &snap, sizeof(snap)) == 0);
+        if (i < 10) check_malformed(DECODE_STATE, buf, len, NULL);
+    }
+
+    // Floats survive to within half a quantization step
+    GameState state = {
+        .players = { { 250.5f, -400.0f }, { 33.25f, 400.0f } },
+        .ball = { 392.5f, 10.0f, -350.0f, 175.0f },
+        .scores = { 3, 4 }
+    };
+    uint8_t buf[MAX_PACKET_SIZE];
+    int len = packet_encode_state(buf, sizeof(buf), 1, 0, 0, &state);
+    PacketReader reader;
+    PacketHeader header;
+    GameState back;
+    uint16_t input_tick;
+    CHECK(packet_decode_header(&reader, buf, len, &header) && packet_decode_state(&reader, &input_tick, &back));
+    CHECK(back.ball.x == state.ball.x && back.ball.vx == state.ball.vx);
+    CHECK(back.players[0].y == state.players[0].y && back.players[1].y == state.players[1].y);
+    CHECK(back.scores[0] == 3 && back.scores[1] == 4);
+}
+
+static void test_delta_round_trip(void) {
+    uint32_t rng = 2;
+    for (int i = 0; i < 1000; i++) {
+        Snapshot baseline = test_snapshot(&rng);
+        Snapshot snap = baseline;
+
+        // Change a random subset of fields, from none to all of them
+        uint32_t changed = game_rand(&rng) & ((1u << SNAP_FIELD_COUNT) - 1);
+        for (int f = 0; f < SNAP_FIELD_COUNT; f++) {
+            if (changed & (1u << f)) snap.fields[f] ^= (uint16_t)(f >= SNAP_SCORE1 ? 0x01 : 0x8001);
+        }
+
+        uint8_t buf[MAX_PACKET_SIZE];
+        int len = packet_encode_delta(buf, sizeof(buf), 100, 99, 42, 90, &baseline, &snap);
+        CHECK(len > 0);
+
+        Decoded out;
+        CHECK(decode(DECODE_DELTA, buf, len, &baseline, &out));
+        CHECK(out.header.type == PKT_STATE_DELTA && out.input_tick == 42 && out.baseline_seq == 90);
+        CHECK(memcmp(&out.snap, &snap, sizeof(snap)) == 0);
+        if (i < 10) check_malformed(DECODE_DELTA, buf, len, &baseline);
+    }
+
+    // A mask naming fields the packet does not carry is truncated
+    Snapshot baseline = {0};
+    uint8_t buf[MAX_PACKET_SIZE];
+    int len = packet_encode_delta(buf, sizeof(buf), 1, 0, 0, 0, &baseline, &baseline);
+    CHECK(len == PACKET_HEADER_SIZE + 6);
+    buf[len - 2] = 0xFF;
+    buf[len - 1] = 0xFF;
+    Decoded out;
+    CHECK(!decode(DECODE_DELTA, buf, len, &baseline, &out));
+}
+
+static void test_oversize_datagram(void) {
+    uint8_t buf[MAX_PACKET_SIZE + 1] = { PROTOCOL_VERSION, PKT_JOIN };
+    PacketReader reader;
+    PacketHeader header;
+    CHECK(packet_decode_header(&reader, buf, PACKET_HEADER_SIZE, &header));
+    CHECK(!packet_decode_header(&reader, buf, (int)sizeof(buf), &header));
+}
+
+int main(void) {
+    test_welcome_round_trip();
+    test_input_round_trip();
+    test_state_round_trip();
+    test_delta_round_trip();
+    test_oversize_datagram();
+
+    if (failures) {
+        fprintf(stderr, "network_test: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("network_test: all checks passed\n");
+    return 0;
+}
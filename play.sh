@@ -13,13 +13,13 @@ echo "Server started (PID: $SERVER_PID)"
 sleep 0.5
 
 # Start two clients
-./client &
+./client --server 127.0.0.1 &
 CLIENT1_PID=$!
 echo "Client 1 started (PID: $CLIENT1_PID)"
 
 sleep 0.2
 
-./client &
+./client --server 127.0.0.1 &
 CLIENT2_PID=$!
 echo "Client 2 started (PID: $CLIENT2_PID)"
 
@@ -0,0 +1,114 @@
+#ifndef PREDICTION_C
+#define PREDICTION_C
+
+// Client-side prediction for the local paddle.
+//
+// Every tick the local buttons are recorded under a tick number and applied
+// to a predicted copy of the match straight away, so the paddle moves without
+// waiting a round trip. Each authoritative state says which of our input
+// ticks the server has applied (see network.c); the prediction restarts from
+// that state and replays the newer inputs through game_step(). Both sides
+// quantize the match to wire precision after every tick, so when the server
+// applied the same inputs the replay lands exactly where the prediction was
+// and no correction is counted.
+
+#include "game.c"
+#include "network.c"
+
+#include <math.h>
+#include <string.h>
+
+#define PREDICTION_HISTORY 128  // power of two, ticks of input kept for replay
+
+typedef struct {
+    Game game;              // predicted match
+    int player;             // 0 = left paddle, 1 = right paddle
+
+    uint8_t inputs[PREDICTION_HISTORY];     // local buttons by input tick
+    uint16_t tick;          // newest input tick recorded
+    uint16_t acked_tick;    // newest input tick the server has applied
+
+    // Reconciliation stats
+    uint32_t reconciles;        // authoritative states applied
+    uint32_t corrections;       // ...that moved the local paddle
+    float correction_total;     // sum of those moves in px
+    float correction_max;
+} Prediction;
+
+void prediction_init(Prediction *prediction, int player, const Game *game) {
+    memset(prediction, 0, sizeof(Prediction));
+    prediction->game = *game;
+    prediction->player = player;
+}
+
+static Paddle *prediction_local_paddle(Prediction *prediction) {
+    return prediction->player == 0 ? &prediction->game.player1 : &prediction->game.player2;
+}
+
+// The opponent's buttons are unknown until the server reports them; assume
+// they keep moving the way the last state showed
+static uint8_t buttons_from_velocity(const Paddle *paddle) {
+    if (paddle->vy < 0) return INPUT_UP;
+    if (paddle->vy > 0) return INPUT_DOWN;
+    return 0;
+}
+
+static void prediction_step(Prediction *prediction, uint8_t buttons) {
+    Game *game = &prediction->game;
+    if (game_is_over(game)) return;
+
+    if (prediction->player == 0) {
+        game_step(game, buttons, buttons_from_velocity(&game->player2));
+    } else {
+        game_step(game, buttons_from_velocity(&game->player1), buttons);
+    }
+    game_quantize(game);
+}
+
+// Records the local buttons for the next tick and applies them at once.
+// Returns the tick to stamp the input with.
+uint16_t prediction_add_input(Prediction *prediction, uint8_t buttons) {
+    uint16_t tick = ++prediction->tick;
+    prediction->inputs[tick & (PREDICTION_HISTORY - 1)] = buttons;
+    prediction_step(prediction, buttons);
+    return tick;
+}
+
+// Fills buttons with up to count inputs ending at the newest tick, newest
+// first (the redundant copies sent in every PKT_INPUT)
+int prediction_recent_inputs(const Prediction *prediction, uint8_t *buttons, int count) {
+    int n = 0;
+    while (n < count && (uint16_t)(prediction->tick - n) != prediction->acked_tick) {
+        buttons[n] = prediction->inputs[(uint16_t)(prediction->tick - n) & (PREDICTION_HISTORY - 1)];
+        n++;
+    }
+    return n;
+}
+
+// Rewinds to an authoritative state and replays every input the server has
+// not applied yet
+void prediction_reconcile(Prediction *prediction, const GameState *state, uint16_t input_tick) {
+    float predicted_y = prediction_local_paddle(prediction)->y;
+
+    game_apply_state(&prediction->game, state);
+    if (sequence_greater(input_tick, prediction->tick)) input_tick = prediction->tick;
+    prediction->acked_tick = input_tick;
+
+    // Inputs older than the history are gone; only happens after a long stall
+    uint16_t pending = (uint16_t)(prediction->tick - input_tick);
+    if (pending >= PREDICTION_HISTORY) pending = PREDICTION_HISTORY - 1;
+    for (uint16_t i = pending; i > 0; i--) {
+        uint16_t tick = (uint16_t)(prediction->tick - i + 1);
+        prediction_step(prediction, prediction->inputs[tick & (PREDICTION_HISTORY - 1)]);
+    }
+
+    float error = fabsf(prediction_local_paddle(prediction)->y - predicted_y);
+    prediction->reconciles++;
+    if (error > 0.0f) {
+        prediction->corrections++;
+        prediction->correction_total += error;
+        if (error > prediction->correction_max) prediction->correction_max = error;
+    }
+}
+
+#endif
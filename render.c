@@ -5,14 +5,118 @@
 #include <SDL3_image/SDL_image.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
+#include "text_cache.c"
+
+// Sprites packed into RenderAssets.atlas
+typedef enum {
+    SPRITE_PADDLE_BLUE,
+    SPRITE_PADDLE_RED,
+    SPRITE_BALL,
+    SPRITE_COUNT
+} Sprite;
+
+#define ATLAS_PADDING 2     // px between sprites, so filtering never samples a neighbour
+
+typedef struct {
+    Uint64 frames;
+    Uint64 draw_calls;
+    Uint64 frame_ns_total;  // CPU time spent building game frames, up to present
+    Uint64 frame_ns_max;
+} RenderStats;
+
 typedef struct {
     SDL_Texture *paddle_blue;
     SDL_Texture *paddle_red;
     SDL_Texture *ball;
     TTF_Font *font;
     TTF_TextEngine *text_engine;
+    TextCache text_cache;   // every label drawn with font
+
+    // Batched path: the static playfield is prerendered once and the
+    // paddles and ball go out in a single SDL_RenderGeometry call
+    bool batched;
+    SDL_Texture *playfield;     // background and center line
+    SDL_Texture *atlas;         // paddles and ball side by side
+    SDL_FRect atlas_rects[SPRITE_COUNT];
+
+    int draw_calls;             // issued for the current frame
+    RenderStats stats;
 } RenderAssets;
 
+static void render_clear_playfield(SDL_Renderer *renderer) {
+    SDL_SetRenderDrawColor(renderer, 20, 30, 50, 255);
+    SDL_RenderClear(renderer);
+}
+
+static void render_center_line(SDL_Renderer *renderer) {
+    SDL_SetRenderDrawColor(renderer, 100, 120, 150, 255);
+    for (int y = 0; y < WINDOW_HEIGHT; y += 20) {
+        SDL_FRect dash = {WINDOW_WIDTH / 2.0f - 2, (float)y, 4, 10};
+        SDL_RenderFillRect(renderer, &dash);
+    }
+}
+
+// Copies a sprite into the atlas as-is, or a flat rectangle when it failed to load
+static void render_atlas_sprite(SDL_Renderer *renderer, SDL_Texture *sprite, const SDL_FRect *rect,
+                                Uint8 r, Uint8 g, Uint8 b) {
+    if (!sprite) {
+        SDL_SetRenderDrawColor(renderer, r, g, b, 255);
+        SDL_RenderFillRect(renderer, rect);
+        return;
+    }
+    SDL_BlendMode mode = SDL_BLENDMODE_BLEND;
+    SDL_GetTextureBlendMode(sprite, &mode);
+    SDL_SetTextureBlendMode(sprite, SDL_BLENDMODE_NONE);
+    SDL_RenderTexture(renderer, sprite, NULL, rect);
+    SDL_SetTextureBlendMode(sprite, mode);
+}
+
+static void render_destroy_cache(RenderAssets *assets) {
+    if (assets->playfield) SDL_DestroyTexture(assets->playfield);
+    if (assets->atlas) SDL_DestroyTexture(assets->atlas);
+    assets->playfield = NULL;
+    assets->atlas = NULL;
+    assets->batched = false;
+}
+
+// Prerenders the playfield and the sprite atlas into target textures. Call
+// again after SDL_EVENT_RENDER_TARGETS_RESET, which loses their contents.
+// Without render target support the immediate path is used instead.
+bool render_build_cache(RenderAssets *assets, SDL_Renderer *renderer) {
+    render_destroy_cache(assets);
+
+    int atlas_w = 2 * (PADDLE_WIDTH + ATLAS_PADDING) + BALL_SIZE;
+    assets->atlas_rects[SPRITE_PADDLE_BLUE] = (SDL_FRect){0, 0, PADDLE_WIDTH, PADDLE_HEIGHT};
+    assets->atlas_rects[SPRITE_PADDLE_RED] = (SDL_FRect){PADDLE_WIDTH + ATLAS_PADDING, 0, PADDLE_WIDTH, PADDLE_HEIGHT};
+    assets->atlas_rects[SPRITE_BALL] = (SDL_FRect){2 * (PADDLE_WIDTH + ATLAS_PADDING), 0, BALL_SIZE, BALL_SIZE};
+
+    assets->playfield = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                          WINDOW_WIDTH, WINDOW_HEIGHT);
+    assets->atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                      atlas_w, PADDLE_HEIGHT);
+    if (!assets->playfield || !assets->atlas || !SDL_SetRenderTarget(renderer, assets->playfield)) {
+        SDL_Log("Render targets unavailable, drawing the playfield immediately: %s", SDL_GetError());
+        render_destroy_cache(assets);
+        return false;
+    }
+
+    render_clear_playfield(renderer);
+    render_center_line(renderer);
+    SDL_SetTextureBlendMode(assets->playfield, SDL_BLENDMODE_NONE);
+
+    SDL_SetRenderTarget(renderer, assets->atlas);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    render_atlas_sprite(renderer, assets->paddle_blue, &assets->atlas_rects[SPRITE_PADDLE_BLUE], 100, 150, 255);
+    render_atlas_sprite(renderer, assets->paddle_red, &assets->atlas_rects[SPRITE_PADDLE_RED], 255, 100, 100);
+    render_atlas_sprite(renderer, assets->ball, &assets->atlas_rects[SPRITE_BALL], 255, 220, 100);
+    SDL_SetTextureBlendMode(assets->atlas, SDL_BLENDMODE_BLEND);
+
+    SDL_SetRenderTarget(renderer, NULL);
+    assets->batched = true;
+    return true;
+}
+
 bool render_init(RenderAssets *assets, SDL_Renderer *renderer) {
     // SDL3_image doesn't need initialization
 
@@ -52,21 +156,62 @@ bool render_init(RenderAssets *assets, SDL_Renderer *renderer) {
 
     // Create text engine for renderer
     assets->text_engine = TTF_CreateRendererTextEngine(renderer);
+    text_cache_init(&assets->text_cache, assets->text_engine);
+
+    render_build_cache(assets, renderer);
 
     return true;
 }
 
-void render_game(SDL_Renderer *renderer, Game *game, RenderAssets *assets) {
-    // Clear screen (dark blue background)
-    SDL_SetRenderDrawColor(renderer, 20, 30, 50, 255);
-    SDL_RenderClear(renderer);
+// Appends a textured quad (two triangles) to a geometry batch
+static void render_push_quad(SDL_Vertex *vertices, int *indices, int quad, const SDL_FRect *dst,
+                             const SDL_FRect *src, float tex_w, float tex_h) {
+    SDL_Vertex *v = &vertices[quad * 4];
+    int *i = &indices[quad * 6];
+    float u0 = src->x / tex_w, v0 = src->y / tex_h;
+    float u1 = (src->x + src->w) / tex_w, v1 = (src->y + src->h) / tex_h;
+    SDL_FColor white = {1.0f, 1.0f, 1.0f, 1.0f};
 
-    // Draw center line (dashed)
-    SDL_SetRenderDrawColor(renderer, 100, 120, 150, 255);
-    for (int y = 0; y < WINDOW_HEIGHT; y += 20) {
-        SDL_FRect dash = {WINDOW_WIDTH / 2.0f - 2, (float)y, 4, 10};
-        SDL_RenderFillRect(renderer, &dash);
+    v[0] = (SDL_Vertex){{dst->x, dst->y}, white, {u0, v0}};
+    v[1] = (SDL_Vertex){{dst->x + dst->w, dst->y}, white, {u1, v0}};
+    v[2] = (SDL_Vertex){{dst->x + dst->w, dst->y + dst->h}, white, {u1, v1}};
+    v[3] = (SDL_Vertex){{dst->x, dst->y + dst->h}, white, {u0, v1}};
+
+    int base = quad * 4;
+    i[0] = base;
+    i[1] = base + 1;
+    i[2] = base + 2;
+    i[3] = base;
+    i[4] = base + 2;
+    i[5] = base + 3;
+}
+
+// Playfield texture plus one geometry batch for the paddles and ball
+static void render_game_batched(SDL_Renderer *renderer, Game *game, RenderAssets *assets) {
+    SDL_RenderTexture(renderer, assets->playfield, NULL, NULL);
+    assets->draw_calls++;
+
+    SDL_FRect sprites[SPRITE_COUNT] = {
+        [SPRITE_PADDLE_BLUE] = {game->player1.x, game->player1.y, game->player1.w, game->player1.h},
+        [SPRITE_PADDLE_RED] = {game->player2.x, game->player2.y, game->player2.w, game->player2.h},
+        [SPRITE_BALL] = {game->ball.x, game->ball.y, BALL_SIZE, BALL_SIZE},
+    };
+    SDL_Vertex vertices[SPRITE_COUNT * 4];
+    int indices[SPRITE_COUNT * 6];
+    float atlas_w = 2 * (PADDLE_WIDTH + ATLAS_PADDING) + BALL_SIZE;
+    for (int s = 0; s < SPRITE_COUNT; s++) {
+        render_push_quad(vertices, indices, s, &sprites[s], &assets->atlas_rects[s], atlas_w, PADDLE_HEIGHT);
     }
+    SDL_RenderGeometry(renderer, assets->atlas, vertices, SPRITE_COUNT * 4, indices, SPRITE_COUNT * 6);
+    assets->draw_calls++;
+}
+
+// One draw call per rectangle and sprite, for when render targets are unavailable
+static void render_game_immediate(SDL_Renderer *renderer, Game *game, RenderAssets *assets) {
+    // Clear screen (dark blue background) and draw the dashed center line
+    render_clear_playfield(renderer);
+    render_center_line(renderer);
+    assets->draw_calls += 1 + WINDOW_HEIGHT / 20;
 
     // Draw paddles
     SDL_FRect p1 = {game->player1.x, game->player1.y, game->player1.w, game->player1.h};
@@ -94,39 +239,61 @@ void render_game(SDL_Renderer *renderer, Game *game, RenderAssets *assets) {
         SDL_SetRenderDrawColor(renderer, 255, 220, 100, 255);
         SDL_RenderFillRect(renderer, &ball);
     }
+    assets->draw_calls += 3;
+}
+
+void render_game(SDL_Renderer *renderer, Game *game, RenderAssets *assets) {
+    Uint64 start = SDL_GetTicksNS();
+    assets->draw_calls = 0;
+
+    if (assets->batched) {
+        render_game_batched(renderer, game, assets);
+    } else {
+        render_game_immediate(renderer, game, assets);
+    }
 
-    // Draw scores
+    // Draw scores (cached, so a text is only laid out when a score changes)
     if (assets->font && assets->text_engine) {
         char score_text[16];
 
         // Player 1 score (left)
         snprintf(score_text, sizeof(score_text), "%d", game->score1);
-        TTF_Text *text1 = TTF_CreateText(assets->text_engine, assets->font, score_text, 0);
-        if (text1) {
-            int w, h;
-            TTF_GetTextSize(text1, &w, &h);
-            TTF_DrawRendererText(text1, WINDOW_WIDTH / 4.0f - w / 2.0f, 30);
-            TTF_DestroyText(text1);
-        }
+        text_cache_draw_centered(&assets->text_cache, assets->font, score_text, WINDOW_WIDTH / 4.0f, 30);
 
         // Player 2 score (right)
         snprintf(score_text, sizeof(score_text), "%d", game->score2);
-        TTF_Text *text2 = TTF_CreateText(assets->text_engine, assets->font, score_text, 0);
-        if (text2) {
-            int w, h;
-            TTF_GetTextSize(text2, &w, &h);
-            TTF_DrawRendererText(text2, 3 * WINDOW_WIDTH / 4.0f - w / 2.0f, 30);
-            TTF_DestroyText(text2);
-        }
+        text_cache_draw_centered(&assets->text_cache, assets->font, score_text, 3 * WINDOW_WIDTH / 4.0f, 30);
+        assets->draw_calls += 2;
     }
 
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+    RenderStats *stats = &assets->stats;
+    stats->frames++;
+    stats->draw_calls += (Uint64)assets->draw_calls;
+    stats->frame_ns_total += elapsed;
+    if (elapsed > stats->frame_ns_max) stats->frame_ns_max = elapsed;
+
     SDL_RenderPresent(renderer);
 }
 
+void render_log_stats(RenderAssets *assets) {
+    RenderStats *stats = &assets->stats;
+    if (stats->frames == 0) return;
+    SDL_Log("Render (%s): %llu game frames, %.1f draw calls/frame, build %.3f ms avg %.3f ms max",
+            assets->batched ? "batched" : "immediate", (unsigned long long)stats->frames,
+            (double)stats->draw_calls / stats->frames,
+            stats->frame_ns_total / 1e6 / stats->frames, stats->frame_ns_max / 1e6);
+    *stats = (RenderStats){0};
+}
+
 void render_quit(RenderAssets *assets) {
     if (assets->paddle_blue) SDL_DestroyTexture(assets->paddle_blue);
     if (assets->paddle_red) SDL_DestroyTexture(assets->paddle_red);
     if (assets->ball) SDL_DestroyTexture(assets->ball);
+    render_log_stats(assets);
+    render_destroy_cache(assets);
+    text_cache_log_stats(&assets->text_cache);
+    text_cache_clear(&assets->text_cache);
     if (assets->text_engine) TTF_DestroyRendererTextEngine(assets->text_engine);
     if (assets->font) TTF_CloseFont(assets->font);
     TTF_Quit();
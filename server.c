@@ -1,65 +1,1591 @@
 // UDP Pong Server
-// TODO: Implement UDP networking
+// Hosts many concurrent 1v1 matches in a single process. Every match lives
+// in a preallocated slot, so joins and leaves never allocate on the tick path.
+//
+// With --threads N the matches are sharded across N worker threads pinned to
+// cores. The main thread is the network thread: it owns the socket, the
+// client table and matchmaking, and hands each received input to a worker
+// through a lock-free single-producer/single-consumer queue. A tick runs in
+// two phases on the workers: each drains its input queue, then, after a
+// barrier, steps and broadcasts its shard. A worker that finishes early
+// steals chunks of matches from the others, so a match is only ever touched
+// by one thread at a time and physics needs no locks. Joins, leaves and
+// shard rebalancing happen on the main thread between ticks, while the
+// workers are parked.
+//
+// With --netsim (or PONG_NETSIM) every datagram in and out passes through
+// an emulated link (see netsim.c). Received ones wait in the network
+// thread's queue and sent ones in their outbox's; the network thread wakes
+// when the next one is due and, between ticks, delivers them all.
+
+#ifdef __linux__
+#define _GNU_SOURCE  // recvmmsg/sendmmsg
+#endif
+
+#include "game.c"
+#include "network.c"
+#include "lag_compensation.c"
+#include "netsim.c"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#else
+#include <poll.h>
+#endif
+
+#define TICK_RATE GAME_TICK_RATE
+#define TICK_NS GAME_TICK_NS
+
+#define MAX_MATCHES 4096
+#define MAX_CLIENTS (MAX_MATCHES * 2)
+#define CLIENT_HASH_SIZE 16384  // power of two, > MAX_CLIENTS
+#define CLIENT_TIMEOUT_TICKS (TICK_RATE * 5)
+#define STATS_INTERVAL_TICKS (TICK_RATE * 5)
 
-#define SERVER_PORT 7777
-#define TICK_RATE 60
+#define INPUT_BUFFER 16         // power of two, stamped input ticks held per client
+#define INPUT_MAX_QUEUE 6       // ticks of input backlog before the oldest are skipped
+#define DEFAULT_REWIND_MS 200   // lag compensation window, see lag_compensation.c
 
-// Shared game state definitions (same as client)
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 600
-#define PADDLE_WIDTH 15
-#define PADDLE_HEIGHT 100
-#define PADDLE_SPEED 400.0f
-#define BALL_SIZE 15
-#define BALL_SPEED 350.0f
+#define PACKET_BATCH 1024               // datagrams per recvmmsg/sendmmsg (UIO_MAXIOV)
+#define SOCKET_BUFFER_SIZE (4 << 20)    // room for one tick of traffic from every client
+
+#define MAX_WORKERS 16
+#define INPUT_QUEUE_SIZE 16384      // power of two, > two ticks of inputs from every client
+#define STEAL_CHUNK 32              // matches claimed at a time from a shard
+#define REBALANCE_INTERVAL_TICKS TICK_RATE
+
+#define NETSIM_QUEUE 65536          // emulated datagrams in flight per direction, ~130 ms of full load
+#define NETSIM_WELCOME_QUEUE 1024   // for the main thread's outbox
+
+typedef struct {
+    struct sockaddr_in addr;
+    int match;          // match slot, -1 when not in a match
+    int player;         // 0 = left paddle, 1 = right paddle
+    int hash_next;      // next client in the same address bucket
+    int next_free;
+    uint8_t buttons;        // buttons applied on the last tick
+    uint8_t inputs[INPUT_BUFFER];       // received buttons by input tick
+    uint16_t input_ticks[INPUT_BUFFER];
+    uint16_t input_tick;    // newest input tick applied, echoed in state packets
+    uint16_t input_newest;  // newest input tick received
+    bool has_input;
+    bool has_view;
+    uint8_t view_frac;      // view of the input applied on the last tick
+    uint16_t view_seq;
+    uint32_t tick_base;     // game tick minus seq of the last state sent; both
+                            // advance once per tick while the game runs
+    uint16_t seq;           // last sequence number sent to this client
+    uint16_t remote_seq;    // newest sequence number received (our ack)
+    uint16_t acked;         // newest of our sequence numbers the client has seen
+    bool has_acked;
+    SnapshotRing history;   // snapshots sent to this client, delta baselines
+    uint16_t input_views[INPUT_BUFFER];     // view seq sent with each input tick
+    uint8_t input_view_fracs[INPUT_BUFFER];
+    uint16_t seat_seq;      // our seq when seated; older views are of another match
+    // Owned by the network thread; everything above is the worker's once the
+    // client is in a running match
+    uint16_t recv_seq;      // newest sequence number received
+    uint32_t epoch;         // bumped on reuse, so queued inputs for a departed client are dropped
+    uint64_t last_heard;
+    bool active;
+} Client;
 
 typedef struct {
-    float y;
-    float vy;
-} PlayerState;
+    Game game;
+    int clients[2];     // client slot per paddle, -1 when empty
+    int worker;         // shard that steps this match, -1 when not running
+    int shard_pos;      // index into that worker's match list
+    int next_free;
+    bool in_use;
+} Match;
 
+// Preallocated datagram slots for one recvmmsg/sendmmsg call
 typedef struct {
-    float x, y;
-    float vx, vy;
-} BallState;
+    uint8_t data[PACKET_BATCH][MAX_PACKET_SIZE];
+    struct sockaddr_in addrs[PACKET_BATCH];
+    struct iovec iov[PACKET_BATCH];
+#ifdef __linux__
+    struct mmsghdr msgs[PACKET_BATCH];
+#endif
+    int count;
+} PacketBatch;
 
+// Outgoing datagrams and their counters, one per sending thread
 typedef struct {
-    PlayerState players[2];
-    BallState ball;
-    int scores[2];
-} GameState;
+    PacketBatch batch;
+    bool discard;           // --bench: count packets instead of sending them
+    NetSim *sim;            // --netsim: sent datagrams wait here until due
+    uint64_t packets_out;
+    uint64_t bytes_out;
+    uint64_t packets_dropped;
+    uint64_t syscalls;
+} Outbox;
+
+// Network thread -> worker: one PKT_INPUT with the seq/ack of its header
+typedef struct {
+    int client;
+    uint32_t epoch;
+    uint16_t seq;
+    uint16_t ack;
+    InputPacket input;
+} InputMessage;
+
+// Single-producer single-consumer ring. Only the network thread writes
+// head and only the worker writes tail; each sits on its own cache line.
+typedef struct {
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+    _Alignas(64) InputMessage slots[INPUT_QUEUE_SIZE];
+} InputQueue;
+
+typedef struct {
+    struct Server *server;
+    int id;
+    pthread_t thread;
+
+    InputQueue queue;               // inputs for clients with slot % worker_count == id
+    int matches[MAX_MATCHES];       // this worker's shard
+    int match_count;
+    _Alignas(64) atomic_int next;   // next unclaimed shard index this tick, shared with thieves
+    Outbox out;
+
+    // Written by the worker during a tick, read by the main thread between ticks
+    uint64_t busy_ns_total;
+    uint64_t busy_ns_max;
+    uint64_t ticks_missed;          // finished after the tick deadline
+    uint64_t matches_stepped;
+    uint64_t matches_stolen;        // stepped from another worker's shard
+} Worker;
+
+typedef struct Server {
+    int fd;
+    uint64_t tick;
+    uint32_t rng;               // seeds for new matches
+
+    // I/O
+    bool per_packet;            // baseline mode: one syscall per datagram
+    bool delta;                 // delta-compress snapshots against client acks
+    int rewind_ticks;           // lag compensation window, 0 = off
+    int epoll_fd;
+    int timer_fd;
+    bool idle;                  // no clients: tick timer off, wake on packets only
+    uint64_t next_tick_ns;      // tick deadline for the non-epoll fallback
+    PacketBatch rx;
+    Outbox out;                 // packets sent by the main thread (welcomes)
+    NetSim *netsim_in;          // --netsim: received datagrams wait here until due
+
+    // Workers. worker_count is 1 without --threads, and that one shard is
+    // ticked on the main thread.
+    Worker workers[MAX_WORKERS];
+    int worker_count;
+    bool threaded;
+    bool bench;                 // matches play themselves with bot inputs
+    pthread_mutex_t tick_lock;
+    pthread_cond_t tick_start;
+    pthread_cond_t tick_done;
+    pthread_cond_t inputs_applied;
+    int inputs_waiting;         // workers at the inputs-applied barrier
+    uint64_t inputs_generation; // bumped each time the barrier opens
+    uint64_t tick_generation;   // bumped to start a tick
+    bool stopping;
+    atomic_int workers_busy;
+    uint64_t tick_deadline_ns;
+    bool ticking;               // workers are running: only inputs are handled now
+    int done_fd;                // eventfd the last worker signals (Linux)
+    int tick_epoll_fd;          // socket + done_fd, waited on during a tick
+    PacketBatch deferred;       // non-input packets received during a tick
+
+    Match matches[MAX_MATCHES];
+    BallHistory ball_history[MAX_MATCHES];  // by match slot; apart so Match stays small
+    int free_match;             // head of the free match list
+    int waiting_match;          // match with one player waiting, -1 if none
+    int active_count;           // running matches across all shards
+
+    Client clients[MAX_CLIENTS];
+    int free_client;
+    int client_count;
+    int client_buckets[CLIENT_HASH_SIZE];
+
+    // Stats (main thread; workers count their own)
+    uint64_t packets_in;
+    uint64_t syscalls;
+    uint64_t inputs_dropped;    // worker input queue full
+    uint64_t ticks_missed;
+    uint64_t tick_ns_total;
+    uint64_t tick_ns_max;
+} Server;
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// CPU time of the calling thread, so tick cost is not skewed by preemption
+static uint64_t cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void packet_batch_init(PacketBatch *batch) {
+    batch->count = 0;
+    for (int i = 0; i < PACKET_BATCH; i++) {
+        batch->iov[i].iov_base = batch->data[i];
+        batch->iov[i].iov_len = MAX_PACKET_SIZE;
+#ifdef __linux__
+        batch->msgs[i].msg_hdr = (struct msghdr){
+            .msg_name = &batch->addrs[i],
+            .msg_namelen = sizeof(batch->addrs[i]),
+            .msg_iov = &batch->iov[i],
+            .msg_iovlen = 1
+        };
+#endif
+    }
+}
+
+void server_init(Server *server) {
+    server->fd = -1;
+    server->epoll_fd = -1;
+    server->timer_fd = -1;
+    server->done_fd = -1;
+    server->tick_epoll_fd = -1;
+    server->idle = false;
+    packet_batch_init(&server->rx);
+    packet_batch_init(&server->out.batch);
+    packet_batch_init(&server->deferred);
+    server->tick = 0;
+    server->waiting_match = -1;
+    server->active_count = 0;
+    server->client_count = 0;
+
+    server->worker_count = 1;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        Worker *worker = &server->workers[i];
+        worker->server = server;
+        worker->id = i;
+        worker->match_count = 0;
+        atomic_init(&worker->queue.head, 0);
+        atomic_init(&worker->queue.tail, 0);
+        atomic_init(&worker->next, 0);
+        packet_batch_init(&worker->out.batch);
+    }
+
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        server->matches[i].in_use = false;
+        server->matches[i].worker = -1;
+        server->matches[i].next_free = (i + 1 < MAX_MATCHES) ? i + 1 : -1;
+    }
+    server->free_match = 0;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        server->clients[i].active = false;
+        server->clients[i].next_free = (i + 1 < MAX_CLIENTS) ? i + 1 : -1;
+    }
+    server->free_client = 0;
+
+    for (int i = 0; i < CLIENT_HASH_SIZE; i++) {
+        server->client_buckets[i] = -1;
+    }
+}
+
+bool server_open(Server *server, uint16_t port) {
+    server->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (server->fd < 0) {
+        perror("socket");
+        return false;
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(server->fd);
+        server->fd = -1;
+        return false;
+    }
+
+    int flags = fcntl(server->fd, F_GETFL, 0);
+    fcntl(server->fd, F_SETFL, flags | O_NONBLOCK);
+
+    // Packets are drained once per tick, so the kernel has to queue a full
+    // tick of inputs (and outgoing states) per socket
+    int buf_size = SOCKET_BUFFER_SIZE;
+    setsockopt(server->fd, SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+    setsockopt(server->fd, SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+
+#ifdef __linux__
+    server->epoll_fd = epoll_create1(0);
+    server->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (server->epoll_fd < 0 || server->timer_fd < 0) {
+        perror("epoll/timerfd");
+        return false;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = server->timer_fd };
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->timer_fd, &ev);
+    ev = (struct epoll_event){ .events = 0, .data.fd = server->fd };
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->fd, &ev);
+
+    // While the workers tick, the network thread keeps reading the socket
+    // until the last worker signals done_fd
+    if (server->threaded) {
+        server->done_fd = eventfd(0, EFD_NONBLOCK);
+        server->tick_epoll_fd = epoll_create1(0);
+        if (server->done_fd < 0 || server->tick_epoll_fd < 0) {
+            perror("eventfd/epoll");
+            return false;
+        }
+        ev = (struct epoll_event){ .events = EPOLLIN, .data.fd = server->done_fd };
+        epoll_ctl(server->tick_epoll_fd, EPOLL_CTL_ADD, server->done_fd, &ev);
+        ev = (struct epoll_event){ .events = EPOLLIN, .data.fd = server->fd };
+        epoll_ctl(server->tick_epoll_fd, EPOLL_CTL_ADD, server->fd, &ev);
+    }
+#endif
+
+    // Not idle yet, so the first wait registers for socket wakeups
+    server->idle = false;
+    server->next_tick_ns = now_ns();
+    return true;
+}
+
+void server_close(Server *server) {
+    if (server->fd >= 0) close(server->fd);
+#ifdef __linux__
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->timer_fd >= 0) close(server->timer_fd);
+    if (server->done_fd >= 0) close(server->done_fd);
+    if (server->tick_epoll_fd >= 0) close(server->tick_epoll_fd);
+#endif
+    netsim_destroy(server->netsim_in);
+    netsim_destroy(server->out.sim);
+    for (int i = 0; i < server->worker_count; i++) netsim_destroy(server->workers[i].out.sim);
+}
+
+// Puts every datagram in and out through an emulated link. The workers'
+// share of the outgoing queue is split between them like their matches.
+bool server_start_netsim(Server *server, const NetSimConfig *config) {
+    server->netsim_in = netsim_create(config, NETSIM_INBOUND, NETSIM_QUEUE);
+    server->out.sim = netsim_create(config, NETSIM_OUTBOUND, NETSIM_WELCOME_QUEUE);
+    bool ok = server->netsim_in && server->out.sim;
+    for (int i = 0; i < server->worker_count; i++) {
+        server->workers[i].out.sim = netsim_create(config, NETSIM_OUTBOUND, NETSIM_QUEUE / server->worker_count);
+        ok = ok && server->workers[i].out.sim;
+    }
+    if (!ok) fprintf(stderr, "Failed to allocate the link emulator\n");
+    return ok;
+}
+
+// --- Client table -----------------------------------------------------------
+
+static uint32_t addr_hash(const struct sockaddr_in *addr) {
+    uint32_t h = addr->sin_addr.s_addr * 2654435761u;
+    h ^= (uint32_t)addr->sin_port * 40503u;
+    return h & (CLIENT_HASH_SIZE - 1);
+}
+
+static bool addr_equal(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+int server_find_client(Server *server, const struct sockaddr_in *addr) {
+    int c = server->client_buckets[addr_hash(addr)];
+    while (c >= 0) {
+        if (addr_equal(&server->clients[c].addr, addr)) return c;
+        c = server->clients[c].hash_next;
+    }
+    return -1;
+}
+
+int server_add_client(Server *server, const struct sockaddr_in *addr) {
+    int c = server->free_client;
+    if (c < 0) return -1;
+
+    Client *client = &server->clients[c];
+    server->free_client = client->next_free;
+
+    uint32_t bucket = addr_hash(addr);
+    client->addr = *addr;
+    client->match = -1;
+    client->player = 0;
+    client->buttons = 0;
+    client->has_input = false;
+    client->seq = 0;
+    client->remote_seq = 0;
+    client->acked = 0;
+    client->has_acked = false;
+    snapshot_ring_clear(&client->history);
+    client->recv_seq = 0;
+    client->epoch++;
+    client->last_heard = server->tick;
+    client->active = true;
+    client->hash_next = server->client_buckets[bucket];
+    server->client_buckets[bucket] = c;
+    server->client_count++;
+    return c;
+}
+
+static void server_unlink_client(Server *server, int c) {
+    int *link = &server->client_buckets[addr_hash(&server->clients[c].addr)];
+    while (*link >= 0) {
+        if (*link == c) {
+            *link = server->clients[c].hash_next;
+            return;
+        }
+        link = &server->clients[*link].hash_next;
+    }
+}
+
+// --- Match pool -------------------------------------------------------------
+
+static int server_alloc_match(Server *server) {
+    int m = server->free_match;
+    if (m < 0) return -1;
+
+    Match *match = &server->matches[m];
+    server->free_match = match->next_free;
+    match->in_use = true;
+    match->clients[0] = -1;
+    match->clients[1] = -1;
+    match->worker = -1;
+    return m;
+}
+
+static void server_free_match(Server *server, int m) {
+    Match *match = &server->matches[m];
+    match->in_use = false;
+    match->next_free = server->free_match;
+    server->free_match = m;
+    if (server->waiting_match == m) server->waiting_match = -1;
+}
+
+// --- Shards -----------------------------------------------------------------
+// Shard lists only change on the main thread between ticks.
+
+static void server_shard_add(Server *server, Worker *worker, int m) {
+    Match *match = &server->matches[m];
+    match->worker = worker->id;
+    match->shard_pos = worker->match_count;
+    worker->matches[worker->match_count++] = m;
+}
+
+static void server_shard_remove(Server *server, int m) {
+    Match *match = &server->matches[m];
+    Worker *worker = &server->workers[match->worker];
+
+    // Swap-remove from the dense shard list
+    int last = worker->matches[--worker->match_count];
+    worker->matches[match->shard_pos] = last;
+    server->matches[last].shard_pos = match->shard_pos;
+    match->worker = -1;
+}
+
+static Worker *server_least_loaded(Server *server) {
+    Worker *least = &server->workers[0];
+    for (int i = 1; i < server->worker_count; i++) {
+        if (server->workers[i].match_count < least->match_count) least = &server->workers[i];
+    }
+    return least;
+}
+
+// Moves matches from the largest shard to the smallest until they are within
+// one of each other. Stealing evens out a single slow tick; this keeps the
+// steady state local to one core.
+static void server_rebalance(Server *server) {
+    for (;;) {
+        Worker *most = &server->workers[0];
+        for (int i = 1; i < server->worker_count; i++) {
+            if (server->workers[i].match_count > most->match_count) most = &server->workers[i];
+        }
+        Worker *least = server_least_loaded(server);
+        if (most->match_count - least->match_count <= 1) return;
+
+        int m = most->matches[most->match_count - 1];
+        server_shard_remove(server, m);
+        server_shard_add(server, least, m);
+    }
+}
+
+static void server_start_match(Server *server, int m) {
+    Match *match = &server->matches[m];
+    game_init(&match->game, game_rand(&server->rng));
+    ball_history_reset(&server->ball_history[m], &match->game);
+    server_shard_add(server, server_least_loaded(server), m);
+    server->active_count++;
+}
+
+static void server_stop_match(Server *server, int m) {
+    if (server->matches[m].worker < 0) return;
+    server_shard_remove(server, m);
+    server->active_count--;
+}
+
+static void server_seat_client(Server *server, int m, int player, int c) {
+    server->matches[m].clients[player] = c;
+    server->clients[c].match = m;
+    server->clients[c].player = player;
+    server->clients[c].buttons = 0;
+    server->clients[c].has_input = false;
+    server->clients[c].has_view = false;
+    server->clients[c].seat_seq = server->clients[c].seq;
+    server->clients[c].epoch++;     // inputs still queued were meant for the old seat
+}
+
+// Pair a client with the waiting player, or open a new match for them
+bool server_join_match(Server *server, int c) {
+    int m = server->waiting_match;
+    if (m >= 0) {
+        server_seat_client(server, m, 1, c);
+        server->waiting_match = -1;
+        server_start_match(server, m);
+        return true;
+    }
+
+    m = server_alloc_match(server);
+    if (m < 0) return false;
+
+    server_seat_client(server, m, 0, c);
+    server->waiting_match = m;
+    return true;
+}
+
+static void server_send_welcome(Server *server, int c);
+void server_remove_client(Server *server, int c);
+
+void server_leave_match(Server *server, int c) {
+    Client *client = &server->clients[c];
+    int m = client->match;
+    if (m < 0) return;
+
+    Match *match = &server->matches[m];
+    match->clients[client->player] = -1;
+    client->match = -1;
+    server_stop_match(server, m);
+
+    int other = match->clients[0] >= 0 ? match->clients[0] : match->clients[1];
+    if (other < 0) {
+        server_free_match(server, m);
+        return;
+    }
+
+    // The opponent goes back to waiting, either here or in the waiting match,
+    // and is welcomed to its new seat. With no match slot free it is dropped;
+    // the client joins again once it stops hearing from us.
+    match->clients[0] = -1;
+    match->clients[1] = -1;
+    server_free_match(server, m);
+    server->clients[other].match = -1;
+    if (server_join_match(server, other)) {
+        server_send_welcome(server, other);
+    } else {
+        server_remove_client(server, other);
+    }
+}
+
+void server_remove_client(Server *server, int c) {
+    server_leave_match(server, c);
+    server_unlink_client(server, c);
+
+    Client *client = &server->clients[c];
+    client->active = false;
+    client->next_free = server->free_client;
+    server->free_client = c;
+    server->client_count--;
+}
+
+// --- Batched I/O ------------------------------------------------------------
+
+// Sends everything queued in an outbox with as few sendmmsg calls as the
+// kernel allows. If the socket buffer is full the rest is dropped: every
+// queued packet is a state snapshot that the next tick supersedes anyway.
+// Each thread flushes its own outbox; the kernel serializes the socket.
+static void server_send_batch(Server *server, Outbox *out) {
+#ifdef __linux__
+    PacketBatch *tx = &out->batch;
+    int sent = 0;
+    while (sent < tx->count) {
+        int n = sendmmsg(server->fd, &tx->msgs[sent], (unsigned int)(tx->count - sent), 0);
+        out->syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            out->packets_dropped += (uint64_t)(tx->count - sent);
+            break;
+        }
+        for (int i = sent; i < sent + n; i++) out->bytes_out += tx->iov[i].iov_len;
+        sent += n;
+    }
+    out->packets_out += (uint64_t)sent;
+    tx->count = 0;
+#else
+    (void)server;
+    (void)out;
+#endif
+}
+
+static void server_transmit(Server *server, Outbox *out, const struct sockaddr_in *addr, const void *data, size_t len) {
+#ifdef __linux__
+    if (!server->per_packet) {
+        PacketBatch *tx = &out->batch;
+        if (tx->count == PACKET_BATCH) server_send_batch(server, out);
+
+        int i = tx->count++;
+        memcpy(tx->data[i], data, len);
+        tx->addrs[i] = *addr;
+        tx->iov[i].iov_len = len;
+        return;
+    }
+#endif
+    out->syscalls++;
+    if (sendto(server->fd, data, len, 0, (const struct sockaddr *)addr, sizeof(*addr)) >= 0) {
+        out->packets_out++;
+        out->bytes_out += len;
+    } else {
+        out->packets_dropped++;
+    }
+}
+
+// Sends what the outbox's emulated link has delivered by now, then the batch
+void server_flush(Server *server, Outbox *out) {
+    if (out->sim) {
+        uint64_t now = now_ns();
+        const NetSimPacket *packet;
+        while ((packet = netsim_pop(out->sim, now))) {
+            struct sockaddr_in addr;
+            memcpy(&addr, packet->peer, sizeof(addr));
+            server_transmit(server, out, &addr, packet->data, (size_t)packet->len);
+        }
+    }
+    server_send_batch(server, out);
+}
+
+static void server_send(Server *server, Outbox *out, const struct sockaddr_in *addr, const void *data, size_t len) {
+    if (out->discard) {
+        out->packets_out++;
+        out->bytes_out += len;
+        return;
+    }
+    if (out->sim) {
+        netsim_push(out->sim, now_ns(), addr, sizeof(*addr), data, (int)len);
+        return;
+    }
+    server_transmit(server, out, addr, data, len);
+}
+
+static void server_send_welcome(Server *server, int c) {
+    Client *client = &server->clients[c];
+    WelcomePacket welcome = {
+        .player = (uint8_t)client->player,
+        .match = (uint16_t)client->match
+    };
+    uint8_t buf[MAX_PACKET_SIZE];
+    int len = packet_encode_welcome(buf, sizeof(buf), ++client->seq, client->remote_seq, &welcome);
+    server_send(server, &server->out, &client->addr, buf, (size_t)len);
+}
+
+// Stores the stamped inputs of a PKT_INPUT that have not been applied yet
+static void server_queue_input(Client *client, const InputPacket *input) {
+    if (!client->has_input) {
+        // First input of a match: start from the oldest tick in this packet
+        client->input_tick = (uint16_t)(input->tick - input->count);
+        client->input_newest = client->input_tick;
+        client->has_input = true;
+    }
+
+    for (int i = 0; i < input->count; i++) {
+        uint16_t tick = (uint16_t)(input->tick - i);
+        if (!sequence_greater(tick, client->input_tick)) break;
+        int slot = tick & (INPUT_BUFFER - 1);
+        // The view belongs to the newest tick; it is also the best guess for
+        // older ticks whose own packet was lost
+        if (i == 0 || client->input_ticks[slot] != tick) {
+            client->input_views[slot] = input->view_seq;
+            client->input_view_fracs[slot] = input->view_frac;
+        }
+        client->inputs[slot] = input->buttons[i];
+        client->input_ticks[slot] = tick;
+    }
+    if (sequence_greater(input->tick, client->input_newest)) client->input_newest = input->tick;
+}
+
+// Records the seq/ack of a packet from the client
+static void server_update_acks(Client *client, uint16_t seq, uint16_t ack) {
+    client->remote_seq = seq;
+    if (!client->has_acked || sequence_greater(ack, client->acked)) {
+        client->acked = ack;
+        client->has_acked = true;
+    }
+}
+
+// --- Input queues -------------------------------------------------------------
+
+// Network thread only. Returns false when the worker is a full queue behind.
+static bool input_queue_push(InputQueue *queue, const InputMessage *message) {
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail == INPUT_QUEUE_SIZE) return false;
+
+    queue->slots[head & (INPUT_QUEUE_SIZE - 1)] = *message;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Worker only. Applies the inputs queued before this tick started; inputs
+// pushed while it runs wait for the next tick.
+static void server_drain_inputs(Server *server, Worker *worker) {
+    InputQueue *queue = &worker->queue;
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    for (; tail != head; tail++) {
+        const InputMessage *message = &queue->slots[tail & (INPUT_QUEUE_SIZE - 1)];
+        Client *client = &server->clients[message->client];
+        if (client->epoch != message->epoch) continue;     // left, or the slot was reused
+
+        server_update_acks(client, message->seq, message->ack);
+        server_queue_input(client, &message->input);
+    }
+    atomic_store_explicit(&queue->tail, tail, memory_order_release);
+}
+
+// Mid-tick the match table belongs to the workers, so anything but an input
+// waits until the tick is over. A full buffer drops the packet; joins are
+// resent until welcomed.
+static void server_defer_packet(Server *server, const struct sockaddr_in *addr, const uint8_t *data, size_t len) {
+    PacketBatch *deferred = &server->deferred;
+    if (deferred->count == PACKET_BATCH) return;
+
+    int i = deferred->count++;
+    memcpy(deferred->data[i], data, len);
+    deferred->addrs[i] = *addr;
+    deferred->iov[i].iov_len = len;
+}
+
+void server_handle_packet(Server *server, const struct sockaddr_in *addr, const uint8_t *data, size_t len) {
+    PacketReader reader;
+    PacketHeader header;
+    if (!packet_decode_header(&reader, data, (int)len, &header)) return;
+    if (server->ticking && header.type != PKT_INPUT) {
+        server_defer_packet(server, addr, data, len);
+        return;
+    }
+    server->packets_in++;
+
+    int c = server_find_client(server, addr);
+    if (c >= 0) {
+        // Drop stale or duplicated packets
+        Client *client = &server->clients[c];
+        if (client->recv_seq != 0 && !sequence_greater(header.seq, client->recv_seq)) return;
+        client->recv_seq = header.seq;
+    }
+
+    switch (header.type) {
+        case PKT_JOIN: {
+            if (c < 0) {
+                c = server_add_client(server, addr);
+                if (c < 0) return;  // Server full
+            } else if (server->clients[c].match >= 0 &&
+                       game_is_over(&server->matches[server->clients[c].match].game)) {
+                // Rejoining after a finished match
+                server_leave_match(server, c);
+            }
+
+            if (server->clients[c].match < 0 && !server_join_match(server, c)) {
+                server_remove_client(server, c);
+                return;
+            }
+
+            server->clients[c].recv_seq = header.seq;
+            server_update_acks(&server->clients[c], header.seq, header.ack);
+            server->clients[c].last_heard = server->tick;
+            server_send_welcome(server, c);
+            break;
+        }
+
+        case PKT_INPUT: {
+            InputPacket input;
+            if (c < 0 || !packet_decode_input(&reader, &input)) return;
+            Client *client = &server->clients[c];
+            client->last_heard = server->tick;
+
+            if (!server->threaded) {
+                server_update_acks(client, header.seq, header.ack);
+                server_queue_input(client, &input);
+                break;
+            }
+            InputMessage message = {
+                .client = c,
+                .epoch = client->epoch,
+                .seq = header.seq,
+                .ack = header.ack,
+                .input = input
+            };
+            if (!input_queue_push(&server->workers[c % server->worker_count].queue, &message)) {
+                server->inputs_dropped++;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// A datagram off the socket, handled now or once the emulated link delivers it
+static void server_receive_packet(Server *server, const struct sockaddr_in *addr, const uint8_t *data, size_t len) {
+    if (server->netsim_in) {
+        netsim_push(server->netsim_in, now_ns(), addr, sizeof(*addr), data, (int)len);
+    } else {
+        server_handle_packet(server, addr, data, len);
+    }
+}
+
+// Drains every datagram queued on the socket
+static void server_read_socket(Server *server) {
+#ifdef __linux__
+    if (!server->per_packet) {
+        PacketBatch *rx = &server->rx;
+        for (;;) {
+            int n = recvmmsg(server->fd, rx->msgs, PACKET_BATCH, MSG_DONTWAIT, NULL);
+            server->syscalls++;
+            if (n <= 0) {
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("recvmmsg");
+                break;
+            }
+
+            for (int i = 0; i < n; i++) {
+                server_receive_packet(server, &rx->addrs[i], rx->data[i], rx->msgs[i].msg_len);
+                rx->msgs[i].msg_hdr.msg_namelen = sizeof(rx->addrs[i]);
+            }
+            if (n < PACKET_BATCH) break;
+        }
+        return;
+    }
+#endif
+
+    uint8_t buf[MAX_PACKET_SIZE];
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+
+    for (;;) {
+        addr_len = sizeof(addr);
+        ssize_t n = recvfrom(server->fd, buf, sizeof(buf), 0, (struct sockaddr *)&addr, &addr_len);
+        server->syscalls++;
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("recvfrom");
+            break;
+        }
+        server_receive_packet(server, &addr, buf, (size_t)n);
+    }
+}
+
+// Handles received datagrams, and those the emulated link has delivered by now
+void server_receive(Server *server) {
+    server_read_socket(server);
+    if (!server->netsim_in) return;
+
+    uint64_t now = now_ns();
+    const NetSimPacket *packet;
+    while ((packet = netsim_pop(server->netsim_in, now))) {
+        struct sockaddr_in addr;
+        memcpy(&addr, packet->peer, sizeof(addr));
+        server_handle_packet(server, &addr, packet->data, (size_t)packet->len);
+    }
+}
+
+// Milliseconds until the next emulated datagram is due either way, -1 when
+// none is in flight
+static int server_netsim_timeout(Server *server) {
+    if (!server->netsim_in) return -1;
+    uint64_t due = netsim_next_due(server->netsim_in);
+    uint64_t out_due = netsim_next_due(server->out.sim);
+    if (out_due < due) due = out_due;
+    for (int i = 0; i < server->worker_count; i++) {
+        out_due = netsim_next_due(server->workers[i].out.sim);
+        if (out_due < due) due = out_due;
+    }
+    if (due == UINT64_MAX) return -1;
+
+    uint64_t now = now_ns();
+    return due <= now ? 0 : (int)((due - now + 999999) / 1000000);
+}
+
+// Delivers everything the emulated links have due, both ways. Between ticks
+// only: it flushes the workers' outboxes.
+static void server_netsim_deliver(Server *server) {
+    if (!server->netsim_in) return;
+    server_receive(server);
+    server_flush(server, &server->out);
+    for (int i = 0; i < server->worker_count; i++) server_flush(server, &server->workers[i].out);
+}
+
+// With no clients the tick timer is stopped and only the socket wakes us;
+// otherwise only the timer does, and packets wait in the socket buffer until
+// the tick drains them in one batch.
+static void server_set_idle(Server *server, bool idle) {
+    if (server->idle == idle) return;
+    server->idle = idle;
+
+#ifdef __linux__
+    struct itimerspec spec = {0};
+    if (!idle) {
+        spec.it_interval.tv_nsec = (long)TICK_NS;
+        spec.it_value.tv_nsec = (long)TICK_NS;
+    }
+    timerfd_settime(server->timer_fd, 0, &spec, NULL);
+
+    struct epoll_event ev = { .events = idle ? EPOLLIN : 0, .data.fd = server->fd };
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, server->fd, &ev);
+#else
+    server->next_tick_ns = now_ns() + TICK_NS;
+#endif
+}
+
+// Blocks until the next tick is due, delivering emulated datagrams as they
+// come due meanwhile
+void server_wait_tick(Server *server) {
+    while (running) {
+        server_set_idle(server, server->client_count == 0);
+
+#ifdef __linux__
+        struct epoll_event events[2];
+        int n = epoll_wait(server->epoll_fd, events, 2, server_netsim_timeout(server));
+        server->syscalls++;
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == server->timer_fd) {
+                uint64_t expirations = 0;
+                if (read(server->timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    if (expirations > 1) server->ticks_missed += expirations - 1;
+                }
+                server->syscalls++;
+                return;
+            }
+            server_receive(server);
+        }
+        if (n > 0) server_flush(server, &server->out);
+        server_netsim_deliver(server);
+#else
+        struct pollfd pfd = { .fd = server->fd, .events = POLLIN };
+        if (server->idle) {
+            poll(&pfd, 1, server_netsim_timeout(server));
+            server->syscalls++;
+            server_receive(server);
+            server_netsim_deliver(server);
+            continue;
+        }
+
+        uint64_t now = now_ns();
+        if (now >= server->next_tick_ns) {
+            uint64_t behind = (now - server->next_tick_ns) / TICK_NS;
+            server->ticks_missed += behind;
+            server->next_tick_ns += (behind + 1) * TICK_NS;
+            return;
+        }
+        uint64_t sleep_ns = server->next_tick_ns - now;
+        int timeout = server_netsim_timeout(server);
+        if (timeout >= 0 && (uint64_t)timeout * 1000000ULL < sleep_ns) sleep_ns = (uint64_t)timeout * 1000000ULL;
+        struct timespec ts = {
+            .tv_sec = (time_t)(sleep_ns / 1000000000ULL),
+            .tv_nsec = (long)(sleep_ns % 1000000000ULL)
+        };
+        nanosleep(&ts, NULL);
+        server_netsim_deliver(server);
+#endif
+    }
+}
+
+// --- Simulation -------------------------------------------------------------
+
+// Takes the client's next stamped input, one per tick. An empty queue repeats
+// the last buttons; a backlog longer than INPUT_MAX_QUEUE (a burst after a
+// stall, or a client clock running fast) is skipped so input delay stays bounded.
+static uint8_t server_next_input(Client *client) {
+    client->has_view = false;
+    if (!client->has_input || !sequence_greater(client->input_newest, client->input_tick)) {
+        return client->buttons;
+    }
+    if ((uint16_t)(client->input_newest - client->input_tick) > INPUT_MAX_QUEUE) {
+        client->input_tick = (uint16_t)(client->input_newest - INPUT_MAX_QUEUE);
+    }
+
+    client->input_tick++;
+    int slot = client->input_tick & (INPUT_BUFFER - 1);
+    // Lost in every redundant copy: keep the last buttons
+    if (client->input_ticks[slot] == client->input_tick) {
+        client->buttons = client->inputs[slot];
+        client->view_seq = client->input_views[slot];
+        client->view_frac = client->input_view_fracs[slot];
+        client->has_view = true;
+    }
+    return client->buttons;
+}
+
+// The ball as the client saw it when it sent the input applied this tick
+static bool server_seen_ball(const Server *server, int m, const Client *client, Ball *seen) {
+    if (!client->has_view || !sequence_greater(client->view_seq, client->seat_seq)) return false;
+    if (!snapshot_ring_get(&client->history, client->view_seq)) return false;     // never sent, or too old
+    uint32_t tick = client->tick_base + client->view_seq;
+    return ball_history_seen(&server->ball_history[m], tick, client->view_frac, server->rewind_ticks, seen);
+}
+
+// Simple bot for --bench: chase the ball with the paddle
+static uint8_t bot_buttons(const Paddle *paddle, const Ball *ball) {
+    float center = paddle->y + paddle->h / 2.0f;
+    float target = ball->y + BALL_SIZE / 2.0f;
+    if (target < center - 10) return INPUT_UP;
+    if (target > center + 10) return INPUT_DOWN;
+    return 0;
+}
+
+// Steps one match and sends each client its state, as a delta against the
+// newest snapshot the client acked when that is still in its history, else
+// in full. Only the thread that claimed the match touches it this tick.
+static void server_tick_match(Server *server, Outbox *out, int m) {
+    Match *match = &server->matches[m];
+    Client *left = &server->clients[match->clients[0]];
+    Client *right = &server->clients[match->clients[1]];
+
+    if (server->bench) {
+        if (game_is_over(&match->game)) {
+            game_init(&match->game, (uint32_t)m);
+            ball_history_reset(&server->ball_history[m], &match->game);
+        }
+        left->buttons = bot_buttons(&match->game.player1, &match->game.ball);
+        right->buttons = bot_buttons(&match->game.player2, &match->game.ball);
+    }
+    GameEvents events = {false, false, false, 0};
+    if (!game_is_over(&match->game)) {
+        uint8_t buttons1 = server_next_input(left);
+        uint8_t buttons2 = server_next_input(right);
+        Ball seen1, seen2;
+        bool has_seen1 = server_seen_ball(server, m, left, &seen1);
+        bool has_seen2 = server_seen_ball(server, m, right, &seen2);
+        events = lag_compensated_step(&match->game, &server->ball_history[m], buttons1, buttons2,
+                                      has_seen1 ? &seen1 : NULL, has_seen2 ? &seen2 : NULL, server->rewind_ticks);
+        // Keep the match at wire precision so client replays match it exactly
+        game_quantize(&match->game);
+    }
+
+    GameState state;
+    Snapshot snap;
+    uint8_t buf[MAX_PACKET_SIZE];
+    game_state_from_game(&state, &match->game);
+    snapshot_from_state(&snap, &state);
+    ball_history_record(&server->ball_history[m], match->game.tick, &snap, events.scored);
+
+    for (int p = 0; p < 2; p++) {
+        Client *client = p == 0 ? left : right;
+        uint16_t seq = ++client->seq;
+
+        const Snapshot *baseline = NULL;
+        if (server->delta && client->has_acked) {
+            baseline = snapshot_ring_get(&client->history, client->acked);
+        }
+
+        int len = baseline
+            ? packet_encode_delta(buf, sizeof(buf), seq, client->remote_seq, client->input_tick,
+                                  client->acked, baseline, &snap)
+            : packet_encode_snapshot(buf, sizeof(buf), seq, client->remote_seq, client->input_tick, &snap);
+        snapshot_ring_put(&client->history, seq, &snap);
+        client->tick_base = match->game.tick - seq;
+        server_send(server, out, &client->addr, buf, (size_t)len);
+    }
+}
+
+// Ticks the worker's own shard in chunks, then steals chunks from the other
+// shards until every match has been claimed
+static void server_step_shards(Server *server, Worker *worker) {
+    for (int k = 0; k < server->worker_count; k++) {
+        Worker *victim = &server->workers[(worker->id + k) % server->worker_count];
+        for (;;) {
+            int first = atomic_fetch_add_explicit(&victim->next, STEAL_CHUNK, memory_order_relaxed);
+            if (first >= victim->match_count) break;
+            int end = first + STEAL_CHUNK < victim->match_count ? first + STEAL_CHUNK : victim->match_count;
+
+            for (int i = first; i < end; i++) server_tick_match(server, &worker->out, victim->matches[i]);
+            worker->matches_stepped += (uint64_t)(end - first);
+            if (k > 0) worker->matches_stolen += (uint64_t)(end - first);
+        }
+    }
+}
 
-// TODO: Define packet structures for:
-// - Client->Server: player input (up/down keys)
-// - Server->Client: full game state
+// Waits until every worker has applied its inputs. A mutex and condition
+// rather than pthread_barrier_t, which macOS does not have.
+static void server_wait_inputs_applied(Server *server) {
+    pthread_mutex_lock(&server->tick_lock);
+    uint64_t generation = server->inputs_generation;
+    if (++server->inputs_waiting == server->worker_count) {
+        server->inputs_waiting = 0;
+        server->inputs_generation++;
+        pthread_cond_broadcast(&server->inputs_applied);
+    } else {
+        while (server->inputs_generation == generation) {
+            pthread_cond_wait(&server->inputs_applied, &server->tick_lock);
+        }
+    }
+    pthread_mutex_unlock(&server->tick_lock);
+}
+
+// One worker's part of a tick: apply queued inputs, wait until every worker
+// has (a client's queue and its match may be on different workers), then
+// step and broadcast
+static void server_worker_tick(Server *server, Worker *worker) {
+    uint64_t start = cpu_ns();
+
+    server_drain_inputs(server, worker);
+    atomic_store_explicit(&worker->next, 0, memory_order_relaxed);
+    if (server->threaded) server_wait_inputs_applied(server);
+
+    server_step_shards(server, worker);
+    server_flush(server, &worker->out);
+
+    uint64_t busy = cpu_ns() - start;
+    worker->busy_ns_total += busy;
+    if (busy > worker->busy_ns_max) worker->busy_ns_max = busy;
+    if (now_ns() > server->tick_deadline_ns) worker->ticks_missed++;
+}
+
+static void server_signal_tick_done(Server *server) {
+#ifdef __linux__
+    if (server->done_fd >= 0) {
+        uint64_t one = 1;
+        if (write(server->done_fd, &one, sizeof(one)) < 0) perror("eventfd");
+        return;
+    }
+#endif
+    pthread_mutex_lock(&server->tick_lock);
+    pthread_cond_signal(&server->tick_done);
+    pthread_mutex_unlock(&server->tick_lock);
+}
+
+static void *server_worker_main(void *arg) {
+    Worker *worker = arg;
+    Server *server = worker->server;
+    uint64_t generation = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&server->tick_lock);
+        while (server->tick_generation == generation && !server->stopping) {
+            pthread_cond_wait(&server->tick_start, &server->tick_lock);
+        }
+        bool stopping = server->stopping;
+        generation = server->tick_generation;
+        pthread_mutex_unlock(&server->tick_lock);
+        if (stopping) break;
+
+        server_worker_tick(server, worker);
+        if (atomic_fetch_sub(&server->workers_busy, 1) == 1) server_signal_tick_done(server);
+    }
+    return NULL;
+}
+
+// Blocks until every worker has finished the tick. The network thread keeps
+// draining the socket meanwhile when it can wait on both.
+static void server_wait_workers(Server *server) {
+#ifdef __linux__
+    if (server->tick_epoll_fd >= 0) {
+        for (;;) {
+            struct epoll_event events[2];
+            int n = epoll_wait(server->tick_epoll_fd, events, 2, -1);
+            server->syscalls++;
+
+            bool done = false;
+            for (int i = 0; i < n; i++) {
+                if (events[i].data.fd == server->done_fd) {
+                    uint64_t value;
+                    if (read(server->done_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) perror("eventfd");
+                    server->syscalls++;
+                    done = true;
+                } else {
+                    server_receive(server);
+                }
+            }
+            // Acquire pairs with the workers' decrement, publishing their writes
+            if (done && atomic_load_explicit(&server->workers_busy, memory_order_acquire) == 0) return;
+        }
+    }
+#endif
+    pthread_mutex_lock(&server->tick_lock);
+    while (atomic_load(&server->workers_busy) > 0) {
+        pthread_cond_wait(&server->tick_done, &server->tick_lock);
+    }
+    pthread_mutex_unlock(&server->tick_lock);
+}
+
+// Steps and broadcasts every running match
+void server_tick_matches(Server *server) {
+    server->tick_deadline_ns = now_ns() + TICK_NS;
+    if (!server->threaded) {
+        server_worker_tick(server, &server->workers[0]);
+        return;
+    }
+
+    atomic_store(&server->workers_busy, server->worker_count);
+    pthread_mutex_lock(&server->tick_lock);
+    server->tick_generation++;
+    pthread_cond_broadcast(&server->tick_start);
+    pthread_mutex_unlock(&server->tick_lock);
+
+    server->ticking = true;
+    server_wait_workers(server);
+    server->ticking = false;
+
+    PacketBatch *deferred = &server->deferred;
+    for (int i = 0; i < deferred->count; i++) {
+        server_handle_packet(server, &deferred->addrs[i], deferred->data[i], deferred->iov[i].iov_len);
+    }
+    deferred->count = 0;
+}
+
+// Starts `count` workers pinned to their own cores, leaving the first core
+// to the network thread when there are enough. One worker means no threads:
+// the main thread ticks the single shard itself.
+bool server_start_workers(Server *server, int count) {
+    server->worker_count = count;
+    server->threaded = count > 1;
+    if (!server->threaded) return true;
+
+    pthread_mutex_init(&server->tick_lock, NULL);
+    pthread_cond_init(&server->tick_start, NULL);
+    pthread_cond_init(&server->tick_done, NULL);
+    pthread_cond_init(&server->inputs_applied, NULL);
+    server->inputs_waiting = 0;
+    atomic_init(&server->workers_busy, 0);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+
+    for (int i = 0; i < count; i++) {
+        Worker *worker = &server->workers[i];
+        if (pthread_create(&worker->thread, NULL, server_worker_main, worker) != 0) {
+            fprintf(stderr, "Failed to start worker %d\n", i);
+            server->worker_count = i;
+            return false;
+        }
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((int)((i + 1) % cores), &set);
+        pthread_setaffinity_np(worker->thread, sizeof(set), &set);
+#endif
+    }
+    return true;
+}
+
+void server_stop_workers(Server *server) {
+    if (!server->threaded) return;
+
+    pthread_mutex_lock(&server->tick_lock);
+    server->stopping = true;
+    pthread_cond_broadcast(&server->tick_start);
+    pthread_mutex_unlock(&server->tick_lock);
+
+    for (int i = 0; i < server->worker_count; i++) pthread_join(server->workers[i].thread, NULL);
+    pthread_cond_destroy(&server->inputs_applied);
+    pthread_cond_destroy(&server->tick_done);
+    pthread_cond_destroy(&server->tick_start);
+    pthread_mutex_destroy(&server->tick_lock);
+}
+
+void server_drop_silent_clients(Server *server) {
+    for (int c = 0; c < MAX_CLIENTS; c++) {
+        Client *client = &server->clients[c];
+        if (client->active && server->tick - client->last_heard > CLIENT_TIMEOUT_TICKS) {
+            printf("Client %s:%d timed out\n", inet_ntoa(client->addr.sin_addr), ntohs(client->addr.sin_port));
+            server_remove_client(server, c);
+        }
+    }
+}
+
+static void outbox_collect(Outbox *total, Outbox *out) {
+    total->packets_out += out->packets_out;
+    total->bytes_out += out->bytes_out;
+    total->packets_dropped += out->packets_dropped;
+    total->syscalls += out->syscalls;
+    out->packets_out = 0;
+    out->bytes_out = 0;
+    out->packets_dropped = 0;
+    out->syscalls = 0;
+}
+
+static void netsim_stats_collect(NetSimStats *total, NetSim *sim) {
+    total->packets += sim->stats.packets;
+    total->dropped += sim->stats.dropped;
+    total->duplicated += sim->stats.duplicated;
+    total->reordered += sim->stats.reordered;
+    total->overflowed += sim->stats.overflowed;
+    total->delivered += sim->stats.delivered;
+    total->delay_ns += sim->stats.delay_ns;
+    memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+static void server_print_netsim(const char *direction, const NetSimStats *stats) {
+    double packets = stats->packets ? (double)stats->packets : 1.0;
+    printf("  netsim %s: %llu pkts, %.1f%% lost, %.1f%% duplicated, %.1f%% reordered, %llu overflowed, "
+           "delay avg %.1f ms\n",
+           direction, (unsigned long long)stats->packets, 100.0 * stats->dropped / packets,
+           100.0 * stats->duplicated / packets, 100.0 * stats->reordered / packets,
+           (unsigned long long)stats->overflowed,
+           stats->delivered ? stats->delay_ns / 1e6 / stats->delivered : 0.0);
+}
+
+static void server_print_stats(Server *server) {
+    double seconds = (double)STATS_INTERVAL_TICKS / TICK_RATE;
+    uint64_t avg = server->tick_ns_total / STATS_INTERVAL_TICKS;
+
+    Outbox sent = {0};
+    outbox_collect(&sent, &server->out);
+    uint64_t worker_missed = 0;
+    for (int i = 0; i < server->worker_count; i++) {
+        outbox_collect(&sent, &server->workers[i].out);
+        worker_missed += server->workers[i].ticks_missed;
+    }
+
+    double match_bytes = server->active_count ? sent.bytes_out / seconds / server->active_count : 0.0;
+    printf("tick %llu: %d matches, %d clients, in %.0f pkt/s, out %.0f pkt/s (%.0f B/match/s), dropped %llu, "
+           "%.1f syscalls/tick, missed %llu ticks, tick cpu avg %.1f us max %.1f us\n",
+           (unsigned long long)server->tick, server->active_count, server->client_count,
+           server->packets_in / seconds, sent.packets_out / seconds, match_bytes,
+           (unsigned long long)(sent.packets_dropped + server->inputs_dropped),
+           (double)(server->syscalls + sent.syscalls) / STATS_INTERVAL_TICKS,
+           (unsigned long long)(server->ticks_missed + worker_missed),
+           avg / 1000.0, server->tick_ns_max / 1000.0);
+
+    if (server->threaded) {
+        for (int i = 0; i < server->worker_count; i++) {
+            Worker *worker = &server->workers[i];
+            double stolen = worker->matches_stepped
+                ? 100.0 * (double)worker->matches_stolen / (double)worker->matches_stepped : 0.0;
+            printf("  worker %d: %d matches, stepped %.0f/tick (%.1f%% stolen), busy avg %.1f us max %.1f us, "
+                   "missed %llu deadlines\n",
+                   i, worker->match_count, (double)worker->matches_stepped / STATS_INTERVAL_TICKS, stolen,
+                   worker->busy_ns_total / STATS_INTERVAL_TICKS / 1000.0, worker->busy_ns_max / 1000.0,
+                   (unsigned long long)worker->ticks_missed);
+            worker->matches_stepped = 0;
+            worker->matches_stolen = 0;
+            worker->busy_ns_total = 0;
+            worker->busy_ns_max = 0;
+            worker->ticks_missed = 0;
+        }
+    }
+    if (server->netsim_in) {
+        NetSimStats in = {0};
+        NetSimStats out = {0};
+        netsim_stats_collect(&in, server->netsim_in);
+        netsim_stats_collect(&out, server->out.sim);
+        for (int i = 0; i < server->worker_count; i++) netsim_stats_collect(&out, server->workers[i].out.sim);
+        server_print_netsim("in", &in);
+        server_print_netsim("out", &out);
+    }
+    fflush(stdout);
+    server->packets_in = 0;
+    server->syscalls = 0;
+    server->inputs_dropped = 0;
+    server->ticks_missed = 0;
+    server->tick_ns_total = 0;
+    server->tick_ns_max = 0;
+}
+
+void server_run(Server *server) {
+    while (running) {
+        server_wait_tick(server);
+        if (!running) break;
+
+        uint64_t start = cpu_ns();
+
+        server_receive(server);
+        server_flush(server, &server->out);     // welcomes before the states that follow them
+        server_tick_matches(server);
+        if (server->tick % TICK_RATE == 0) server_drop_silent_clients(server);
+        if (server->threaded && server->tick % REBALANCE_INTERVAL_TICKS == 0) server_rebalance(server);
+        server_flush(server, &server->out);
+        server->tick++;
+
+        uint64_t elapsed = cpu_ns() - start;
+        server->tick_ns_total += elapsed;
+        if (elapsed > server->tick_ns_max) server->tick_ns_max = elapsed;
+        if (server->tick % STATS_INTERVAL_TICKS == 0) server_print_stats(server);
+    }
+}
+
+// --- Load measurement -------------------------------------------------------
+
+// Ticks `count` full matches with bot input through the same worker path as
+// the live server, counting packets instead of sending them, and reports how
+// many matches the workers can carry at TICK_RATE.
+static int server_bench(Server *server, int count, int ticks) {
+    if (count > MAX_MATCHES) count = MAX_MATCHES;
+
+    for (int i = 0; i < count; i++) {
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(0x7f000001);
+        for (int p = 0; p < 2; p++) {
+            addr.sin_port = htons((uint16_t)(10000 + i * 2 + p));
+            int c = server_add_client(server, &addr);
+            server_join_match(server, c);
+        }
+    }
+
+    server->bench = true;
+    for (int i = 0; i < server->worker_count; i++) server->workers[i].out.discard = true;
+
+    uint64_t start = now_ns();
+    for (int t = 0; t < ticks; t++) {
+        server_tick_matches(server);
+        server->tick++;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    uint64_t packets = 0;
+    for (int i = 0; i < server->worker_count; i++) packets += server->workers[i].out.packets_out;
+
+    double ns_per_tick = (double)elapsed / ticks;
+    double ns_per_match = ns_per_tick / server->active_count;
+    printf("bench: %d matches, %d ticks, %d worker%s, %.1f us/tick, %.1f ns/match-tick (%llu packets)\n",
+           server->active_count, ticks, server->worker_count, server->worker_count == 1 ? "" : "s",
+           ns_per_tick / 1000.0, ns_per_match, (unsigned long long)packets);
+    for (int i = 0; server->threaded && i < server->worker_count; i++) {
+        Worker *worker = &server->workers[i];
+        printf("bench:   worker %d: %d matches, stepped %.0f/tick, stole %.0f/tick, busy avg %.1f us, "
+               "missed %llu deadlines\n",
+               i, worker->match_count, (double)worker->matches_stepped / ticks,
+               (double)worker->matches_stolen / ticks, worker->busy_ns_total / (double)ticks / 1000.0,
+               (unsigned long long)worker->ticks_missed);
+    }
+    printf("bench: ~%.0f matches at %d Hz on %d worker%s (physics + snapshot, no I/O)\n",
+           1e9 / TICK_RATE / ns_per_match, TICK_RATE, server->worker_count, server->worker_count == 1 ? "" : "s");
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
-    (void)argc; (void)argv;
+    uint16_t port = SERVER_PORT;
+    int bench_matches = 0;
+    int threads = 1;
+    bool per_packet = false;
+    bool delta = true;
+    int rewind_ms = DEFAULT_REWIND_MS;
+    const char *netsim_spec = getenv(NETSIM_ENV);
 
-    printf("UDP Pong Server\n");
-    printf("TODO: Implement UDP socket on port %d\n", SERVER_PORT);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_matches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--per-packet") == 0) {
+            per_packet = true;
+        } else if (strcmp(argv[i], "--no-delta") == 0) {
+            delta = false;
+        } else if (strcmp(argv[i], "--rewind-ms") == 0 && i + 1 < argc) {
+            rewind_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--netsim") == 0 && i + 1 < argc) {
+            netsim_spec = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--port N] [--threads N] [--per-packet] [--no-delta] [--rewind-ms N] "
+                    "[--netsim %s] [--bench MATCHES]\n", argv[0], NETSIM_USAGE);
+            return 1;
+        }
+    }
+    int max_rewind_ms = (BALL_HISTORY - 1) * 1000 / TICK_RATE;
+    if (rewind_ms < 0 || rewind_ms > max_rewind_ms) {
+        fprintf(stderr, "--rewind-ms must be between 0 and %d\n", max_rewind_ms);
+        return 1;
+    }
+    if (threads < 1 || threads > MAX_WORKERS) {
+        fprintf(stderr, "--threads must be between 1 and %d\n", MAX_WORKERS);
+        return 1;
+    }
+    NetSimConfig netsim;
+    if (netsim_spec && *netsim_spec && !netsim_parse(&netsim, netsim_spec)) {
+        fprintf(stderr, "--netsim expects %s\n", NETSIM_USAGE);
+        return 1;
+    }
 
-    GameState state = {0};
+    // ~22 MB of match, client, queue and packet slots, allocated once up
+    // front (cache-line aligned for the per-worker queues and cursors)
+    Server *server = NULL;
+    if (posix_memalign((void **)&server, 64, sizeof(Server)) != 0) {
+        fprintf(stderr, "Failed to allocate server state\n");
+        return 1;
+    }
+    memset(server, 0, sizeof(Server));
+    server_init(server);
+    server->rng = bench_matches > 0 ? 1u : (uint32_t)time(NULL) | 1u;
+    server->per_packet = per_packet;
+    server->delta = delta;
+    server->rewind_ticks = rewind_ms * TICK_RATE / 1000;
+    if (!server_start_workers(server, threads)) {
+        server_stop_workers(server);
+        free(server);
+        return 1;
+    }
+
+    if (bench_matches > 0) {
+        int result = server_bench(server, bench_matches, TICK_RATE * 10);
+        server_stop_workers(server);
+        free(server);
+        return result;
+    }
+
+    printf("UDP Pong Server\n");
+    if (!server_open(server, port)) {
+        server_stop_workers(server);
+        free(server);
+        return 1;
+    }
+    if (netsim_spec && *netsim_spec && !server_start_netsim(server, &netsim)) {
+        server_stop_workers(server);
+        server_close(server);
+        free(server);
+        return 1;
+    }
+    printf("Listening on UDP port %d (%d match slots, %d Hz, %s I/O, %d worker%s, %d ms rewind)\n",
+           port, MAX_MATCHES, TICK_RATE, per_packet ? "per-packet" : "batched",
+           threads, threads == 1 ? "" : "s", rewind_ms);
+    if (server->netsim_in) {
+        char description[256];
+        netsim_describe(&server->netsim_in->config, description, sizeof(description));
+        printf("Emulating each link: %s\n", description);
+    }
 
-    // Initialize game state
-    state.players[0].y = WINDOW_HEIGHT / 2.0f - PADDLE_HEIGHT / 2.0f;
-    state.players[1].y = WINDOW_HEIGHT / 2.0f - PADDLE_HEIGHT / 2.0f;
-    state.ball.x = WINDOW_WIDTH / 2.0f;
-    state.ball.y = WINDOW_HEIGHT / 2.0f;
-    state.ball.vx = BALL_SPEED;
-    state.ball.vy = BALL_SPEED * 0.5f;
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
 
-    // TODO: Main server loop
-    // 1. Create UDP socket, bind to SERVER_PORT
-    // 2. Loop:
-    //    - Receive player inputs
-    //    - Update game state at TICK_RATE
-    //    - Broadcast state to both clients
+    server_run(server);
 
+    printf("Shutting down\n");
+    server_stop_workers(server);
+    server_close(server);
+    free(server);
     return 0;
 }
@@ -0,0 +1,143 @@
+#ifndef TEXT_CACHE_C
+#define TEXT_CACHE_C
+
+// Cache of laid-out TTF_Text objects keyed by font and string.
+//
+// Creating a TTF_Text shapes the string and allocates its glyph data, which
+// is wasted work when the same labels are drawn every frame. Texts stay
+// alive here and are only created when a (font, string) pair is first seen,
+// e.g. when a score changes. When every entry is taken the least recently
+// drawn one is destroyed to make room.
+
+#include <SDL3/SDL.h>
+#include <SDL3_ttf/SDL_ttf.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TEXT_CACHE_SIZE 64          // cached texts
+#define TEXT_CACHE_MAX_STRING 256   // longer strings are drawn uncached
+
+typedef struct {
+    TTF_Font *font;
+    TTF_Text *text;     // NULL when the entry is free
+    uint32_t hash;
+    uint32_t last_used;
+    int w, h;
+    char string[TEXT_CACHE_MAX_STRING];
+} TextCacheEntry;
+
+typedef struct {
+    TTF_TextEngine *engine;
+    TextCacheEntry entries[TEXT_CACHE_SIZE];
+    uint32_t clock;     // bumped on every lookup, for LRU eviction
+
+    // Stats
+    uint64_t hits;
+    uint64_t misses;    // texts created
+    uint64_t evictions;
+} TextCache;
+
+void text_cache_init(TextCache *cache, TTF_TextEngine *engine) {
+    memset(cache, 0, sizeof(TextCache));
+    cache->engine = engine;
+}
+
+// Destroys every cached text. Must run before the engine or fonts go away.
+void text_cache_clear(TextCache *cache) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (cache->entries[i].text) TTF_DestroyText(cache->entries[i].text);
+        cache->entries[i].text = NULL;
+    }
+}
+
+// FNV-1a over the string, mixed with the font pointer
+static uint32_t text_cache_hash(TTF_Font *font, const char *string, size_t len) {
+    uint32_t hash = 2166136261u ^ (uint32_t)(uintptr_t)font;
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (uint8_t)string[i]) * 16777619u;
+    return hash;
+}
+
+// Returns the cached text for (font, string), creating it on a miss. NULL if
+// the string is too long to cache or TTF_CreateText fails.
+static TextCacheEntry *text_cache_get(TextCache *cache, TTF_Font *font, const char *string) {
+    size_t len = strlen(string);
+    if (len >= TEXT_CACHE_MAX_STRING) return NULL;
+
+    uint32_t hash = text_cache_hash(font, string, len);
+    cache->clock++;
+
+    TextCacheEntry *victim = &cache->entries[0];
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        TextCacheEntry *entry = &cache->entries[i];
+        if (!entry->text) {
+            if (victim->text) victim = entry;
+            continue;
+        }
+        if (entry->hash == hash && entry->font == font && strcmp(entry->string, string) == 0) {
+            entry->last_used = cache->clock;
+            cache->hits++;
+            return entry;
+        }
+        if (victim->text && entry->last_used < victim->last_used) victim = entry;
+    }
+
+    TTF_Text *text = TTF_CreateText(cache->engine, font, string, len);
+    if (!text) return NULL;
+    cache->misses++;
+
+    if (victim->text) {
+        TTF_DestroyText(victim->text);
+        cache->evictions++;
+    }
+    victim->font = font;
+    victim->text = text;
+    victim->hash = hash;
+    victim->last_used = cache->clock;
+    memcpy(victim->string, string, len + 1);
+    TTF_GetTextSize(text, &victim->w, &victim->h);
+    return victim;
+}
+
+// Draws string with its top-left corner at (x, y)
+void text_cache_draw(TextCache *cache, TTF_Font *font, const char *string, float x, float y) {
+    TextCacheEntry *entry = text_cache_get(cache, font, string);
+    if (entry) {
+        TTF_DrawRendererText(entry->text, x, y);
+        return;
+    }
+
+    TTF_Text *text = TTF_CreateText(cache->engine, font, string, 0);
+    if (text) {
+        cache->misses++;
+        TTF_DrawRendererText(text, x, y);
+        TTF_DestroyText(text);
+    }
+}
+
+// Draws string horizontally centered on center_x
+void text_cache_draw_centered(TextCache *cache, TTF_Font *font, const char *string, float center_x, float y) {
+    TextCacheEntry *entry = text_cache_get(cache, font, string);
+    if (entry) {
+        TTF_DrawRendererText(entry->text, center_x - entry->w / 2.0f, y);
+        return;
+    }
+
+    TTF_Text *text = TTF_CreateText(cache->engine, font, string, 0);
+    if (text) {
+        int w, h;
+        cache->misses++;
+        TTF_GetTextSize(text, &w, &h);
+        TTF_DrawRendererText(text, center_x - w / 2.0f, y);
+        TTF_DestroyText(text);
+    }
+}
+
+void text_cache_log_stats(const TextCache *cache) {
+    uint64_t lookups = cache->hits + cache->misses;
+    if (lookups == 0) return;
+    SDL_Log("Text cache: %llu hits, %llu misses (%.1f%% hit rate), %llu evictions",
+            (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+            100.0 * (double)cache->hits / (double)lookups, (unsigned long long)cache->evictions);
+}
+
+#endif
@@ -0,0 +1,561 @@
+#ifndef WEBSOCKET_C
+#define WEBSOCKET_C
+
+// Minimal WebSocket client (RFC 6455) on an SDL_net stream socket.
+//
+// Everything is polled from the main loop and never blocks: connect starts
+// the TCP connection, websocket_update drives the opening handshake and
+// reads whatever has arrived, and websocket_receive hands out complete
+// messages one at a time. Pings from the server are answered inside
+// websocket_receive. A ping is sent when the link has been quiet for a
+// while, and the connection is dropped if nothing comes back.
+//
+// Frames we send are masked with a fresh key each, as clients must.
+// Fragmented messages are reassembled. Text and binary messages are both
+// supported; the opcode is passed through to the caller.
+
+#include <SDL3/SDL.h>
+#include <SDL3_net/SDL_net.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#define WS_BUFFER_SIZE 16384        // receive buffer; also the largest message
+#define WS_HEADER_MAX 14            // 2 + 8 byte length + 4 byte mask
+#define WS_CONNECT_TIMEOUT_MS 5000  // TCP connect plus handshake
+#define WS_PING_INTERVAL_NS 5000000000ULL   // ping after this long without input
+#define WS_TIMEOUT_NS 15000000000ULL        // give up after this long without input
+#define WS_CLOSE_DRAIN_MS 50        // time the close frame gets to leave
+
+typedef enum {
+    WS_OP_CONTINUATION = 0x0,
+    WS_OP_TEXT = 0x1,
+    WS_OP_BINARY = 0x2,
+    WS_OP_CLOSE = 0x8,
+    WS_OP_PING = 0x9,
+    WS_OP_PONG = 0xA
+} WebSocketOpcode;
+
+// Close codes
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_GOING_AWAY 1001
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_TOO_BIG 1009
+
+typedef enum {
+    WS_CLOSED,
+    WS_CONNECTING,      // TCP connect in progress
+    WS_HANDSHAKE,       // upgrade request sent, waiting for 101
+    WS_OPEN
+} WebSocketState;
+
+// A received message; data stays valid until the next websocket_receive
+typedef struct {
+    WebSocketOpcode opcode;     // WS_OP_TEXT or WS_OP_BINARY
+    const Uint8 *data;          // NUL-terminated for convenience
+    int len;
+} WebSocketMessage;
+
+typedef struct {
+    WebSocketState state;
+    NET_StreamSocket *socket;
+    Uint64 rng;                 // masking keys
+    Uint64 connect_deadline_ns;
+    char request[1024];         // upgrade request, sent once connected
+    int request_len;
+    char accept[32];            // expected Sec-WebSocket-Accept
+
+    Uint8 in[WS_BUFFER_SIZE];   // received, not yet parsed
+    int in_len;
+    Uint8 message[WS_BUFFER_SIZE + 1];  // message handed out (or being reassembled)
+    int message_len;
+    WebSocketOpcode message_opcode;
+    bool fragmented;            // continuation frames expected
+    Uint8 out[WS_HEADER_MAX + WS_BUFFER_SIZE];
+
+    Uint64 last_received_ns;
+    Uint64 ping_sent_ns;        // 0 when no ping is outstanding
+
+    // Stats
+    Uint32 messages_in;
+    Uint32 messages_out;
+    Uint64 bytes_in;
+    Uint64 bytes_out;
+    Uint32 pings_sent;
+    Uint64 rtt_ns;              // last ping round trip
+} WebSocket;
+
+// --- Base64 ------------------------------------------------------------------
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Writes 4 * ceil(len / 3) characters plus a NUL to output
+static void base64_encode_bytes(const void *input, int len, char *output) {
+    const Uint8 *in = input;
+    int j = 0;
+    for (int i = 0; i < len; i += 3) {
+        Uint32 n = (Uint32)in[i] << 16;
+        if (i + 1 < len) n |= (Uint32)in[i + 1] << 8;
+        if (i + 2 < len) n |= in[i + 2];
+        output[j++] = base64_chars[(n >> 18) & 63];
+        output[j++] = base64_chars[(n >> 12) & 63];
+        output[j++] = i + 1 < len ? base64_chars[(n >> 6) & 63] : '=';
+        output[j++] = i + 2 < len ? base64_chars[n & 63] : '=';
+    }
+    output[j] = '\0';
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decodes len characters (stopping at '=' padding). Returns the number of
+// bytes written, or -1 on an invalid character or when output is too small.
+static int base64_decode(const char *input, int len, Uint8 *output, int output_size) {
+    Uint32 bits = 0;
+    int count = 0, j = 0;
+    for (int i = 0; i < len && input[i] != '='; i++) {
+        int v = base64_value(input[i]);
+        if (v < 0) return -1;
+        bits = (bits << 6) | (Uint32)v;
+        if (++count == 4) {
+            if (j + 3 > output_size) return -1;
+            output[j++] = (Uint8)(bits >> 16);
+            output[j++] = (Uint8)(bits >> 8);
+            output[j++] = (Uint8)bits;
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 1) return -1;
+    if (j + count - 1 > output_size) return -1;
+    if (count == 2) {
+        output[j++] = (Uint8)(bits >> 4);
+    } else if (count == 3) {
+        output[j++] = (Uint8)(bits >> 10);
+        output[j++] = (Uint8)(bits >> 2);
+    }
+    return j;
+}
+
+// --- SHA-1 (only for Sec-WebSocket-Accept) ------------------------------------
+
+static Uint32 sha1_rol(Uint32 x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(Uint32 h[5], const Uint8 *block) {
+    Uint32 w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (Uint32)block[i * 4] << 24 | (Uint32)block[i * 4 + 1] << 16 |
+               (Uint32)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = sha1_rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    Uint32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        Uint32 f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        Uint32 t = sha1_rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = sha1_rol(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static void sha1(const void *data, int len, Uint8 digest[20]) {
+    Uint32 h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    const Uint8 *bytes = data;
+    Uint8 block[64];
+
+    int i = 0;
+    for (; i + 64 <= len; i += 64) sha1_block(h, bytes + i);
+
+    // Final block(s): the rest, 0x80, zeros, then the bit length
+    int rest = len - i;
+    memset(block, 0, sizeof(block));
+    memcpy(block, bytes + i, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    Uint64 bits = (Uint64)len * 8;
+    for (int b = 0; b < 8; b++) block[63 - b] = (Uint8)(bits >> (b * 8));
+    sha1_block(h, block);
+
+    for (int b = 0; b < 20; b++) digest[b] = (Uint8)(h[b / 4] >> (24 - (b % 4) * 8));
+}
+
+// --- Connection ---------------------------------------------------------------
+
+static void websocket_disconnect(WebSocket *ws) {
+    if (ws->socket) NET_DestroyStreamSocket(ws->socket);
+    ws->socket = NULL;
+    ws->state = WS_CLOSED;
+    ws->in_len = 0;
+    ws->fragmented = false;
+}
+
+// Starts connecting to ws://host:port/path. addr must already be resolved.
+// Progress happens in websocket_update.
+bool websocket_connect(WebSocket *ws, NET_Address *addr, Uint16 port, const char *host, const char *path) {
+    websocket_disconnect(ws);
+    if (ws->rng == 0) ws->rng = SDL_GetPerformanceCounter() ^ (Uint64)(uintptr_t)ws;
+
+    // The key only proves the server speaks WebSocket; it need not be secret
+    Uint8 key_bytes[16];
+    for (int i = 0; i < 16; i += 4) {
+        Uint32 r = SDL_rand_bits_r(&ws->rng);
+        memcpy(key_bytes + i, &r, 4);
+    }
+    char key[32];
+    base64_encode_bytes(key_bytes, sizeof(key_bytes), key);
+
+    char concat[96];
+    int concat_len = snprintf(concat, sizeof(concat), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", key);
+    Uint8 digest[20];
+    sha1(concat, concat_len, digest);
+    base64_encode_bytes(digest, sizeof(digest), ws->accept);
+
+    ws->request_len = snprintf(ws->request, sizeof(ws->request),
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s:%d\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: %s\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n",
+        path, host, port, key);
+    if (ws->request_len >= (int)sizeof(ws->request)) {
+        SDL_Log("WebSocket request too large");
+        return false;
+    }
+
+    ws->socket = NET_CreateClient(addr, port);
+    if (!ws->socket) {
+        SDL_Log("WebSocket connect failed: %s", SDL_GetError());
+        return false;
+    }
+    ws->state = WS_CONNECTING;
+    ws->connect_deadline_ns = SDL_GetTicksNS() + WS_CONNECT_TIMEOUT_MS * 1000000ULL;
+    ws->ping_sent_ns = 0;
+    return true;
+}
+
+// Sends one unfragmented frame, masked
+static bool websocket_send_frame(WebSocket *ws, WebSocketOpcode opcode, const void *data, int len) {
+    if (!ws->socket || len < 0 || len > WS_BUFFER_SIZE) return false;
+
+    Uint8 *frame = ws->out;
+    int n = 0;
+    frame[n++] = 0x80 | opcode;     // FIN
+    if (len < 126) {
+        frame[n++] = 0x80 | (Uint8)len;
+    } else if (len <= 0xFFFF) {
+        frame[n++] = 0x80 | 126;
+        frame[n++] = (Uint8)(len >> 8);
+        frame[n++] = (Uint8)len;
+    } else {
+        frame[n++] = 0x80 | 127;
+        for (int b = 7; b >= 0; b--) frame[n++] = (Uint8)((Uint64)len >> (b * 8));
+    }
+
+    Uint32 mask = SDL_rand_bits_r(&ws->rng);
+    Uint8 key[4];
+    memcpy(key, &mask, 4);
+    memcpy(frame + n, key, 4);
+    n += 4;
+
+    const Uint8 *payload = data;
+    for (int i = 0; i < len; i++) frame[n + i] = payload[i] ^ key[i & 3];
+    n += len;
+
+    if (!NET_WriteToStreamSocket(ws->socket, frame, n)) {
+        SDL_Log("WebSocket write failed: %s", SDL_GetError());
+        websocket_disconnect(ws);
+        return false;
+    }
+    ws->bytes_out += n;
+    return true;
+}
+
+bool websocket_send_text(WebSocket *ws, const char *text, int len) {
+    if (ws->state != WS_OPEN || !websocket_send_frame(ws, WS_OP_TEXT, text, len)) return false;
+    ws->messages_out++;
+    return true;
+}
+
+bool websocket_send_binary(WebSocket *ws, const void *data, int len) {
+    if (ws->state != WS_OPEN || !websocket_send_frame(ws, WS_OP_BINARY, data, len)) return false;
+    ws->messages_out++;
+    return true;
+}
+
+// Sends a close frame and drops the connection without waiting for the
+// server's reply
+void websocket_close(WebSocket *ws, Uint16 code) {
+    if (ws->state == WS_OPEN) {
+        Uint8 payload[2] = { (Uint8)(code >> 8), (Uint8)code };
+        if (websocket_send_frame(ws, WS_OP_CLOSE, payload, sizeof(payload))) {
+            NET_WaitUntilStreamSocketDrained(ws->socket, WS_CLOSE_DRAIN_MS);
+        }
+    }
+    websocket_disconnect(ws);
+}
+
+static void websocket_fail(WebSocket *ws, Uint16 code, const char *reason) {
+    SDL_Log("WebSocket closed: %s", reason);
+    websocket_close(ws, code);
+}
+
+// Checks the 101 response head (head_len bytes, without the blank line)
+static bool websocket_check_handshake(WebSocket *ws, const char *head, int head_len) {
+    int status = 0;
+    if (sscanf(head, "HTTP/1.1 %d", &status) != 1 || status != 101) {
+        SDL_Log("WebSocket upgrade refused (HTTP %d)", status);
+        return false;
+    }
+
+    bool upgrade = false, accepted = false;
+    const char *end = head + head_len;
+    const char *line = memchr(head, '\n', head_len);
+    while (line && ++line < end) {
+        const char *next = memchr(line, '\n', end - line);
+        int line_len = (int)((next ? next : end) - line);
+        char value[128];
+
+        if (line_len > 8 && SDL_strncasecmp(line, "Upgrade:", 8) == 0) {
+            snprintf(value, sizeof(value), "%.*s", line_len - 8, line + 8);
+            upgrade = SDL_strcasestr(value, "websocket") != NULL;
+        } else if (line_len > 21 && SDL_strncasecmp(line, "Sec-WebSocket-Accept:", 21) == 0) {
+            snprintf(value, sizeof(value), "%.*s", line_len - 21, line + 21);
+            accepted = strstr(value, ws->accept) != NULL;
+        }
+        line = next;
+    }
+
+    if (!upgrade || !accepted) {
+        SDL_Log("WebSocket handshake invalid");
+        return false;
+    }
+    return true;
+}
+
+// Drives connecting and the handshake, reads what has arrived and keeps the
+// link alive. Returns false once the connection is closed or has failed.
+bool websocket_update(WebSocket *ws) {
+    if (ws->state == WS_CLOSED) return false;
+    Uint64 now = SDL_GetTicksNS();
+
+    if (ws->state == WS_CONNECTING) {
+        NET_Status status = NET_GetConnectionStatus(ws->socket);
+        if (status == NET_FAILURE) {
+            websocket_fail(ws, WS_CLOSE_GOING_AWAY, "connect failed");
+            return false;
+        }
+        if (status == NET_WAITING) {
+            if (now < ws->connect_deadline_ns) return true;
+            websocket_fail(ws, WS_CLOSE_GOING_AWAY, "connect timed out");
+            return false;
+        }
+        if (!NET_WriteToStreamSocket(ws->socket, ws->request, ws->request_len)) {
+            websocket_fail(ws, WS_CLOSE_GOING_AWAY, "handshake write failed");
+            return false;
+        }
+        ws->state = WS_HANDSHAKE;
+    }
+
+    while (ws->in_len < WS_BUFFER_SIZE) {
+        int n = NET_ReadFromStreamSocket(ws->socket, ws->in + ws->in_len, WS_BUFFER_SIZE - ws->in_len);
+        if (n < 0) {
+            websocket_fail(ws, WS_CLOSE_GOING_AWAY, "connection lost");
+            return false;
+        }
+        if (n == 0) break;
+        ws->in_len += n;
+        ws->bytes_in += n;
+        ws->last_received_ns = now;
+    }
+
+    if (ws->state == WS_HANDSHAKE) {
+        const char *head = (const char *)ws->in;
+        const char *end = NULL;
+        for (int i = 0; i + 4 <= ws->in_len; i++) {
+            if (memcmp(head + i, "\r\n\r\n", 4) == 0) {
+                end = head + i;
+                break;
+            }
+        }
+        if (!end) {
+            if (ws->in_len == WS_BUFFER_SIZE || now >= ws->connect_deadline_ns) {
+                websocket_fail(ws, WS_CLOSE_GOING_AWAY, "handshake timed out");
+                return false;
+            }
+            return true;
+        }
+        if (!websocket_check_handshake(ws, head, (int)(end - head))) {
+            websocket_disconnect(ws);
+            return false;
+        }
+
+        // Frames may follow the head in the same read
+        int used = (int)(end - head) + 4;
+        ws->in_len -= used;
+        memmove(ws->in, ws->in + used, ws->in_len);
+        ws->state = WS_OPEN;
+        ws->last_received_ns = now;
+    }
+
+    // Keepalive: ping a quiet link, drop a dead one
+    if (now - ws->last_received_ns > WS_TIMEOUT_NS) {
+        websocket_fail(ws, WS_CLOSE_GOING_AWAY, "timed out");
+        return false;
+    }
+    if (now - ws->last_received_ns > WS_PING_INTERVAL_NS && ws->ping_sent_ns == 0) {
+        if (!websocket_send_frame(ws, WS_OP_PING, NULL, 0)) return false;
+        ws->ping_sent_ns = now;
+        ws->pings_sent++;
+    }
+    return true;
+}
+
+// Returns the next complete message read by websocket_update, handling
+// control frames on the way. False when no full message is buffered (or the
+// connection was closed meanwhile).
+bool websocket_receive(WebSocket *ws, WebSocketMessage *message) {
+    int pos = 0;
+    bool found = false;
+
+    while (ws->state == WS_OPEN && !found) {
+        const Uint8 *frame = ws->in + pos;
+        int avail = ws->in_len - pos;
+        if (avail < 2) break;
+
+        bool fin = (frame[0] & 0x80) != 0;
+        WebSocketOpcode opcode = (WebSocketOpcode)(frame[0] & 0x0F);
+        if ((frame[0] & 0x70) || (frame[1] & 0x80)) {
+            // No extensions were negotiated, and servers never mask
+            websocket_fail(ws, WS_CLOSE_PROTOCOL_ERROR, "bad frame header");
+            return false;
+        }
+
+        Uint64 len = frame[1] & 0x7F;
+        int header = 2;
+        if (len == 126) {
+            if (avail < 4) break;
+            len = (Uint64)frame[2] << 8 | frame[3];
+            header = 4;
+        } else if (len == 127) {
+            if (avail < 10) break;
+            len = 0;
+            for (int b = 0; b < 8; b++) len = len << 8 | frame[2 + b];
+            header = 10;
+        }
+        if (len > (Uint64)(WS_BUFFER_SIZE - header)) {
+            websocket_fail(ws, WS_CLOSE_TOO_BIG, "frame too large");
+            return false;
+        }
+        if ((Uint64)avail < header + len) break;
+
+        const Uint8 *payload = frame + header;
+        int payload_len = (int)len;
+        pos += header + payload_len;
+
+        if (opcode >= WS_OP_CLOSE && (!fin || payload_len > 125)) {
+            websocket_fail(ws, WS_CLOSE_PROTOCOL_ERROR, "bad control frame");
+            return false;
+        }
+
+        switch (opcode) {
+            case WS_OP_TEXT:
+            case WS_OP_BINARY:
+            case WS_OP_CONTINUATION: {
+                if ((opcode == WS_OP_CONTINUATION) != ws->fragmented) {
+                    websocket_fail(ws, WS_CLOSE_PROTOCOL_ERROR, "unexpected continuation");
+                    return false;
+                }
+                if (opcode != WS_OP_CONTINUATION) {
+                    ws->message_opcode = opcode;
+                    ws->message_len = 0;
+                }
+                if (ws->message_len + payload_len > WS_BUFFER_SIZE) {
+                    websocket_fail(ws, WS_CLOSE_TOO_BIG, "message too large");
+                    return false;
+                }
+                memcpy(ws->message + ws->message_len, payload, payload_len);
+                ws->message_len += payload_len;
+                ws->fragmented = !fin;
+                if (fin) {
+                    ws->message[ws->message_len] = '\0';
+                    message->opcode = ws->message_opcode;
+                    message->data = ws->message;
+                    message->len = ws->message_len;
+                    ws->messages_in++;
+                    found = true;
+                }
+                break;
+            }
+
+            case WS_OP_PING:
+                if (!websocket_send_frame(ws, WS_OP_PONG, payload, payload_len)) return false;
+                break;
+
+            case WS_OP_PONG:
+                if (ws->ping_sent_ns) ws->rtt_ns = SDL_GetTicksNS() - ws->ping_sent_ns;
+                ws->ping_sent_ns = 0;
+                break;
+
+            case WS_OP_CLOSE: {
+                // Echo the status code back, then we are done
+                int code = payload_len >= 2 ? (payload[0] << 8 | payload[1]) : WS_CLOSE_NORMAL;
+                SDL_Log("WebSocket closed by server (%d)", code);
+                websocket_close(ws, (Uint16)code);
+                return false;
+            }
+
+            default:
+                websocket_fail(ws, WS_CLOSE_PROTOCOL_ERROR, "unknown opcode");
+                return false;
+        }
+    }
+
+    if (ws->state == WS_CLOSED) return false;
+    ws->in_len -= pos;
+    memmove(ws->in, ws->in + pos, ws->in_len);
+    return found;
+}
+
+void websocket_log_stats(const WebSocket *ws) {
+    if (ws->messages_in == 0 && ws->messages_out == 0) return;
+    SDL_Log("WebSocket: %u messages in (%llu bytes), %u out (%llu bytes), %u pings, last rtt %.2f ms",
+            ws->messages_in, (unsigned long long)ws->bytes_in,
+            ws->messages_out, (unsigned long long)ws->bytes_out,
+            ws->pings_sent, ws->rtt_ns / 1e6);
+}
+
+#endif